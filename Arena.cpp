@@ -0,0 +1,48 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Per-thread arenas for the state of one file
+///
+/// @file   Arena.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <vector>  // For vector
+
+#include "Arena.h"
+
+using namespace std;
+
+
+/// The arenas of this thread (they live as long as the thread)
+static thread_local vector<unique_ptr<FileArena>> thread_arenas;
+
+/// The number of #thread_arenas that are in use
+static thread_local size_t arenas_in_use { 0 };
+
+
+FileArena::FileArena()
+      :buffer_  ( make_unique<byte[]>( BUFFER_BYTES ) )                       // Member initialization
+      ,resource_( buffer_.get(), BUFFER_BYTES, pmr::new_delete_resource() )  // Member initialization
+{}
+
+
+/// @return The next free arena (making it if this is the deepest nesting yet)
+static FileArena& take_arena() {
+   if( arenas_in_use == thread_arenas.size() ) {
+      thread_arenas.push_back( make_unique<FileArena>() );
+   }
+   return *thread_arenas[ arenas_in_use++ ];
+}
+
+
+ArenaScope::ArenaScope()
+      :arena_( take_arena() )  // Member initialization
+{}
+
+
+ArenaScope::~ArenaScope() {
+   arena_.release();
+   arenas_in_use--;
+}
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Per-thread arenas for the state of one file
+///
+/// Everything a PEFile allocates while it's being reported (its section
+/// headers, the per-section analyses, the section table, an export hash
+/// index) comes from a `std::pmr::monotonic_buffer_resource` that belongs
+/// to the worker thread.  Nothing is freed piece by piece: when the report
+/// is done, the whole arena is released at once and the next file starts
+/// again at the front of the same buffer.  A file whose state doesn't fit
+/// in the buffer spills over to the heap until its arena is released.
+///
+/// A worker that waits for its file's tasks helps run other tasks, which
+/// can be another file's job.  So each thread keeps a stack of arenas,
+/// and an ArenaScope takes the next one: a nested file never releases the
+/// arena of the file it interrupted.
+///
+/// @file   Arena.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>          // For byte size_t
+#include <memory>           // For unique_ptr
+#include <memory_resource>  // For memory_resource monotonic_buffer_resource
+
+
+/// One arena: a buffer that's reused from file to file
+class FileArena {
+public:
+   /// The size of the buffer (enough for a file with a few hundred sections)
+   static constexpr size_t BUFFER_BYTES = 64 * 1024;
+
+protected:
+   std::unique_ptr<std::byte[]>        buffer_;    ///< The memory that's reused
+   std::pmr::monotonic_buffer_resource resource_;  ///< Hands out #buffer_ (then the heap)
+
+public:
+   FileArena();
+
+   FileArena( const FileArena& ) = delete;             ///< The resource points into #buffer_
+   FileArena& operator=( const FileArena& ) = delete;  ///< The resource points into #buffer_
+
+   std::pmr::memory_resource* resource() {
+      return &resource_;  /// @return Where to allocate from
+   }
+
+   /// Free everything that was allocated from this arena
+   void release() {
+      resource_.release();
+   }
+}; // FileArena
+
+
+/// Takes the next free FileArena on this thread and releases it when it goes out of scope
+class ArenaScope {
+protected:
+   FileArena& arena_;  ///< The arena for this scope
+
+public:
+   ArenaScope();
+
+   ~ArenaScope();
+
+   ArenaScope( const ArenaScope& ) = delete;
+   ArenaScope& operator=( const ArenaScope& ) = delete;
+
+   std::pmr::memory_resource* resource() const {
+      return arena_.resource();  /// @return Where to allocate from
+   }
+}; // ArenaScope
@@ -0,0 +1,229 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Process many files in parallel and write their reports in order
+///
+/// @file   Batch.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For max()
+#include <climits>    // For IOV_MAX
+#include <iomanip>    // For setw()
+
+#include "Batch.h"
+#include "Stats.h"
+
+using namespace std;
+
+
+/// The number of files in flight per worker
+///
+/// Enough to keep every worker busy while the writer waits on a slow file,
+/// without holding every report of a big sweep in memory.
+#define FILES_PER_WORKER 4
+
+
+const char* stage_name( const Stage stage ) {
+   switch( stage ) {
+      case Stage::OPEN:            return "open";
+      case Stage::CACHE:           return "cache";
+      case Stage::DOS_HEADER:      return "DOS header";
+      case Stage::COFF_HEADER:     return "COFF header";
+      case Stage::OPTIONAL_HEADER: return "optional header";
+      case Stage::SECTION_TABLE:   return "section table";
+      case Stage::ENTROPY:         return "entropy";
+      case Stage::IMPORTS:         return "imports";
+      case Stage::EXPORTS:         return "exports";
+      case Stage::RESOURCES:       return "resources";
+      case Stage::RELOCATIONS:     return "relocations";
+      case Stage::DEBUG:           return "debug";
+      case Stage::OVERLAY:         return "overlay";
+      case Stage::HASHES:          return "hashes";
+   }
+   return "unknown";
+}
+
+
+void BatchSummary::print( ostream& out ) const {
+   out << "Summary" << endl;
+   out << "    " << setfill( ' ' ) << left << setw(34) << "Files processed:" << files          << endl;
+   out << "    " << setfill( ' ' ) << left << setw(34) << "Succeeded:"       << files - failed - skipped << endl;
+   if( skipped > 0 ) {
+      out << "    " << setfill( ' ' ) << left << setw(34) << "Skipped (not PE):" << skipped << endl;
+   }
+   out << "    " << setfill( ' ' ) << left << setw(34) << "Failed:"          << failed         << endl;
+   for( size_t i = 0 ; i < NUMBER_OF_STAGES ; i++ ) {
+      if( by_stage[i] == 0 ) {
+         continue;
+      }
+      out << "        " << setfill( ' ' ) << left << setw(30) << string( stage_name( static_cast<Stage>( i ) ) ) + ":" << by_stage[i] << endl;
+   }
+}
+
+
+Batch::Batch( const size_t new_number_of_workers, const bool new_keep_going, Job new_job )
+      :number_of_workers_( new_number_of_workers )  // Member initialization
+      ,keep_going_( new_keep_going )              // Member initialization
+      ,job_( std::move( new_job ) )               // Member initialization
+      ,slots_( max<size_t>( new_number_of_workers, 1 ) * FILES_PER_WORKER )  // Member initialization
+      ,pool_( new_number_of_workers )             // Member initialization
+{}
+
+
+void Batch::drain() {
+   unique_lock<mutex> lock( mutex_ );
+   slot_done_.wait( lock, [this] { return in_flight_ == 0; } );
+}
+
+
+/// Waits for the jobs of a run() that's over (even one that's leaving with an exception)
+struct DrainGuard {
+   function<void()> drain;  ///< Waits for the jobs
+
+   ~DrainGuard() { drain(); }
+};
+
+
+/// Stops a PathSource from calling back into a run() that's over
+struct WakeGuard {
+   PathSource& source;  ///< The source that was told where to call
+
+   ~WakeGuard() { source.wake_on_ready( nullptr ); }
+};
+
+
+BatchSummary Batch::run( PathSource& paths, const int out_fd, ostream& errors ) {
+   BatchSummary summary;
+
+   const size_t        window = slots_.size();
+   vector<OutputSink*> ready;  // The finished reports that are next in order
+   bool                input_ready { false };  // Set when the source may have more paths
+
+   // Whatever a run that threw left behind is cleared (the sinks keep their buffers)
+   for( Slot& slot : slots_ ) {
+      slot.report.clear();
+      slot.stage = Stage::OPEN;
+      slot.error   = nullptr;
+      slot.skipped = false;
+      slot.done    = false;
+   }
+   const DrainGuard drain_guard { [this] { drain(); } };  // The jobs touch the slots, so they finish before run() returns
+
+   paths.wake_on_ready( [this, &input_ready] {
+      {
+         const lock_guard<mutex> lock( mutex_ );
+         input_ready = true;
+      }
+      slot_done_.notify_all();
+   } );
+   const WakeGuard wake_guard { paths };  // Declared last, so the source stops calling before anything goes away
+
+   size_t submitted { 0 };
+   size_t written   { 0 };
+   bool   ended     { false };
+   while( !ended || written < submitted ) {
+      // Keep the window full with whatever paths the source has now
+      {
+         const lock_guard<mutex> lock( mutex_ );
+         input_ready = false;  // Before next(), so a path that shows up after it still wakes the wait below
+      }
+      while( !ended && submitted < written + window ) {
+         Slot& slot = slots_[ submitted % window ];
+         const PathSource::Next next = paths.next( slot.path );
+         if( next == PathSource::Next::END ) {
+            ended = true;
+         }
+         if( next != PathSource::Next::PATH ) {
+            break;
+         }
+
+         {
+            const lock_guard<mutex> lock( mutex_ );
+            in_flight_++;
+         }
+         pool_.submit( [this, &slot] {
+            exception_ptr error;
+            bool          reported = true;
+            try {
+               reported = job_( slot.path, slot.report, slot.stage );
+            } catch( ... ) {
+               error = current_exception();
+            }
+
+            {
+               const lock_guard<mutex> lock( mutex_ );
+               slot.error   = error;
+               slot.skipped = !reported;
+               slot.done    = true;
+               in_flight_--;
+            }
+            slot_done_.notify_all();
+         } );
+         submitted++;
+      }
+      if( ended && written == submitted ) {
+         break;  // Nothing was left to find or to write
+      }
+
+      // Wait for the next report in order (or for more paths, if there's
+      // room for them), then take every finished report after it (up to
+      // the first failure) and write them all with one writev()
+      ready.clear();
+      {
+         unique_lock<mutex> lock( mutex_ );
+         slot_done_.wait( lock, [&] {
+            return ( written < submitted && slots_[ written % window ].done )
+                || ( !ended && input_ready && submitted < written + window );
+         } );
+
+         for( size_t i = written ; i < submitted && ready.size() < IOV_MAX ; i++ ) {
+            Slot& slot = slots_[ i % window ];
+            if( !slot.done ) {
+               break;
+            }
+            ready.push_back( &slot.report );
+            if( slot.error ) {
+               break;
+            }
+         }
+      }
+
+      {
+         STATS_SCOPE( WRITE );
+         OutputSink::flush_to( out_fd, ready.data(), ready.size() );
+      }
+
+      for( size_t i = 0 ; i < ready.size() ; i++, written++ ) {
+         Slot& slot = slots_[ written % window ];
+         summary.files++;
+         if( slot.skipped ) {
+            summary.skipped++;
+         }
+
+         if( slot.error && !keep_going_ ) {
+            rethrow_exception( slot.error );  // The DrainGuard waits for what's in flight
+         }
+
+         if( slot.error ) {
+            Failure failure { slot.path, slot.stage, "unknown error" };
+            try {
+               rethrow_exception( slot.error );
+            } catch( const exception& e ) {
+               failure.reason = e.what();
+            } catch( ... ) {}  // Keep "unknown error"
+
+            errors << failure.path << ": " << stage_name( failure.stage ) << ": " << failure.reason << endl;
+            summary.add_failure( failure.stage );
+         }
+
+         slot.stage   = Stage::OPEN;
+         slot.error   = nullptr;
+         slot.skipped = false;
+         slot.done    = false;
+      }
+   }
+
+   return summary;
+} // run()
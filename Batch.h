@@ -0,0 +1,211 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Process many files in parallel and write their reports in order
+///
+/// @file   Batch.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <array>               // For array
+#include <condition_variable>  // For condition_variable
+#include <cstddef>             // For size_t
+#include <exception>           // For exception_ptr
+#include <functional>          // For function
+#include <mutex>               // For mutex
+#include <ostream>             // For ostream
+#include <string>              // For string
+#include <vector>              // For vector
+
+#include "OutputSink.h"
+#include "ThreadPool.h"
+
+
+/// What a job was doing to a file (for failure reports)
+enum class Stage {
+    OPEN             ///< Opening and loading the file
+   ,CACHE            ///< Looking up or storing the report in the ResultCache
+   ,DOS_HEADER       ///< Parsing the DOS header
+   ,COFF_HEADER      ///< Parsing the COFF/File header
+   ,OPTIONAL_HEADER  ///< Parsing the optional header
+   ,SECTION_TABLE    ///< Parsing the section table
+   ,ENTROPY          ///< Counting the bytes in a section
+   ,IMPORTS          ///< Walking the import table
+   ,EXPORTS          ///< Looking up the export table
+   ,RESOURCES        ///< Walking the resource tree
+   ,RELOCATIONS      ///< Scanning the base relocation table
+   ,DEBUG            ///< Reading the debug directory
+   ,OVERLAY          ///< Scanning the data after the last section
+   ,HASHES           ///< Hashing the file, its sections or its imports
+};
+
+/// The number of Stage values
+inline constexpr size_t NUMBER_OF_STAGES = 14;
+
+/// @return The name of `stage` for printing
+extern const char* stage_name( Stage stage );
+
+
+/// Why one file in a batch failed
+struct Failure {
+   std::string path;    ///< The file that failed
+   Stage       stage;   ///< What was being done when it failed
+   std::string reason;  ///< The message from the exception
+};
+
+
+/// What happened in a Batch::run()
+///
+/// Only counts are kept (each Failure is printed as it happens), so a
+/// daemon's summary stays the same size however long it runs.
+struct BatchSummary {
+   size_t                               files    { 0 };  ///< The number of files that were processed
+   size_t                               failed   { 0 };  ///< The number of files that failed
+   size_t                               skipped  { 0 };  ///< The number of files that were skipped without being parsed (not failures)
+   std::array<size_t, NUMBER_OF_STAGES> by_stage {};     ///< The number of files that failed at each Stage
+
+   /// Count a file that failed at `stage`
+   void add_failure( const Stage stage ) {
+      failed++;
+      by_stage[ static_cast<size_t>( stage ) ]++;
+   }
+
+   /// Add the counts of `other` to these
+   void add( const BatchSummary& other ) {
+      files   += other.files;
+      failed  += other.failed;
+      skipped += other.skipped;
+      for( size_t i = 0 ; i < NUMBER_OF_STAGES ; i++ ) {
+         by_stage[i] += other.by_stage[i];
+      }
+   }
+
+   /// Print the counts of files processed, succeeded, skipped and failed by Stage
+   void print( std::ostream& out ) const;
+};
+
+
+/// Where a Batch gets the paths of the files to process
+class PathSource {
+public:
+   /// What next() found
+   enum class Next {
+       PATH  ///< The next path was filled in
+      ,WAIT  ///< There is no path yet, but there may be more later
+      ,END   ///< There are no more paths
+   };
+
+   virtual ~PathSource() = default;
+
+   /// Get the next path without waiting for it
+   ///
+   /// @param path Set to the next path (if it returns Next::PATH)
+   /// @return Whether there was a path
+   virtual Next next( std::string& path ) = 0;
+
+   /// Call `wake` (from any thread) whenever next() may have stopped returning Next::WAIT
+   ///
+   /// An empty `wake` stops the calls.
+   virtual void wake_on_ready( std::function<void()> wake ) = 0;
+}; // PathSource
+
+
+/// The paths in a vector (they're all there up front)
+class PathList : public PathSource {
+protected:
+   const std::vector<std::string>& paths_;       ///< The paths
+   size_t                          next_ { 0 };  ///< The next one to hand out
+
+public:
+   /// Hand out each of `paths` in order
+   explicit PathList( const std::vector<std::string>& paths )
+         :paths_( paths )  // Member initialization
+   {}
+
+   Next next( std::string& path ) override {
+      if( next_ == paths_.size() ) {
+         return Next::END;  /// @return Next::END after the last path
+      }
+      path = paths_[ next_++ ];
+      return Next::PATH;    /// @return Next::PATH otherwise
+   }
+
+   void wake_on_ready( std::function<void()> ) override {}  ///< The paths never have to be waited for
+}; // PathList
+
+
+/// Run a job over a list of files on a pool of workers
+///
+/// Each file's report goes into its own OutputSink.  The sinks are written
+/// out in the order of the paths, as soon as every file before them is
+/// done, so the output is the same as a serial run.  Reports that finish
+/// together go out in a single `writev()`.  Only a bounded window of files
+/// is in flight at any time, and their sinks are reused.
+///
+/// A failing file either stops the run or, with `keep_going`, is printed
+/// as a Failure, counted, and the run moves on to the next file.
+///
+/// The workers and the window of sinks are kept from one run() to the next,
+/// so a Batch that's fed over and over (like a daemon's) starts each run
+/// with warm threads, warm arenas and buffers that have already grown.
+class Batch {
+public:
+   /// Process the file at `path` and write its report to `report`
+   ///
+   /// The job keeps `stage` up to date so a failure can say where it happened.
+   /// It returns `false` if it skipped the file (which isn't a failure).
+   using Job = std::function<bool( const std::string& path, OutputSink& report, Stage& stage )>;
+
+protected:
+   /// The place where one file's report is collected
+   struct Slot {
+      std::string        path;                   ///< The file (reused from file to file)
+      OutputSink         report;                 ///< The report for this file (reused from file to file)
+      Stage              stage { Stage::OPEN };  ///< How far the job got
+      std::exception_ptr error;                  ///< Set if the job threw
+      bool               skipped { false };      ///< Set if the job skipped the file
+      bool               done  { false };        ///< Set when the job has finished
+   };
+
+   size_t                  number_of_workers_;  ///< The number of threads to parse with
+   bool                    keep_going_;         ///< Record failures and keep going rather than stopping
+   Job                     job_;                ///< What to do with each file
+   std::vector<Slot>       slots_;              ///< The window of files in flight
+   std::mutex              mutex_;              ///< Guards #slots_ and #in_flight_
+   std::condition_variable slot_done_;          ///< Signalled when a job finishes (or the PathSource has more paths)
+   size_t                  in_flight_ { 0 };    ///< The jobs that have been submitted and haven't finished
+   ThreadPool              pool_;               ///< The workers (declared last, so they join before the slots go away)
+
+   /// Wait until every job that's been submitted has finished
+   void drain();
+
+public:
+   /// Create a Batch that runs `new_job` on `new_number_of_workers` threads
+   Batch( size_t new_number_of_workers, bool new_keep_going, Job new_job );
+
+   Batch( const Batch& ) = delete;             ///< A Batch owns threads
+   Batch& operator=( const Batch& ) = delete;  ///< A Batch owns threads
+
+   /// Run the job over `paths` and write the reports to `out_fd` in order
+   ///
+   /// Whatever a failing job wrote before it threw is written too.  Without
+   /// #keep_going_, the exception is then rethrown.  With it, the failure
+   /// is printed to `errors` (in order) and counted in the summary.
+   ///
+   /// Paths are taken from `paths` as there's room for them in the window,
+   /// so a source that's still finding files can feed a run as it goes.
+   /// Each report is written as soon as every report before it is done.
+   /// Runs can't overlap (a Batch is fed from one thread).
+   ///
+   /// @return The number of files processed and the failures
+   BatchSummary run( PathSource& paths, int out_fd, std::ostream& errors );
+
+   /// Run the job over every path in `paths`
+   /// @return The number of files processed and the failures
+   BatchSummary run( const std::vector<std::string>& paths, const int out_fd, std::ostream& errors ) {
+      PathList list { paths };
+      return run( list, out_fd, errors );
+   }
+}; // Batch
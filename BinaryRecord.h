@@ -0,0 +1,134 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// The layout of the records that `--format=binary` writes
+///
+/// The output is a sequence of records, one per file, back to back.  Each
+/// record starts with a BinaryRecord and is #BinaryRecord::size bytes long
+/// (a multiple of 8), so a reader can mmap the output and walk it without
+/// parsing anything.  Every offset in a record is from the start of that
+/// record.
+///
+/// A record holds, in order:
+///   - The BinaryRecord: the header fields, the data directory and the
+///     whole-file digests
+///   - BinaryRecord::number_of_sections BinarySection records
+///   - BinaryRecord::number_of_imports BinaryImport records
+///   - BinaryRecord::number_of_exports BinaryExport records
+///   - The string table: NUL-terminated strings, referenced by their
+///     offset from BinaryRecord::strings_offset (#NO_STRING if there isn't one)
+///
+/// Header fields are stored as `uint64_t`s in the order of their layout
+/// (`DOS_LAYOUT`, `COFF_LAYOUT`...), so `dos[DOS_E_LFANEW]` is the PE header
+/// offset.  A PE32+ optional header is stored in the order of
+/// `OPTIONAL32_LAYOUT` (BaseOfData is 0).  A field that was past the end of
+/// the file is 0.  Everything is little-endian.
+///
+/// @file   BinaryRecord.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstdint>  // For uint8_t uint16_t uint32_t uint64_t
+
+#include "Exports.h"
+#include "HeaderView.h"
+
+
+/// The first four bytes of every record (`RPE1`)
+inline constexpr uint32_t BINARY_RECORD_MAGIC = 0x31455052;
+
+/// The version of this layout
+inline constexpr uint16_t BINARY_RECORD_VERSION = 1;
+
+/// A string offset for a string that isn't there
+inline constexpr uint32_t NO_STRING = UINT32_MAX;
+
+
+/// The bits in BinaryRecord::flags
+enum BinaryRecordFlag : uint16_t {
+    RECORD_FAILED       = 0x0001  ///< The file failed part of the way through (see BinaryRecord::error_reason)
+   ,RECORD_HAS_OPTIONAL = 0x0002  ///< The file has an optional header
+   ,RECORD_PE32_PLUS    = 0x0004  ///< The optional header is PE32+
+   ,RECORD_HAS_SHA256   = 0x0008  ///< BinaryRecord::sha256 is set
+   ,RECORD_HAS_IMPHASH  = 0x0010  ///< BinaryRecord::imphash is set
+   ,RECORD_HAS_EXPORTS  = 0x0020  ///< BinaryRecord::export_directory is set
+   ,RECORD_SKIPPED      = 0x0040  ///< The file was skipped without being parsed (see BinaryRecord::error_reason)
+};
+
+
+/// The bits in BinarySection::flags
+enum BinarySectionFlag : uint32_t {
+    SECTION_HAS_ENTROPY = 0x0001  ///< BinarySection::entropy is set
+   ,SECTION_HAS_SHA256  = 0x0002  ///< BinarySection::sha256 is set
+};
+
+
+/// The start of the record for one file
+struct BinaryRecord {
+   uint32_t magic;                       ///< #BINARY_RECORD_MAGIC
+   uint32_t size;                        ///< The size of the whole record in bytes
+   uint16_t version;                     ///< #BINARY_RECORD_VERSION
+   uint16_t flags;                       ///< BinaryRecordFlag bits
+   uint32_t path;                        ///< The path of the file (a string)
+   uint32_t error_stage;                 ///< What failed (a string)
+   uint32_t error_reason;                ///< Why it failed or was skipped (a string)
+   uint32_t sections_offset;             ///< The first BinarySection
+   uint32_t number_of_sections;          ///< The number of BinarySection records
+   uint32_t imports_offset;              ///< The first BinaryImport
+   uint32_t number_of_imports;           ///< The number of BinaryImport records
+   uint32_t exports_offset;              ///< The first BinaryExport
+   uint32_t number_of_exports;           ///< The number of BinaryExport records
+   uint32_t strings_offset;              ///< The string table
+   uint32_t strings_size;                ///< The size of the string table in bytes
+   uint32_t export_dll_name;             ///< The name in the export directory (a string)
+   uint32_t number_of_data_directories;  ///< The entries of #data_directories that are in the file
+
+   uint64_t dos             [ DOS_LAYOUT.size() ];         ///< The DOS header
+   uint64_t coff            [ COFF_LAYOUT.size() ];        ///< The COFF/File header
+   uint64_t optional        [ OPTIONAL32_LAYOUT.size() ];  ///< The optional header
+   uint64_t export_directory[ EXPORT_LAYOUT.size() ];      ///< The export directory table
+
+   DataDirectory data_directories[ NUMBER_OF_DATA_DIRECTORIES ];  ///< The data directory
+
+   uint8_t sha256 [32];  ///< The SHA-256 of the file
+   uint8_t imphash[16];  ///< The imphash
+}; // BinaryRecord
+
+
+/// One section
+struct BinarySection {
+   uint64_t fields[ SECTION_LAYOUT.size() ];  ///< The section header
+   uint32_t name;                             ///< The name of the section (a string)
+   uint32_t flags;                            ///< BinarySectionFlag bits
+   double   entropy;                          ///< The entropy of the raw data (bits per byte)
+   uint64_t entropy_bytes;                    ///< The number of bytes that were counted
+   uint8_t  sha256[32];                       ///< The SHA-256 of the raw data
+}; // BinarySection
+
+
+/// One imported function
+struct BinaryImport {
+   uint32_t dll;              ///< The DLL it's imported from (a string)
+   uint32_t name;             ///< The name of the function (#NO_STRING if it's imported by ordinal)
+   uint32_t iat_rva;          ///< The RVA of its slot in the IAT
+   uint16_t ordinal_or_hint;  ///< The ordinal if #name is #NO_STRING, otherwise the hint
+   uint16_t reserved;         ///< 0
+}; // BinaryImport
+
+
+/// One named export
+struct BinaryExport {
+   uint32_t name;       ///< The name it's exported under (a string)
+   uint32_t forwarder;  ///< `DLL.Function` if it's forwarded (#NO_STRING if it isn't)
+   uint32_t ordinal;    ///< The ordinal (0 if the name has no address)
+   uint32_t rva;        ///< The address of the function (or of the forwarder string)
+}; // BinaryExport
+
+
+static_assert( sizeof( DataDirectory ) == 8 );
+static_assert( sizeof( BinaryRecord  ) % 8 == 0 );
+static_assert( sizeof( BinarySection ) % 8 == 0 );
+static_assert( sizeof( BinaryImport  ) == 16 );
+static_assert( sizeof( BinaryExport  ) == 16 );
@@ -0,0 +1,234 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Sources of bytes for a PEFile
+///
+/// @file   ByteSource.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For min()
+#include <cstring>    // For memcmp()
+#include <fstream>    // For ifstream
+#include <stdexcept>  // For runtime_error out_of_range
+
+#include <fcntl.h>     // For open()
+#include <sys/mman.h>  // For mmap() munmap()
+#include <sys/stat.h>  // For fstat()
+#include <unistd.h>    // For pread() close() sysconf()
+
+#include "ByteSource.h"
+#include "HeaderView.h"
+#include "Stats.h"
+
+using namespace std;
+
+
+/// The bytes that check_pe_signature() reads first (the whole DOS header)
+#define SIGNATURE_HEADER_BYTES 64
+
+/// The file offset of `e_lfanew` in the DOS header
+#define SIGNATURE_E_LFANEW_OFFSET 0x3c
+
+
+/// Open `file_path` read-only and get its size
+///
+/// @param file_path The file to open
+/// @param file_size Set to the size of the file
+/// @throws runtime_error if the file can't be opened or is empty
+/// @return The open file descriptor
+static int open_for_reading( const string& file_path, size_t& file_size ) {
+   const int fd = open( file_path.c_str(), O_RDONLY | O_CLOEXEC );
+   if( fd < 0 ) {
+      throw runtime_error( "Failed to open " + file_path );
+   }
+
+   struct stat file_stat {};
+   if( fstat( fd, &file_stat ) != 0 || !S_ISREG( file_stat.st_mode ) ) {
+      close( fd );
+      throw runtime_error( "Failed to open " + file_path );
+   }
+
+   if( file_stat.st_size <= 0 ) {
+      close( fd );
+      throw runtime_error( "Unable to process empty file " + file_path );
+   }
+
+   file_size = static_cast<size_t>( file_stat.st_size );
+   return fd;
+}
+
+
+void ByteSource::check_range( const size_t offset, const size_t length ) const {
+   if( offset > file_size_ || length > file_size_ - offset ) {
+      throw out_of_range( "Read past the end of " + file_path_ );
+   }
+}
+
+
+BufferedByteSource::BufferedByteSource( const string& new_file_path ) : ByteSource( new_file_path ) {
+   ifstream file( file_path_, ios::binary | ios::ate );
+   if ( !file ) {
+      throw runtime_error( "Failed to open " + file_path_ );
+   }
+
+   const streamoff file_size = file.tellg();
+   if( file_size <= 0 ) {
+      throw runtime_error( "Unable to process empty file " + file_path_ );
+   }
+   file_size_ = static_cast<size_t>( file_size );
+   buffer_.resize( file_size_ );
+
+   file.seekg( 0, ios::beg );
+   STATS_ADD( BYTES_READ, file_size );
+   if( !file.read( buffer_.data(), file_size ) ) {
+      throw runtime_error( "Unable to read file " + file_path_ );
+   }
+   file.close();
+}
+
+
+const char* BufferedByteSource::read( const size_t offset, const size_t length ) {
+   check_range( offset, length );
+   return buffer_.data() + offset;
+}
+
+
+MappedByteSource::MappedByteSource( const string& new_file_path ) : ByteSource( new_file_path ) {
+   const int fd = open_for_reading( file_path_, file_size_ );
+
+   mapping_ = mmap( nullptr, file_size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+   close( fd );  // The mapping holds its own reference to the file
+
+   if( mapping_ == MAP_FAILED ) {
+      mapping_ = nullptr;
+      throw runtime_error( "Unable to read file " + file_path_ );
+   }
+}
+
+
+MappedByteSource::~MappedByteSource() {
+   if( mapping_ != nullptr ) {
+      munmap( mapping_, file_size_ );
+   }
+}
+
+
+const char* MappedByteSource::read( const size_t offset, const size_t length ) {
+   check_range( offset, length );
+   STATS_ADD( BYTES_READ, length );  // The kernel reads (at least) what's touched
+   return static_cast<const char*>( mapping_ ) + offset;
+}
+
+
+PagedByteSource::PagedByteSource( const string& new_file_path )
+      :ByteSource( new_file_path )                                 // Member initialization
+      ,page_size_( static_cast<size_t>( sysconf( _SC_PAGESIZE ) ) )  // Member initialization
+{
+   fd_ = open_for_reading( file_path_, file_size_ );
+}
+
+
+PagedByteSource::~PagedByteSource() {
+   if( fd_ >= 0 ) {
+      close( fd_ );
+   }
+}
+
+
+const char* PagedByteSource::read( const size_t offset, const size_t length ) {
+   check_range( offset, length );
+
+   const lock_guard<mutex> lock( mutex_ );
+
+   for( const Extent& extent : extents_ ) {
+      if( offset >= extent.offset && offset + length <= extent.offset + extent.bytes.size() ) {
+         return extent.bytes.data() + ( offset - extent.offset );
+      }
+   }
+
+   // Read the page-aligned extent that covers this request (and nothing more)
+   const size_t first = offset / page_size_ * page_size_;
+   const size_t last  = min( file_size_, ( offset + length + page_size_ - 1 ) / page_size_ * page_size_ );
+
+   Extent extent { first, vector<char>( last - first ) };
+
+   size_t done { 0 };
+   while( done < extent.bytes.size() ) {
+      const ssize_t bytes_read = pread( fd_, extent.bytes.data() + done, extent.bytes.size() - done, static_cast<off_t>( first + done ) );
+      if( bytes_read <= 0 ) {
+         throw runtime_error( "Unable to read file " + file_path_ );
+      }
+      done += static_cast<size_t>( bytes_read );
+   }
+   STATS_ADD( BYTES_READ, done );
+
+   extents_.push_back( std::move( extent ) );  // Moving a vector doesn't move its bytes
+   return extents_.back().bytes.data() + ( offset - first );
+}
+
+
+MemoryByteSource::MemoryByteSource( const string& new_name, const char* new_bytes, const size_t new_size )
+      :ByteSource( new_name )  // Member initialization
+      ,bytes_    ( new_bytes ) // Member initialization
+{
+   if( new_size == 0 ) {
+      throw runtime_error( "Unable to process empty file " + file_path_ );
+   }
+   file_size_ = new_size;
+}
+
+
+const char* MemoryByteSource::read( const size_t offset, const size_t length ) {
+   check_range( offset, length );
+   return bytes_ + offset;
+}
+
+
+unique_ptr<ByteSource> open_byte_source( const string& file_path, const LoadMode mode ) {
+   STATS_SCOPE( OPEN );
+   switch( mode ) {
+      case LoadMode::READ:  return make_unique<BufferedByteSource>( file_path );
+      case LoadMode::MMAP:  return make_unique<MappedByteSource>( file_path );
+      case LoadMode::PREAD: return make_unique<PagedByteSource>( file_path );
+   }
+   throw invalid_argument( "Unknown load mode" );
+}
+
+
+PeSignature check_pe_signature( const string& file_path ) noexcept {
+   STATS_SCOPE( OPEN );
+   const int fd = open( file_path.c_str(), O_RDONLY | O_CLOEXEC );
+   if( fd < 0 ) {
+      return PeSignature::UNREADABLE;
+   }
+
+   char header[ SIGNATURE_HEADER_BYTES ];
+   const ssize_t header_read = pread( fd, header, sizeof( header ), 0 );
+   if( header_read < 0 ) {
+      close( fd );
+      return PeSignature::UNREADABLE;
+   }
+   STATS_ADD( BYTES_READ, static_cast<size_t>( header_read ) );
+
+   PeSignature result = PeSignature::NOT_PE;
+   if( static_cast<size_t>( header_read ) == sizeof( header ) && header[0] == 'M' && header[1] == 'Z' ) {
+      const uint32_t e_lfanew = load_le<uint32_t>( header + SIGNATURE_E_LFANEW_OFFSET );
+
+      // The signature is usually past the DOS stub, so that's a second (4-byte) read
+      char signature[4];
+      bool have_signature = true;
+      if( e_lfanew <= sizeof( header ) - sizeof( signature ) ) {
+         memcpy( signature, header + e_lfanew, sizeof( signature ) );
+      } else {
+         have_signature = pread( fd, signature, sizeof( signature ), static_cast<off_t>( e_lfanew ) ) == sizeof( signature );
+         STATS_ADD( BYTES_READ, sizeof( signature ) );
+      }
+      if( have_signature && memcmp( signature, "PE\0\0", sizeof( signature ) ) == 0 ) {
+         result = PeSignature::PE;
+      }
+   }
+   close( fd );
+   return result;
+} // check_pe_signature()
@@ -0,0 +1,170 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Sources of bytes for a PEFile
+///
+/// A ByteSource hides how the bytes of a PE file get into memory.  The
+/// parsers only ever ask for small, contiguous ranges (a header, a section
+/// table), so the cost of inspecting a file can track the size of its
+/// headers rather than the size of the file.
+///
+/// @file   ByteSource.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>  // For size_t
+#include <memory>   // For unique_ptr
+#include <mutex>    // For mutex
+#include <string>   // For string
+#include <vector>   // For vector
+
+
+/// How a PEFile loads its bytes
+enum class LoadMode {
+    READ   ///< Read the whole file into memory with `ifstream::read`
+   ,MMAP   ///< Memory-map the file and let the kernel page in what gets touched
+   ,PREAD  ///< Read only the pages that are asked for with bounded `pread()` calls
+};
+
+
+/// An interface to the bytes of a file
+class ByteSource {
+protected:
+   std::string file_path_;  ///< The name of the file (for error messages)
+   size_t      file_size_;  ///< The size of the file in bytes
+
+   /// Throw `out_of_range` if [`offset`, `offset` + `length`) is not inside the file
+   void check_range( size_t offset, size_t length ) const;
+
+public:
+   /// Construct a ByteSource for `new_file_path` (the backend sets #file_size_)
+   explicit ByteSource( const std::string& new_file_path )
+         :file_path_( new_file_path )  // Member initialization
+         ,file_size_( 0 )              // Member initialization
+   {}
+
+   virtual ~ByteSource() = default;
+
+   ByteSource( const ByteSource& ) = delete;             ///< Sources own OS resources
+   ByteSource& operator=( const ByteSource& ) = delete;  ///< Sources own OS resources
+
+   size_t size() const {
+      return file_size_;  /// @return The size of the file in bytes
+   }
+
+   const std::string& get_file_path() const {
+      return file_path_;  /// @return The name of the file
+   }
+
+   /// Get `length` contiguous bytes starting at `offset`
+   ///
+   /// The pointer stays valid for the life of this ByteSource.  It's safe
+   /// to call read() from several threads at once.
+   ///
+   /// @throws out_of_range if the range runs past the end of the file
+   /// @return A pointer to the bytes
+   virtual const char* read( size_t offset, size_t length ) = 0;
+}; // ByteSource
+
+
+/// Read the whole file into memory up front (the original PEFile behavior)
+class BufferedByteSource : public ByteSource {
+protected:
+   std::vector<char> buffer_;  ///< The contents of the file
+
+public:
+   /// Read all of `new_file_path` into #buffer_
+   explicit BufferedByteSource( const std::string& new_file_path );
+
+   const char* read( size_t offset, size_t length ) override;
+}; // BufferedByteSource
+
+
+/// Memory-map the file (POSIX)
+///
+/// Only the pages that the parsers touch count against RSS.
+class MappedByteSource : public ByteSource {
+protected:
+   void* mapping_ { nullptr };  ///< The base of the read-only mapping
+
+public:
+   /// Map all of `new_file_path` read-only
+   explicit MappedByteSource( const std::string& new_file_path );
+
+   ~MappedByteSource() override;
+
+   const char* read( size_t offset, size_t length ) override;
+}; // MappedByteSource
+
+
+/// Read just the pages that are asked for with bounded `pread()` calls (POSIX)
+///
+/// Each request that isn't already covered reads the page-aligned extent
+/// around it.  An extent is never resized, so pointers into it stay valid.
+class PagedByteSource : public ByteSource {
+protected:
+   /// A run of pages that has been read from the file
+   struct Extent {
+      size_t            offset;  ///< The file offset of the first byte in #bytes
+      std::vector<char> bytes;   ///< The bytes that were read
+   };
+
+   int                 fd_ { -1 };  ///< The open file
+   size_t              page_size_;  ///< The size of a page on this system
+   std::vector<Extent> extents_;    ///< The extents that have been read so far
+   std::mutex          mutex_;      ///< Guards #extents_ (the per-section analyses read in parallel)
+
+public:
+   /// Open `new_file_path` but don't read anything yet
+   explicit PagedByteSource( const std::string& new_file_path );
+
+   ~PagedByteSource() override;
+
+   const char* read( size_t offset, size_t length ) override;
+}; // PagedByteSource
+
+
+/// Bytes that are already in memory (a fuzzer's input, or a file that the
+/// caller has loaded itself)
+///
+/// Nothing is copied, so the bytes have to outlive the source.
+class MemoryByteSource : public ByteSource {
+protected:
+   const char* bytes_;  ///< The first byte
+
+public:
+   /// Read `new_size` bytes at `new_bytes` under the name `new_name`
+   ///
+   /// @throws runtime_error if there are no bytes
+   MemoryByteSource( const std::string& new_name, const char* new_bytes, size_t new_size );
+
+   const char* read( size_t offset, size_t length ) override;
+}; // MemoryByteSource
+
+
+/// Open `file_path` with the backend selected by `mode`
+///
+/// @throws runtime_error if the file can't be opened, is empty or can't be read
+/// @return A ByteSource for the file
+extern std::unique_ptr<ByteSource> open_byte_source( const std::string& file_path, LoadMode mode );
+
+
+/// What check_pe_signature() found
+enum class PeSignature {
+    PE          ///< The file starts with `MZ` and has `PE\0\0` at `e_lfanew`
+   ,NOT_PE      ///< The file was read and isn't a PE file
+   ,UNREADABLE  ///< The file couldn't be opened or read (open_byte_source() will say why)
+};
+
+
+/// Check the `MZ` and `PE\0\0` signatures of `file_path` without opening a ByteSource
+///
+/// This reads the 64-byte DOS header and, unless it's already in those
+/// bytes, the 4 bytes at `e_lfanew`.  Nothing is thrown, so rejecting a
+/// file that isn't a PE costs one small read.
+///
+/// @param file_path The file to check
+/// @return What was found
+extern PeSignature check_pe_signature( const std::string& file_path ) noexcept;
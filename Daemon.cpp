@@ -0,0 +1,301 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Serve reports to a long-running client (`readpe --daemon`)
+///
+/// @file   Daemon.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For max()
+#include <cerrno>     // For errno EINTR EMFILE ECONNABORTED ECONNREFUSED
+#include <csignal>    // For signal() sigaction() SIGPIPE SIGINT SIGTERM
+#include <cstring>    // For memchr() strncpy() strerror()
+#include <exception>  // For exception
+#include <ostream>    // For endl
+#include <stdexcept>  // For runtime_error
+
+#include <fcntl.h>       // For O_CLOEXEC
+#include <poll.h>        // For poll()
+#include <sys/socket.h>  // For socket() bind() listen() accept() connect()
+#include <sys/stat.h>    // For lstat() S_ISSOCK()
+#include <sys/un.h>      // For sockaddr_un
+#include <unistd.h>      // For pipe2() read() write() close() unlink()
+
+#include "Daemon.h"
+
+using namespace std;
+
+
+/// How much of the input is read at once
+#define READ_BYTES 4096
+
+/// The number of paths a PathStream reads ahead of each worker
+#define PATHS_PER_WORKER 4
+
+/// How long to wait before accepting again when there are no descriptors (or memory) for a connection
+#define ACCEPT_BACKOFF_MS 100
+
+
+PathStream::PathStream( const int fd, const size_t new_capacity )
+      :fd_      ( fd )            // Member initialization
+      ,capacity_( new_capacity )  // Member initialization
+{
+   if( pipe2( stop_, O_CLOEXEC ) != 0 ) {
+      throw runtime_error( "Unable to make a pipe" );
+   }
+   reader_ = thread( &PathStream::read_lines, this );
+}
+
+
+PathStream::~PathStream() {
+   {
+      const lock_guard<mutex> lock( mutex_ );
+      closed_ = true;
+      wake_   = nullptr;
+   }
+   room_.notify_all();
+   (void) !write( stop_[1], "", 1 );  // Wake the reader if it's waiting for input
+   reader_.join();
+   close( stop_[0] );
+   close( stop_[1] );
+}
+
+
+void PathStream::read_lines() {
+   string pending;  // The start of a line whose newline hasn't come in yet
+   char   buffer[ READ_BYTES ];
+   bool   open = true;
+   while( open ) {
+      pollfd waiting[2] = { { fd_, POLLIN, 0 }, { stop_[0], POLLIN, 0 } };
+      if( poll( waiting, 2, -1 ) < 0 ) {
+         if( errno == EINTR ) {
+            continue;
+         }
+         break;
+      }
+      if( waiting[1].revents != 0 ) {
+         break;  // The stream closed
+      }
+
+      const ssize_t got = read( fd_, buffer, sizeof( buffer ) );
+      if( got < 0 && errno == EINTR ) {
+         continue;
+      }
+      if( got <= 0 ) {
+         break;  // The end of the input (or a read that failed)
+      }
+
+      pending.append( buffer, static_cast<size_t>( got ) );
+      size_t start = 0;
+      for( size_t newline ; ( newline = pending.find( '\n', start ) ) != string::npos ; start = newline + 1 ) {
+         if( !push( pending.substr( start, newline - start ) ) ) {
+            open = false;
+            break;
+         }
+      }
+      pending.erase( 0, start );
+   }
+   if( open ) {
+      push( std::move( pending ) );  // A last line without a newline
+   }
+
+   const lock_guard<mutex> lock( mutex_ );
+   finished_ = true;
+   if( wake_ ) {
+      wake_();
+   }
+} // read_lines()
+
+
+bool PathStream::push( string path ) {
+   if( path.ends_with( '\r' ) ) {
+      path.pop_back();
+   }
+   if( path.empty() ) {
+      return true;
+   }
+
+   unique_lock<mutex> lock( mutex_ );
+   room_.wait( lock, [this] { return closed_ || queue_.size() < capacity_; } );
+   if( closed_ ) {
+      return false;
+   }
+   queue_.push_back( std::move( path ) );
+   if( wake_ ) {
+      wake_();
+   }
+   return true;
+} // push()
+
+
+PathSource::Next PathStream::next( string& path ) {
+   {
+      const lock_guard<mutex> lock( mutex_ );
+      if( queue_.empty() ) {
+         return finished_ ? Next::END : Next::WAIT;
+      }
+      path.assign( queue_.front() );
+      queue_.pop_front();
+   }
+   room_.notify_one();
+   return Next::PATH;
+}
+
+
+void PathStream::wake_on_ready( function<void()> wake ) {
+   const lock_guard<mutex> lock( mutex_ );
+   wake_ = std::move( wake );
+}
+
+
+BatchSummary serve_stream( ParserContext& context, const int in_fd, const int out_fd, ostream& errors ) {
+   PathStream paths { in_fd, max<size_t>( context.settings().jobs, 1 ) * PATHS_PER_WORKER };
+   return context.run( paths, out_fd, errors );
+}
+
+
+/// The write end of the pipe that wakes serve_socket() to stop (-1 when it isn't listening)
+static volatile sig_atomic_t shutdown_fd { -1 };
+
+/// The handler for SIGINT and SIGTERM while serve_socket() is listening
+static void request_shutdown( int ) {
+   const int saved_errno = errno;
+   (void) !write( shutdown_fd, "", 1 );
+   errno = saved_errno;
+}
+
+
+/// Try to connect to `address` (to see whether a daemon is still listening on it)
+///
+/// @return 0 if something accepted the connection, or the `errno` from `connect()`
+static int connect_error( const sockaddr_un& address ) {
+   const int probe = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+   if( probe < 0 ) {
+      return errno;
+   }
+   const int result = connect( probe, reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) ) == 0 ? 0 : errno;
+   close( probe );
+   return result;
+}
+
+
+/// Undoes what serve_socket() set up, however it leaves
+struct ListenGuard {
+   const string&    path;                     ///< The socket file
+   int              listener    { -1 };       ///< The listening socket
+   int              shutdown[2] { -1, -1 };   ///< The pipe that request_shutdown() writes to
+   bool             bound       { false };    ///< Set once #path is the listener's (so it's removed)
+   bool             signals     { false };    ///< Set once the handlers are installed
+   struct sigaction old_int     {};           ///< What SIGINT did before
+   struct sigaction old_term    {};           ///< What SIGTERM did before
+
+   ~ListenGuard() {
+      if( signals ) {
+         sigaction( SIGINT,  &old_int,  nullptr );
+         sigaction( SIGTERM, &old_term, nullptr );
+         shutdown_fd = -1;
+      }
+      if( bound ) {
+         (void) unlink( path.c_str() );
+      }
+      for( const int fd : { listener, shutdown[0], shutdown[1] } ) {
+         if( fd >= 0 ) {
+            close( fd );
+         }
+      }
+   }
+};
+
+
+BatchSummary serve_socket( ParserContext& context, const string& socket_path, ostream& errors ) {
+   sockaddr_un address {};
+   address.sun_family = AF_UNIX;
+   if( socket_path.size() >= sizeof( address.sun_path ) ) {
+      throw runtime_error( "The socket path is too long: " + socket_path );
+   }
+   strncpy( address.sun_path, socket_path.c_str(), sizeof( address.sun_path ) - 1 );
+
+   ListenGuard guard { socket_path };
+   if( pipe2( guard.shutdown, O_CLOEXEC | O_NONBLOCK ) != 0 ) {
+      throw runtime_error( "Unable to make a pipe" );
+   }
+   guard.listener = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0 );
+   if( guard.listener < 0 ) {
+      throw runtime_error( "Unable to make a socket" );
+   }
+   struct stat existing {};
+   if( lstat( socket_path.c_str(), &existing ) == 0 ) {
+      if( !S_ISSOCK( existing.st_mode ) ) {  // Never remove a file that isn't a socket
+         throw runtime_error( "Unable to listen on " + socket_path );
+      }
+      const int probed = connect_error( address );
+      if( probed == 0 ) {
+         throw runtime_error( "Unable to listen on " + socket_path + ": another daemon is listening on it" );
+      }
+      if( probed != ECONNREFUSED ) {
+         throw runtime_error( "Unable to listen on " + socket_path + ": " + strerror( probed ) );
+      }
+      (void) unlink( socket_path.c_str() );  // Nothing is listening, so it was left behind by an earlier daemon
+   }
+   if( bind( guard.listener, reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) ) != 0 ) {
+      throw runtime_error( "Unable to listen on " + socket_path );
+   }
+   guard.bound = true;
+   if( listen( guard.listener, SOMAXCONN ) != 0 ) {
+      throw runtime_error( "Unable to listen on " + socket_path );
+   }
+
+   signal( SIGPIPE, SIG_IGN );  // A client that goes away makes the write fail instead
+
+   shutdown_fd = guard.shutdown[1];
+   struct sigaction stop {};
+   stop.sa_handler = request_shutdown;
+   sigemptyset( &stop.sa_mask );
+   sigaction( SIGINT,  &stop, &guard.old_int );
+   sigaction( SIGTERM, &stop, &guard.old_term );
+   guard.signals = true;
+
+   BatchSummary summary;
+   bool         backing_off { false };  // Set while accept4() is out of descriptors or memory
+   while( true ) {
+      pollfd waiting[2] = { { guard.listener, POLLIN, 0 }, { guard.shutdown[0], POLLIN, 0 } };
+      if( poll( waiting, 2, -1 ) < 0 ) {
+         if( errno == EINTR ) {
+            continue;
+         }
+         throw runtime_error( "Unable to wait for connections on " + socket_path );
+      }
+      if( waiting[1].revents != 0 ) {
+         return summary;  // SIGINT or SIGTERM (the guard removes the socket)
+      }
+
+      const int client = accept4( guard.listener, nullptr, nullptr, SOCK_CLOEXEC );
+      if( client < 0 ) {
+         const int error = errno;
+         if( error == EINTR || error == ECONNABORTED || error == EAGAIN || error == EWOULDBLOCK ) {
+            continue;  // Interrupted, or a connection that was dropped before it was accepted
+         }
+         if( error == EMFILE || error == ENFILE || error == ENOMEM || error == ENOBUFS ) {
+            // The connection stays queued and accept4() would fail again
+            // straight away, so wait (or stop) before trying it again
+            if( !backing_off ) {
+               errors << socket_path << ": Unable to accept a connection: " << strerror( error ) << endl;
+            }
+            backing_off = true;
+            pollfd stopping { guard.shutdown[0], POLLIN, 0 };
+            (void) poll( &stopping, 1, ACCEPT_BACKOFF_MS );
+            continue;
+         }
+         throw runtime_error( "Unable to accept connections on " + socket_path + ": " + strerror( error ) );
+      }
+      backing_off = false;
+      try {
+         summary.add( serve_stream( context, client, client, errors ) );
+      } catch( const exception& e ) {
+         errors << socket_path << ": " << e.what() << endl;
+      }
+      close( client );
+   }
+} // serve_socket()
@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Serve reports to a long-running client (`readpe --daemon`)
+///
+/// A daemon reads paths one per line, from stdin or from each connection
+/// to a Unix socket, and streams each file's report back as soon as it
+/// (and every report before it) is done.  Every path goes through the
+/// same ParserContext, so a service that asks for one file at a time pays
+/// for a report and nothing else: no process to start, no options to
+/// parse, and threads, arenas and buffers that are already warm.
+///
+/// Failures are written to the error stream and the daemon keeps going.
+/// With `--format=json` (one line per file) or `--format=binary` (sized
+/// records) every path gets exactly one record back: reported, failed or
+/// skipped by `--prefilter`.
+///
+/// @file   Daemon.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <condition_variable>  // For condition_variable
+#include <cstddef>             // For size_t
+#include <deque>               // For deque
+#include <functional>          // For function
+#include <mutex>               // For mutex
+#include <ostream>             // For ostream
+#include <string>              // For string
+#include <thread>              // For thread
+
+#include "Batch.h"
+#include "ParserContext.h"
+
+
+/// A PathSource that reads paths from a file descriptor, one per line, as they arrive
+///
+/// A reader thread waits on the descriptor and queues each line as soon as
+/// its newline comes in (a last line without one is queued at the end of
+/// the input).  Empty lines are skipped and a trailing `\r` is dropped.
+class PathStream : public PathSource {
+protected:
+   int                     fd_;                  ///< Where the paths come from (not owned)
+   size_t                  capacity_;            ///< The most paths to hold at once
+   int                     stop_[2] { -1, -1 };  ///< A pipe that wakes the reader when it's time to stop
+   std::mutex              mutex_;               ///< Guards everything below
+   std::condition_variable room_;                ///< Signalled when a path is taken or the stream closes
+   std::deque<std::string> queue_;               ///< The paths that have been read but not taken
+   bool                    finished_ { false };  ///< Set at the end of the input
+   bool                    closed_   { false };  ///< Set when nobody will take any more paths
+   std::function<void()>   wake_;                ///< Called when a path is queued or the input ends
+   std::thread             reader_;              ///< Reads #fd_ (started last)
+
+   /// Read lines until the end of the input or until the stream closes (the body of #reader_)
+   void read_lines();
+
+   /// Queue `path`, waiting for room
+   ///
+   /// @return `false` if the stream closed
+   bool push( std::string path );
+
+public:
+   /// Start reading paths from `fd`
+   ///
+   /// @param fd           Where the paths come from (a pipe, a socket or a file)
+   /// @param new_capacity The most paths to read ahead of the Batch
+   /// @throws runtime_error if the stop pipe can't be made
+   PathStream( int fd, size_t new_capacity );
+
+   /// Stop reading and join the reader
+   ~PathStream() override;
+
+   PathStream( const PathStream& ) = delete;             ///< A PathStream owns a thread
+   PathStream& operator=( const PathStream& ) = delete;  ///< A PathStream owns a thread
+
+   Next next( std::string& path ) override;
+   void wake_on_ready( std::function<void()> wake ) override;
+}; // PathStream
+
+
+/// Report each path read from `in_fd` to `out_fd` until the end of the input
+///
+/// @return The number of files processed and the failures
+extern BatchSummary serve_stream( ParserContext& context, int in_fd, int out_fd, std::ostream& errors );
+
+/// Listen on the Unix socket at `socket_path` and serve_stream() each
+/// connection back to itself, one connection at a time, until SIGINT or
+/// SIGTERM
+///
+/// A socket that's already at `socket_path` is replaced if nothing is
+/// listening on it (a daemon that's still running keeps it, and this one
+/// doesn't start).  A client that goes away in the middle of its reports
+/// ends its connection, not the daemon.  A signal stops the daemon once the connection that's being
+/// served (if any) ends, and the socket is removed however it stops.
+///
+/// @return The number of files processed and the failures, over every connection
+/// @throws runtime_error if the socket can't be set up or stops accepting connections
+extern BatchSummary serve_socket( ParserContext& context, const std::string& socket_path, std::ostream& errors );
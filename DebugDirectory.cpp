@@ -0,0 +1,118 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Read the debug directory of a PE image
+///
+/// @file   DebugDirectory.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For min()
+#include <cstring>    // For memchr()
+#include <stdexcept>  // For out_of_range domain_error
+
+#include "DebugDirectory.h"
+
+using namespace std;
+
+
+/// The Type of a CodeView entry
+#define IMAGE_DEBUG_TYPE_CODEVIEW 2
+
+/// `RSDS` (the signature of a PDB 7.0 CodeView record) as a little-endian number
+#define RSDS_SIGNATURE 0x53445352
+
+/// The size of an `RSDS` record before the PDB path (signature, GUID and age)
+#define RSDS_HEADER_SIZE 24
+
+
+DebugDirectory::DebugDirectory( const ImageReader& image, const DataDirectory& directory )
+      :image_    ( image )      // Member initialization
+      ,directory_( directory )  // Member initialization
+{
+   if( size() > MAX_ENTRIES ) {
+      throw domain_error( "The debug directory has too many entries" );
+   }
+}
+
+
+DebugDirectoryView DebugDirectory::entry( const size_t index ) const {
+   const optional<uint32_t> offset = image_.sections().rva_to_offset( directory_.virtual_address + static_cast<uint32_t>( index * ENTRY_SIZE ) );
+   if( !offset ) {
+      throw out_of_range( "The debug directory is not in the file" );
+   }
+   DebugDirectoryView view { *offset };
+   view.bind( image_.source() );
+   return view;
+}
+
+
+optional<CodeViewInfo> DebugDirectory::codeview( const DebugDirectoryView& entry ) const {
+   const uint32_t size_of_data = entry.get<DBG_SIZE_OF_DATA>();
+   if( entry.get<DBG_TYPE>() != IMAGE_DEBUG_TYPE_CODEVIEW || size_of_data < RSDS_HEADER_SIZE ) {
+      return nullopt;
+   }
+
+   // The path is NUL-terminated, so don't read more than the longest string we'd look for
+   const size_t   length = min<size_t>( size_of_data, RSDS_HEADER_SIZE + ImageReader::MAX_STRING_LENGTH );
+   const uint32_t rva    = entry.get<DBG_ADDRESS_OF_RAW_DATA>();
+   const char*    record = rva != 0 ? image_.read( rva, length )
+                                    : image_.source().read( entry.get<DBG_POINTER_TO_RAW_DATA>(), length );  // Not mapped, so it's only in the file
+   if( load_le<uint32_t>( record ) != RSDS_SIGNATURE ) {
+      return nullopt;
+   }
+
+   CodeViewInfo info;
+   info.guid = reinterpret_cast<const uint8_t*>( record + 4 );
+   info.age  = load_le<uint32_t>( record + 20 );
+
+   const char*  path     = record + RSDS_HEADER_SIZE;
+   const size_t max_path = length - RSDS_HEADER_SIZE;
+   const void*  nul      = memchr( path, '\0', max_path );
+   info.pdb_path = string_view( path, nul != nullptr ? static_cast<size_t>( static_cast<const char*>( nul ) - path ) : max_path );
+   return info;
+} // codeview()
+
+
+/// Append the `digits` lowest hex digits of `value` in upper case
+static void append_upper_hex( string& out, const uint64_t value, const size_t digits ) {
+   static constexpr char DIGITS[] = "0123456789ABCDEF";
+   for( size_t i = digits ; i > 0 ; i-- ) {
+      out.push_back( DIGITS[ ( value >> ( ( i - 1 ) * 4 ) ) & 0x0F ] );
+   }
+}
+
+
+/// Append the GUID at `guid`, with a `-` between its parts if `dashes`
+///
+/// The first three parts are stored little-endian, and the last 8 bytes in order.
+static void append_guid_parts( string& out, const uint8_t* guid, const bool dashes ) {
+   const char* bytes = reinterpret_cast<const char*>( guid );
+   append_upper_hex( out, load_le<uint32_t>( bytes     ), 8 );
+   if( dashes ) { out.push_back( '-' ); }
+   append_upper_hex( out, load_le<uint16_t>( bytes + 4 ), 4 );
+   if( dashes ) { out.push_back( '-' ); }
+   append_upper_hex( out, load_le<uint16_t>( bytes + 6 ), 4 );
+   for( size_t i = 8 ; i < 16 ; i++ ) {
+      if( dashes && ( i == 8 || i == 10 ) ) { out.push_back( '-' ); }
+      append_upper_hex( out, guid[i], 2 );
+   }
+}
+
+
+void append_guid( string& out, const CodeViewInfo& info ) {
+   append_guid_parts( out, info.guid, true );
+}
+
+
+void append_pdb_signature( string& out, const CodeViewInfo& info ) {
+   append_guid_parts( out, info.guid, false );
+
+   // The age has no leading zeros
+   size_t digits = 1;
+   while( digits < 8 && ( info.age >> ( digits * 4 ) ) != 0 ) {
+      digits++;
+   }
+   append_upper_hex( out, info.age, digits );
+}
@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Read the debug directory of a PE image
+///
+/// The debug directory is an array of 28-byte `IMAGE_DEBUG_DIRECTORY`
+/// entries.  Each one is viewed in place with a HeaderView, and the
+/// CodeView entry's `RSDS` record (the PDB's GUID, its age and its path)
+/// is returned as views into the ByteSource, so finding the key that a
+/// symbol server files a PDB under copies nothing.
+///
+/// @see https://learn.microsoft.com/en-us/windows/win32/debug/pe-format#the-debug-section
+///
+/// @file   DebugDirectory.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <array>        // For array
+#include <cstddef>      // For size_t
+#include <cstdint>      // For uint8_t uint32_t
+#include <optional>     // For optional
+#include <string>       // For string
+#include <string_view>  // For string_view
+
+#include "HeaderView.h"
+#include "ImageReader.h"
+
+
+/// The layout of one debug directory entry
+inline constexpr std::array<FieldDescriptor, 8> DEBUG_LAYOUT {{
+    { "01_dbg_Characteristics",  0x00, 4, AS_DEC,             "Characteristics"     }
+   ,{ "02_dbg_TimeDateStamp",    0x04, 4, AS_DEC | WITH_TIME, "Date/time stamp"     }
+   ,{ "03_dbg_MajorVersion",     0x08, 2, AS_DEC,             "Major version"       }
+   ,{ "04_dbg_MinorVersion",     0x0A, 2, AS_DEC,             "Minor version"       }
+   ,{ "05_dbg_Type",             0x0C, 4, AS_DEC | WITH_FLAG, "Type",               &DEBUG_TYPE_FLAGS }
+   ,{ "06_dbg_SizeOfData",       0x10, 4, AS_DEC,             "Size of data"        }
+   ,{ "07_dbg_AddressOfRawData", 0x14, 4, AS_HEX,             "Address of raw data" }
+   ,{ "08_dbg_PointerToRawData", 0x18, 4, AS_HEX,             "Pointer to raw data" }
+}}; // DEBUG_LAYOUT
+
+/// Indexes into #DEBUG_LAYOUT
+enum Debug_Field : size_t {
+    DBG_CHARACTERISTICS
+   ,DBG_TIME_DATE_STAMP
+   ,DBG_MAJOR_VERSION
+   ,DBG_MINOR_VERSION
+   ,DBG_TYPE
+   ,DBG_SIZE_OF_DATA
+   ,DBG_ADDRESS_OF_RAW_DATA
+   ,DBG_POINTER_TO_RAW_DATA
+};
+
+/// A view of one debug directory entry
+using DebugDirectoryView = HeaderView<DEBUG_LAYOUT>;
+
+
+/// What a CodeView (`RSDS`) record says about the PDB that matches the image
+struct CodeViewInfo {
+   const uint8_t*   guid     { nullptr };  ///< The 16 bytes of the PDB's GUID, as they're stored
+   uint32_t         age      { 0 };        ///< The number of times the PDB has been written
+   std::string_view pdb_path;              ///< The path of the PDB when the image was linked
+};
+
+
+/// The debug directory of a PEFile
+class DebugDirectory {
+public:
+   /// The size of one entry
+   static constexpr size_t ENTRY_SIZE = DebugDirectoryView::EXTENT;
+
+   /// The most entries that the directory can have (real images have a handful)
+   static constexpr size_t MAX_ENTRIES = 256;
+
+protected:
+   ImageReader   image_;      ///< Where to read the entries
+   DataDirectory directory_;  ///< The Debug entry in the data directory
+
+public:
+   /// View the debug directory described by `directory` (nothing is read yet)
+   ///
+   /// @param image     Where to read the image
+   /// @param directory The Debug entry from the data directory
+   /// @throws domain_error if the directory has more than #MAX_ENTRIES entries
+   DebugDirectory( const ImageReader& image, const DataDirectory& directory );
+
+   size_t size() const {
+      return directory_.size / ENTRY_SIZE;  /// @return The number of entries
+   }
+
+   /// @return A view of the entry at `index`
+   /// @throws out_of_range if the entry isn't in the file
+   DebugDirectoryView entry( size_t index ) const;
+
+   /// Read the `RSDS` record that a CodeView entry points at
+   ///
+   /// @return The record, or nothing if `entry` isn't a CodeView entry with
+   ///         an `RSDS` record (like the old `NB10` ones)
+   /// @throws out_of_range if the record isn't in the file
+   std::optional<CodeViewInfo> codeview( const DebugDirectoryView& entry ) const;
+}; // DebugDirectory
+
+
+/// Append the GUID in `info` the way it's usually written (`XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX`)
+extern void append_guid( std::string& out, const CodeViewInfo& info );
+
+/// Append the key that a symbol server files the PDB under (the GUID
+/// without dashes followed by the age, in upper-case hex)
+extern void append_pdb_signature( std::string& out, const CodeViewInfo& info );
@@ -0,0 +1,213 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Byte histograms and Shannon entropy
+///
+/// @file   Entropy.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For min()
+#include <cmath>      // For log2()
+#include <cstdint>    // For UINT32_MAX UINT64_MAX
+#include <cstring>    // For memcpy()
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+   #include <immintrin.h>  // For the AVX2 intrinsics
+   #define HAVE_X86_KERNELS
+#endif
+
+#if defined( __ARM_NEON ) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   #include <arm_neon.h>   // For the NEON intrinsics
+   #define HAVE_NEON_KERNELS
+#endif
+
+#include "Entropy.h"
+
+using namespace std;
+
+
+/// One sub-histogram for the even bytes and one for the odd ones
+#define SUB_HISTOGRAMS 2
+
+/// The most bytes a kernel counts before its 32-bit counters are flushed
+#define BLOCK_SIZE ( uint64_t{ 1 } << 31 )
+
+
+/// The counters a kernel works in (the sub-histograms are added up afterward)
+using SubHistograms = uint32_t[SUB_HISTOGRAMS][256];
+
+/// A kernel counts at most #BLOCK_SIZE bytes into `counts`
+using Kernel = void (*)( const unsigned char* data, size_t length, SubHistograms& counts );
+
+
+/// Count `length` bytes one at a time, alternating between the sub-histograms
+static inline void count_run( const unsigned char* data, const size_t length, SubHistograms& counts ) {
+   size_t i = 0;
+   for( ; i + 2 <= length ; i += 2 ) {
+      counts[0][ data[i]     ]++;
+      counts[1][ data[i + 1] ]++;
+   }
+   if( i < length ) {
+      counts[0][ data[i] ]++;
+   }
+}
+
+
+/// The portable kernel: a word of one repeated byte is counted at once,
+/// any other word a byte at a time
+static void count_scalar( const unsigned char* data, const size_t length, SubHistograms& counts ) {
+   size_t i = 0;
+   for( ; i + 8 <= length ; i += 8 ) {
+      uint64_t word;
+      memcpy( &word, data + i, sizeof( word ) );
+      if( word == ( word & 0xFF ) * 0x0101010101010101 ) {
+         counts[0][ data[i] ] += 8;
+      } else {
+         count_run( data + i, 8, counts );
+      }
+   }
+   count_run( data + i, length - i, counts );
+}
+
+
+#if defined( HAVE_X86_KERNELS )
+/// The AVX2 kernel: a vector that's 32 copies of its first byte is counted
+/// with one compare, any other vector a byte at a time
+__attribute__(( target( "avx2" ) ))
+static void count_avx2( const unsigned char* data, const size_t length, SubHistograms& counts ) {
+   size_t i = 0;
+   for( ; i + 32 <= length ; i += 32 ) {
+      const __m256i block = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + i ) );
+      const __m256i first = _mm256_broadcastb_epi8( _mm256_castsi256_si128( block ) );
+      if( static_cast<uint32_t>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( block, first ) ) ) == UINT32_MAX ) {
+         counts[0][ data[i] ] += 32;
+      } else {
+         count_run( data + i, 32, counts );
+      }
+   }
+   count_scalar( data + i, length - i, counts );
+}
+#endif
+
+
+#if defined( HAVE_NEON_KERNELS )
+/// The NEON kernel: a vector that's 16 copies of its first byte is counted
+/// with one compare, any other vector a byte at a time
+static void count_neon( const unsigned char* data, const size_t length, SubHistograms& counts ) {
+   size_t i = 0;
+   for( ; i + 16 <= length ; i += 16 ) {
+      const uint8x16_t block = vld1q_u8( data + i );
+      const uint64x2_t same  = vreinterpretq_u64_u8( vceqq_u8( block, vdupq_n_u8( data[i] ) ) );
+      if( ( vgetq_lane_u64( same, 0 ) & vgetq_lane_u64( same, 1 ) ) == UINT64_MAX ) {
+         counts[0][ data[i] ] += 16;
+      } else {
+         count_run( data + i, 16, counts );
+      }
+   }
+   count_scalar( data + i, length - i, counts );
+}
+#endif
+
+
+/// The kernel for this CPU and its name
+struct KernelChoice {
+   Kernel      kernel;  ///< The function
+   const char* name;    ///< What to call it
+};
+
+
+/// @return The widest kernel that this CPU can run
+static KernelChoice select_kernel() {
+#if defined( HAVE_X86_KERNELS )
+   __builtin_cpu_init();
+   if( __builtin_cpu_supports( "avx2" ) ) {
+      return { count_avx2, "avx2" };
+   }
+#endif
+#if defined( HAVE_NEON_KERNELS )
+   return { count_neon, "neon" };
+#endif
+   return { count_scalar, "scalar" };
+}
+
+
+/// @return The kernel (chosen once, the first time it's asked for)
+static const KernelChoice& kernel_choice() {
+   static const KernelChoice choice = select_kernel();
+   return choice;
+}
+
+
+const char* histogram_kernel_name() {
+   return kernel_choice().name;
+}
+
+
+/// Add the bytes in [`data`, `data` + `length`) to `histogram` with `kernel`
+static void count_with( const Kernel kernel, const unsigned char* data, size_t length, ByteHistogram& histogram ) {
+   while( length > 0 ) {
+      const size_t  block = static_cast<size_t>( min<uint64_t>( length, BLOCK_SIZE ) );
+      SubHistograms counts {};
+
+      kernel( data, block, counts );
+
+      for( size_t value = 0 ; value < 256 ; value++ ) {
+         for( size_t sub = 0 ; sub < SUB_HISTOGRAMS ; sub++ ) {
+            histogram[value] += counts[sub][value];
+         }
+      }
+      data   += block;
+      length -= block;
+   }
+} // count_with()
+
+
+void count_bytes( const unsigned char* data, const size_t length, ByteHistogram& histogram ) {
+   count_with( kernel_choice().kernel, data, length, histogram );
+}
+
+
+bool count_bytes_with( const string_view kernel_name, const unsigned char* data, const size_t length, ByteHistogram& histogram ) {
+   Kernel kernel = nullptr;
+   if( kernel_name == "scalar" ) {
+      kernel = count_scalar;
+   }
+#if defined( HAVE_X86_KERNELS )
+   __builtin_cpu_init();
+   if( kernel_name == "avx2" && __builtin_cpu_supports( "avx2" ) ) {
+      kernel = count_avx2;
+   }
+#endif
+#if defined( HAVE_NEON_KERNELS )
+   if( kernel_name == "neon" ) {
+      kernel = count_neon;
+   }
+#endif
+   if( kernel == nullptr ) {
+      return false;
+   }
+   count_with( kernel, data, length, histogram );
+   return true;
+}
+
+
+double shannon_entropy( const ByteHistogram& histogram ) {
+   uint64_t total = 0;
+   for( const uint64_t count : histogram ) {
+      total += count;
+   }
+   if( total == 0 ) {
+      return 0.0;
+   }
+
+   double entropy = 0.0;
+   for( const uint64_t count : histogram ) {
+      if( count != 0 ) {
+         const double probability = static_cast<double>( count ) / static_cast<double>( total );
+         entropy -= probability * log2( probability );
+      }
+   }
+   return entropy;
+} // shannon_entropy()
@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Byte histograms and Shannon entropy
+///
+/// Counting bytes is a scatter, so every `counts[byte]++` that hits the
+/// same counter as the one before it has to wait for that store.  That's
+/// at its worst in a run of one byte value, which sections are full of
+/// (zero padding, `0xCC` fill between functions).  The kernels compare a
+/// whole vector against its first byte and count a vector of one value
+/// with a single add, and spread the bytes of any other vector over two
+/// sub-histograms (added up at the end).  Neither AVX2 nor NEON can
+/// scatter, so the bytes of a mixed vector are still counted one at a
+/// time.  The widest kernel that the CPU supports is picked the first
+/// time it's needed.
+///
+/// @file   Entropy.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <array>        // For array
+#include <cstddef>      // For size_t
+#include <cstdint>      // For uint64_t
+#include <string_view>  // For string_view
+
+
+/// The number of times each byte value occurs
+using ByteHistogram = std::array<uint64_t, 256>;
+
+
+/// Add the bytes in [`data`, `data` + `length`) to `histogram`
+extern void count_bytes( const unsigned char* data, size_t length, ByteHistogram& histogram );
+
+/// @return The name of the kernel that count_bytes() uses on this CPU
+extern const char* histogram_kernel_name();
+
+/// Add the bytes to `histogram` with the kernel called `kernel_name`
+/// (`scalar`, `avx2` or `neon`) rather than the one for this CPU
+///
+/// @return `false` if this build or this CPU doesn't have that kernel
+extern bool count_bytes_with( std::string_view kernel_name, const unsigned char* data, size_t length, ByteHistogram& histogram );
+
+/// @return The Shannon entropy of `histogram` in bits per byte (0 to 8)
+extern double shannon_entropy( const ByteHistogram& histogram );
@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Look up the exports of a PE image
+///
+/// @file   Exports.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <bit>        // For bit_ceil()
+#include <stdexcept>  // For out_of_range
+
+#include "Exports.h"
+
+using namespace std;
+
+
+ExportTable::ExportTable( const ImageReader& image, const DataDirectory& directory )
+      :image_    ( image )      // Member initialization
+      ,directory_( directory )  // Member initialization
+{
+   if( empty() ) {
+      return;
+   }
+
+   const optional<uint32_t> offset = image_.sections().rva_to_offset( directory_.virtual_address );
+   if( !offset ) {
+      throw out_of_range( "The export directory is not in the file" );
+   }
+   header_ = ExportDirectoryView { *offset };
+   header_.bind( image_.source() );
+
+   ordinal_base_        = header_.get<EXP_ORDINAL_BASE>();
+   number_of_functions_ = header_.get<EXP_ADDRESS_TABLE_ENTRIES>();
+   number_of_names_     = header_.get<EXP_NUMBER_OF_NAME_POINTERS>();
+
+   if( number_of_functions_ > 0 ) {
+      address_table_ = image_.read( header_.get<EXP_EXPORT_ADDRESS_TABLE_RVA>(), size_t{ number_of_functions_ } * 4 );
+   }
+   if( number_of_names_ > 0 ) {
+      name_pointers_ = image_.read( header_.get<EXP_NAME_POINTER_RVA>(),  size_t{ number_of_names_ } * 4 );
+      ordinals_      = image_.read( header_.get<EXP_ORDINAL_TABLE_RVA>(), size_t{ number_of_names_ } * 2 );
+   }
+} // ExportTable()
+
+
+string_view ExportTable::dll_name() const {
+   return image_.read_string( header_.get<EXP_NAME_RVA>() );
+}
+
+
+string_view ExportTable::name_at( const uint32_t index ) const {
+   return image_.read_string( load_le<uint32_t>( name_pointers_ + index * 4 ) );
+}
+
+
+optional<ExportedFunction> ExportTable::make_export( const uint32_t index, const string_view name ) const {
+   if( index >= number_of_functions_ ) {
+      return nullopt;
+   }
+   const uint32_t rva = load_le<uint32_t>( address_table_ + index * 4 );
+   if( rva == 0 ) {
+      return nullopt;  // A gap in the ordinals
+   }
+
+   ExportedFunction function { ordinal_base_ + index, rva, name, {} };
+
+   // An address inside the export directory is the name of a function in another DLL
+   if( rva - directory_.virtual_address < directory_.size ) {
+      function.forwarder = image_.read_string( rva );
+   }
+   return function;
+} // make_export()
+
+
+optional<ExportedFunction> ExportTable::named_export_at( const uint32_t index ) const {
+   return make_export( ordinal_index_at( index ), name_at( index ) );
+}
+
+
+optional<ExportedFunction> ExportTable::find( const uint32_t ordinal ) const {
+   if( ordinal < ordinal_base_ ) {
+      return nullopt;
+   }
+   return make_export( ordinal - ordinal_base_, {} );
+}
+
+
+optional<ExportedFunction> ExportTable::find( const string_view name ) const {
+   uint32_t low  = 0;
+   uint32_t high = number_of_names_;
+   while( low < high ) {
+      const uint32_t    middle    = low + ( high - low ) / 2;
+      const string_view candidate = name_at( middle );
+      const int         order     = candidate.compare( name );
+      if( order == 0 ) {
+         return make_export( ordinal_index_at( middle ), candidate );
+      }
+      if( order < 0 ) {
+         low = middle + 1;
+      } else {
+         high = middle;
+      }
+   }
+   return nullopt;
+} // find()
+
+
+uint64_t ExportHashIndex::hash( const string_view name ) {
+   uint64_t result = 0xcbf29ce484222325;  // The FNV-1a offset basis
+   for( const char character : name ) {
+      result ^= static_cast<unsigned char>( character );
+      result *= 0x100000001b3;            // The FNV-1a prime
+   }
+   return result;
+}
+
+
+ExportHashIndex::ExportHashIndex( const ExportTable& table, pmr::memory_resource* arena )
+      :table_( &table )                                                                    // Member initialization
+      ,slots_( bit_ceil( size_t{ table.get_number_of_names() } * 2 + 1 ), EMPTY, arena )  // Member initialization
+{
+   const size_t mask = slots_.size() - 1;
+   for( uint32_t i = 0 ; i < table.get_number_of_names() ; i++ ) {
+      size_t slot = hash( table.name_at( i ) ) & mask;
+      while( slots_[slot] != EMPTY ) {
+         slot = ( slot + 1 ) & mask;
+      }
+      slots_[slot] = i;
+   }
+}
+
+
+optional<ExportedFunction> ExportHashIndex::find( const string_view name ) const {
+   const size_t mask = slots_.size() - 1;
+   for( size_t slot = hash( name ) & mask ; slots_[slot] != EMPTY ; slot = ( slot + 1 ) & mask ) {
+      if( table_->name_at( slots_[slot] ) == name ) {
+         return table_->named_export_at( slots_[slot] );
+      }
+   }
+   return nullopt;
+}
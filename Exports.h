@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Look up the exports of a PE image
+///
+/// The export directory points at three arrays: the export address table
+/// (indexed by ordinal - OrdinalBase), the name pointer table (sorted by
+/// name) and the ordinal table (parallel to the name pointer table).  The
+/// ExportTable views all three in place, so a lookup by ordinal is O(1) and
+/// a lookup by name is a binary search, with nothing copied.
+///
+/// @see https://learn.microsoft.com/en-us/windows/win32/debug/pe-format#the-edata-section-image-only
+///
+/// @file   Exports.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <array>            // For array
+#include <cstddef>          // For size_t
+#include <cstdint>          // For uint16_t uint32_t
+#include <memory_resource>  // For memory_resource
+#include <optional>         // For optional
+#include <string_view>      // For string_view
+#include <vector>           // For vector pmr::vector
+
+#include "HeaderView.h"
+#include "ImageReader.h"
+
+
+/// The layout of the export directory table
+inline constexpr std::array<FieldDescriptor, 11> EXPORT_LAYOUT {{
+    { "01_exp_Characteristics",       0x00, 4, AS_HEX,             "Characteristics"           }
+   ,{ "02_exp_TimeDateStamp",         0x04, 4, AS_DEC | WITH_TIME, "Date/time stamp"           }
+   ,{ "03_exp_MajorVersion",          0x08, 2, AS_DEC,             "Major version"             }
+   ,{ "04_exp_MinorVersion",          0x0A, 2, AS_DEC,             "Minor version"             }
+   ,{ "05_exp_NameRVA",               0x0C, 4, AS_HEX,             "Name RVA"                  }
+   ,{ "06_exp_OrdinalBase",           0x10, 4, AS_DEC,             "Ordinal base"              }
+   ,{ "07_exp_AddressTableEntries",   0x14, 4, AS_DEC,             "Address table entries"     }
+   ,{ "08_exp_NumberOfNamePointers",  0x18, 4, AS_DEC,             "Number of name pointers"   }
+   ,{ "09_exp_ExportAddressTableRVA", 0x1C, 4, AS_HEX,             "Export address table RVA"  }
+   ,{ "10_exp_NamePointerRVA",        0x20, 4, AS_HEX,             "Name pointer RVA"          }
+   ,{ "11_exp_OrdinalTableRVA",       0x24, 4, AS_HEX,             "Ordinal table RVA"         }
+}}; // EXPORT_LAYOUT
+
+/// Indexes into #EXPORT_LAYOUT
+enum Export_Field : size_t {
+    EXP_CHARACTERISTICS
+   ,EXP_TIME_DATE_STAMP
+   ,EXP_MAJOR_VERSION
+   ,EXP_MINOR_VERSION
+   ,EXP_NAME_RVA
+   ,EXP_ORDINAL_BASE
+   ,EXP_ADDRESS_TABLE_ENTRIES
+   ,EXP_NUMBER_OF_NAME_POINTERS
+   ,EXP_EXPORT_ADDRESS_TABLE_RVA
+   ,EXP_NAME_POINTER_RVA
+   ,EXP_ORDINAL_TABLE_RVA
+};
+
+/// A view of the export directory table
+using ExportDirectoryView = HeaderView<EXPORT_LAYOUT>;
+
+
+/// One exported function
+struct ExportedFunction {
+   uint32_t         ordinal { 0 };  ///< The ordinal (OrdinalBase + its index in the address table)
+   uint32_t         rva     { 0 };  ///< The address of the function (or of the forwarder string)
+   std::string_view name;           ///< The name it's exported under (empty if it's looked up by ordinal)
+   std::string_view forwarder;      ///< `DLL.Function` if the export is forwarded to another DLL
+};
+
+
+/// The export directory of a PEFile
+class ExportTable {
+protected:
+   ImageReader         image_;                            ///< Where to read the tables
+   DataDirectory       directory_;                        ///< The Export Table entry in the data directory
+   ExportDirectoryView header_              { 0 };        ///< The export directory table
+   uint32_t            ordinal_base_        { 0 };        ///< The ordinal of the first entry in the address table
+   uint32_t            number_of_functions_ { 0 };        ///< The entries in the address table
+   uint32_t            number_of_names_     { 0 };        ///< The entries in the name pointer and ordinal tables
+   const char*         address_table_       { nullptr };  ///< The export address table (4 bytes per entry)
+   const char*         name_pointers_       { nullptr };  ///< The name pointer table (4 bytes per entry)
+   const char*         ordinals_            { nullptr };  ///< The ordinal table (2 bytes per entry)
+
+   /// @return The export at `index` in the address table, named `name`
+   std::optional<ExportedFunction> make_export( uint32_t index, std::string_view name ) const;
+
+public:
+   /// View the export directory described by `directory`
+   ///
+   /// @param image     Where to read the image
+   /// @param directory The Export Table entry from the data directory
+   /// @throws out_of_range if the directory or its tables aren't in the file
+   ExportTable( const ImageReader& image, const DataDirectory& directory );
+
+   bool empty() const {
+      return directory_.size == 0;  /// @return `true` if the image has no exports
+   }
+
+   const ExportDirectoryView& header() const {
+      return header_;  /// @return The export directory table
+   }
+
+   /// @return The name of the DLL (as it was linked)
+   std::string_view dll_name() const;
+
+   uint32_t get_ordinal_base() const {
+      return ordinal_base_;  /// @return The ordinal of the first entry in the address table
+   }
+
+   uint32_t get_number_of_functions() const {
+      return number_of_functions_;  /// @return The entries in the address table
+   }
+
+   uint32_t get_number_of_names() const {
+      return number_of_names_;  /// @return The number of exports that have names
+   }
+
+   /// @return The name at `index` in the (sorted) name pointer table
+   std::string_view name_at( uint32_t index ) const;
+
+   /// @return The address table index of the name at `index` in the name pointer table
+   uint16_t ordinal_index_at( uint32_t index ) const {
+      return load_le<uint16_t>( ordinals_ + index * 2 );
+   }
+
+   /// @return The export with the name at `index` in the name pointer table
+   std::optional<ExportedFunction> named_export_at( uint32_t index ) const;
+
+   /// Look up an export by ordinal in O(1)
+   ///
+   /// The name isn't filled in; finding it would take a search.
+   ///
+   /// @return The export, or nothing if the slot is empty
+   std::optional<ExportedFunction> find( uint32_t ordinal ) const;
+
+   /// Look up an export by name with a binary search of the name pointer table
+   ///
+   /// @return The export, or nothing if there isn't one by that name
+   std::optional<ExportedFunction> find( std::string_view name ) const;
+}; // ExportTable
+
+
+/// A hash index of the names in an ExportTable for repeated lookups
+///
+/// Building it reads every name once and makes one allocation.  After
+/// that, each lookup is an expected O(1) probe and one string compare.
+/// It doesn't depend on the name pointer table being sorted.
+class ExportHashIndex {
+protected:
+   static constexpr uint32_t EMPTY = UINT32_MAX;  ///< A slot with no name in it
+
+   const ExportTable*         table_;  ///< The table that was indexed
+   std::pmr::vector<uint32_t> slots_;  ///< Open-addressed name pointer indexes (a power of two in size)
+
+   /// @return The FNV-1a hash of `name`
+   static uint64_t hash( std::string_view name );
+
+public:
+   /// Index every name in `table` (allocating the slots from `arena`)
+   explicit ExportHashIndex( const ExportTable& table, std::pmr::memory_resource* arena = std::pmr::get_default_resource() );
+
+   /// @return The export by `name`, or nothing if there isn't one
+   std::optional<ExportedFunction> find( std::string_view name ) const;
+}; // ExportHashIndex
@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// The fields that `--fields` selects, as one bitmask per layout
+///
+/// @file   FieldProjection.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <array>      // For array
+#include <cstddef>    // For size_t
+#include <stdexcept>  // For invalid_argument
+
+#include "FieldProjection.h"
+
+using namespace std;
+
+
+/// Set the bit of the field called `label` in `mask` (if `layout` has one)
+///
+/// @return `true` if `layout` has a field called `label`
+template <size_t SIZE>
+static bool select( const array<FieldDescriptor, SIZE>& layout, const string_view label, uint64_t& mask ) {
+   static_assert( SIZE <= 64, "A layout needs one bit per field" );
+   for( size_t i = 0 ; i < SIZE ; i++ ) {
+      if( label == layout[i].label ) {
+         mask |= uint64_t { 1 } << i;
+         return true;
+      }
+   }
+   return false;
+}
+
+
+FieldProjection FieldProjection::parse( const string_view list ) {
+   FieldProjection projection;
+   projection.dos_              = 0;
+   projection.coff_             = 0;
+   projection.optional32_       = 0;
+   projection.optional64_       = 0;
+   projection.section_          = 0;
+   projection.export_           = 0;
+   projection.debug_            = 0;
+   projection.data_directories_ = false;
+
+   size_t start = 0;
+   while( start <= list.size() ) {
+      const size_t     comma = list.find( ',', start );
+      const string_view label = list.substr( start, comma == string_view::npos ? string_view::npos : comma - start );
+      start = comma == string_view::npos ? list.size() + 1 : comma + 1;
+      if( label.empty() ) {
+         continue;
+      }
+
+      bool found = false;
+      if( label == DATA_DIRECTORIES_LABEL ) {
+         projection.data_directories_ = true;
+         found = true;
+      }
+      found |= select( DOS_LAYOUT,        label, projection.dos_        );
+      found |= select( COFF_LAYOUT,       label, projection.coff_       );
+      found |= select( OPTIONAL32_LAYOUT, label, projection.optional32_ );  // The optional header labels are in both layouts
+      found |= select( OPTIONAL64_LAYOUT, label, projection.optional64_ );
+      found |= select( SECTION_LAYOUT,    label, projection.section_    );
+      found |= select( EXPORT_LAYOUT,     label, projection.export_     );
+      found |= select( DEBUG_LAYOUT,      label, projection.debug_      );
+      if( !found ) {
+         throw invalid_argument( "Unknown field " + string( label ) );
+      }
+   }
+   return projection;
+} // parse()
+
+
+void FieldProjection::append_key( string& key ) const {
+   for( const uint64_t mask : { dos_, coff_, optional32_, optional64_, section_, export_, debug_ } ) {
+      key.push_back( ',' );
+      key.append( to_string( mask ) );
+   }
+   key.push_back( data_directories_ ? '1' : '0' );
+}
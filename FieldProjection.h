@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// The fields that `--fields` selects, as one bitmask per layout
+///
+/// A projection is a list of field labels (`02_coff_machine,01_section_name`)
+/// compiled once into a bit per field of each layout.  The report only
+/// loads and writes the fields whose bits are set, and PEFile::print()
+/// skips the parts of the file (the optional header, the section table)
+/// that nothing selected needs.  The optional header labels are shared by
+/// the PE32 and PE32+ layouts, so a label selects the field in both.
+///
+/// The default projection selects every field.
+///
+/// @file   FieldProjection.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstdint>      // For uint64_t UINT64_MAX
+#include <string>       // For string
+#include <string_view>  // For string_view
+#include <type_traits>  // For is_base_of_v
+
+#include "DebugDirectory.h"
+#include "Exports.h"
+#include "HeaderView.h"
+
+
+/// One bit per field of each layout
+class FieldProjection {
+public:
+   static constexpr uint64_t ALL = UINT64_MAX;  ///< Every field of a layout
+
+   /// The label that selects the data directory (which has no field labels of its own)
+   static constexpr std::string_view DATA_DIRECTORIES_LABEL = "data_directories";
+
+protected:
+   uint64_t dos_              { ALL };   ///< Bits of #DOS_LAYOUT
+   uint64_t coff_             { ALL };   ///< Bits of #COFF_LAYOUT
+   uint64_t optional32_       { ALL };   ///< Bits of #OPTIONAL32_LAYOUT
+   uint64_t optional64_       { ALL };   ///< Bits of #OPTIONAL64_LAYOUT
+   uint64_t section_          { ALL };   ///< Bits of #SECTION_LAYOUT
+   uint64_t export_           { ALL };   ///< Bits of #EXPORT_LAYOUT
+   uint64_t debug_            { ALL };   ///< Bits of #DEBUG_LAYOUT
+   bool     data_directories_ { true };  ///< `true` if the data directory is selected
+
+   /// `true` if `VIEW` is laid out by `LAYOUT`
+   template <typename VIEW, const auto& LAYOUT>
+   static constexpr bool is_layout = std::is_base_of_v<HeaderView<LAYOUT>, VIEW>;  // By type, as comparing addresses isn't always a constant expression
+
+public:
+   /// Compile a comma-separated list of labels
+   ///
+   /// @param list Labels from the layouts (`02_coff_machine`) or
+   ///             #DATA_DIRECTORIES_LABEL
+   /// @return A projection that selects only those fields
+   /// @throws invalid_argument if a label isn't in any layout
+   static FieldProjection parse( std::string_view list );
+
+   /// @return The bits of the layout of `VIEW` (a HeaderView like DosHeaderView)
+   template <typename VIEW>
+   uint64_t mask() const {
+      if constexpr(      is_layout<VIEW, DOS_LAYOUT>        ) { return dos_;        }
+      else if constexpr( is_layout<VIEW, COFF_LAYOUT>       ) { return coff_;       }
+      else if constexpr( is_layout<VIEW, OPTIONAL32_LAYOUT> ) { return optional32_; }
+      else if constexpr( is_layout<VIEW, OPTIONAL64_LAYOUT> ) { return optional64_; }
+      else if constexpr( is_layout<VIEW, SECTION_LAYOUT>    ) { return section_;    }
+      else if constexpr( is_layout<VIEW, EXPORT_LAYOUT>     ) { return export_;     }
+      else {
+         static_assert( is_layout<VIEW, DEBUG_LAYOUT>, "There is no mask for this layout" );
+         return debug_;
+      }
+   }
+
+   bool has_data_directories() const {
+      return data_directories_;  /// @return `true` if the data directory is selected
+   }
+
+   bool has_optional_header() const {
+      return optional32_ != 0 || optional64_ != 0 || data_directories_;  /// @return `true` if anything in the optional header is selected
+   }
+
+   /// Append what this projection selects to `key` (for the ResultCache)
+   void append_key( std::string& key ) const;
+}; // FieldProjection
@@ -0,0 +1,253 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Find the files to process on a thread of their own
+///
+/// @file   FileDiscovery.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For sort() max() min()
+#include <fstream>    // For ifstream
+#include <stdexcept>  // For runtime_error
+
+#include <dirent.h>    // For opendir() readdir() closedir()
+#include <fcntl.h>     // For open() posix_fadvise()
+#include <sys/stat.h>  // For stat() lstat()
+#include <unistd.h>    // For close()
+
+#include "FileDiscovery.h"
+
+using namespace std;
+
+
+/// How much of a file a ring read reads when the whole file is prefetched
+///
+/// The headers are read through the ring and the rest is left to
+/// `posix_fadvise()`, so the ring's buffers stay small.
+#define RING_READ_BYTES ( 64 * 1024 )
+
+
+/// @return `true` if `path` is a directory (following symbolic links)
+static bool is_directory( const string& path ) {
+   struct stat path_stat {};
+   return stat( path.c_str(), &path_stat ) == 0 && S_ISDIR( path_stat.st_mode );
+}
+
+
+/// Ask the kernel to start reading the first `bytes` of the file at `path` (all of it if `bytes` is 0)
+///
+/// This is only a hint: a file that can't be opened is left for the job to report.
+static void prefetch( const string& path, const size_t bytes ) {
+   const int fd = open( path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK );
+   if( fd < 0 ) {
+      return;
+   }
+   (void) posix_fadvise( fd, 0, static_cast<off_t>( bytes ), POSIX_FADV_WILLNEED );
+   close( fd );
+}
+
+
+FileDiscovery::FileDiscovery( vector<string> new_inputs, const size_t new_capacity, const size_t new_prefetch_bytes, const IoMode new_io_mode )
+      :inputs_        ( std::move( new_inputs ) )         // Member initialization
+      ,capacity_      ( max<size_t>( new_capacity, 1 ) )  // Member initialization
+      ,prefetch_bytes_( new_prefetch_bytes )              // Member initialization
+{
+   if( new_io_mode == IoMode::URING ) {
+      try {
+         ring_ = make_unique<IoRing>( static_cast<unsigned>( min<size_t>( capacity_, 4096 ) ) );
+      } catch( const runtime_error& ) {}  // Fall back to posix_fadvise()
+   }
+   if( ring_ ) {
+      const size_t read_bytes = prefetch_bytes_ == 0 ? RING_READ_BYTES : min<size_t>( prefetch_bytes_, RING_READ_BYTES );
+      ring_reads_.resize( ring_->capacity() );
+      for( size_t i = 0 ; i < ring_reads_.size() ; i++ ) {
+         ring_reads_[i].buffer.resize( read_bytes );
+         idle_reads_.push_back( i );
+      }
+   }
+
+   producer_ = thread( [this] { walk(); } );
+}
+
+
+FileDiscovery::~FileDiscovery() {
+   {
+      const lock_guard<mutex> lock( mutex_ );
+      closed_ = true;
+      wake_   = nullptr;
+   }
+   room_.notify_all();
+   producer_.join();
+}
+
+
+bool FileDiscovery::expands( const string& input ) {
+   return input.starts_with( '@' ) || is_directory( input );
+}
+
+
+void FileDiscovery::walk() {
+   for( const string& input : inputs_ ) {
+      if( !walk_input( input, false ) ) {
+         break;
+      }
+   }
+   try {
+      while( ring_ && !ring_failed_ && idle_reads_.size() < ring_reads_.size() ) {
+         reap( 1 );  // So the files are closed before the results are in
+      }
+   } catch( const runtime_error& ) {}  // The buffers stay until the destructor
+
+   const lock_guard<mutex> lock( mutex_ );
+   finished_ = true;
+   if( wake_ ) {
+      wake_();
+   }
+} // walk()
+
+
+bool FileDiscovery::walk_input( const string& input, const bool is_listed ) {
+   if( !is_listed && input.starts_with( '@' ) ) {
+      ifstream list( input.substr( 1 ) );
+      if( !list ) {
+         return push( input );  // The job fails to open it and says so
+      }
+      string line;
+      while( getline( list, line ) ) {
+         if( line.ends_with( '\r' ) ) {
+            line.pop_back();
+         }
+         if( !line.empty() && !walk_input( line, true ) ) {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   if( is_directory( input ) ) {
+      return walk_directory( input );
+   }
+   return push( input );
+} // walk_input()
+
+
+bool FileDiscovery::walk_directory( const string& path ) {
+   DIR* directory = opendir( path.c_str() );
+   if( directory == nullptr ) {
+      return push( path );  // The job fails to open it and says so
+   }
+
+   const string prefix = path.ends_with( '/' ) ? path : path + '/';
+   vector<string> names;
+   while( const dirent* entry = readdir( directory ) ) {
+      const string_view name = entry->d_name;
+      if( name != "." && name != ".." ) {
+         names.emplace_back( name );
+      }
+   }
+   closedir( directory );
+   sort( names.begin(), names.end() );
+
+   for( const string& name : names ) {
+      const string child = prefix + name;
+      struct stat child_stat {};
+      if( lstat( child.c_str(), &child_stat ) != 0 ) {
+         continue;  // It went away while we were looking
+      }
+      if( S_ISDIR( child_stat.st_mode ) ) {
+         if( !walk_directory( child ) ) {
+            return false;
+         }
+      } else if( S_ISREG( child_stat.st_mode ) ) {
+         if( !push( child ) ) {
+            return false;
+         }
+      }  // Skip symbolic links, devices, pipes and sockets
+   }
+   return true;
+} // walk_directory()
+
+
+void FileDiscovery::ring_prefetch( const string& path ) {
+   reap( idle_reads_.empty() ? 1 : 0 );
+
+   const int fd = open( path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK );
+   if( fd < 0 ) {
+      return;
+   }
+   if( prefetch_bytes_ == 0 ) {
+      (void) posix_fadvise( fd, 0, 0, POSIX_FADV_WILLNEED );  // The ring only reads the headers
+   }
+
+   const size_t index = idle_reads_.back();
+   idle_reads_.pop_back();
+   RingRead& read = ring_reads_[index];
+   read.fd = fd;
+   ring_->read( fd, read.buffer.data(), static_cast<unsigned>( read.buffer.size() ), 0, index );
+   ring_->submit();
+} // ring_prefetch()
+
+
+void FileDiscovery::reap( const unsigned wait_for ) {
+   if( wait_for > 0 ) {
+      ring_->submit( wait_for );
+   }
+   uint64_t tag;
+   int      result;
+   while( ring_->complete( tag, result ) ) {
+      RingRead& read = ring_reads_[tag];
+      close( read.fd );
+      read.fd = -1;
+      idle_reads_.push_back( tag );
+   }
+}
+
+
+bool FileDiscovery::push( const string& path ) {
+   unique_lock<mutex> lock( mutex_ );
+   room_.wait( lock, [this] { return closed_ || queue_.size() < capacity_; } );
+   if( closed_ ) {
+      return false;
+   }
+
+   lock.unlock();
+   if( ring_ && !ring_failed_ ) {  // Nobody else pushes, so the room is still there
+      try {
+         ring_prefetch( path );
+      } catch( const runtime_error& ) {
+         ring_failed_ = true;  // Reads may still be in flight, so keep the ring and its buffers
+         prefetch( path, prefetch_bytes_ );
+      }
+   } else {
+      prefetch( path, prefetch_bytes_ );
+   }
+   lock.lock();
+
+   queue_.push_back( path );
+   if( wake_ ) {
+      wake_();
+   }
+   return !closed_;
+} // push()
+
+
+PathSource::Next FileDiscovery::next( string& path ) {
+   {
+      const lock_guard<mutex> lock( mutex_ );
+      if( queue_.empty() ) {
+         return finished_ ? Next::END : Next::WAIT;
+      }
+      path.assign( queue_.front() );
+      queue_.pop_front();
+   }
+   room_.notify_one();
+   return Next::PATH;
+}
+
+
+void FileDiscovery::wake_on_ready( function<void()> wake ) {
+   const lock_guard<mutex> lock( mutex_ );
+   wake_ = std::move( wake );
+}
@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Find the files to process on a thread of their own
+///
+/// An input is a file, a directory (every regular file under it) or
+/// `@LISTFILE` (the paths in LISTFILE, one per line).  A directory is
+/// walked in name order, so the files come out in the same order every
+/// time, and symbolic links to directories aren't followed.
+///
+/// Walking a big tree can take as long as parsing it, so the walk runs on
+/// its own thread and hands paths to the Batch through a bounded queue as
+/// it finds them: the first files are being parsed while the rest are
+/// still being found, and a walk that gets ahead only gets as far as the
+/// queue.  Each path is prefetched with `posix_fadvise( WILLNEED )` as it's
+/// queued, so by the time a worker opens the file its pages are on their
+/// way in.  With IoMode::URING the producer reads the start of each file
+/// itself through an IoRing instead, keeping a read of every queued file
+/// in flight at once, so a cold disk or a network mount sees a deep queue
+/// rather than one worker's request at a time.
+///
+/// @file   FileDiscovery.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <condition_variable>  // For condition_variable
+#include <cstddef>             // For size_t
+#include <deque>               // For deque
+#include <functional>          // For function
+#include <memory>              // For unique_ptr
+#include <mutex>               // For mutex
+#include <string>              // For string
+#include <thread>              // For thread
+#include <vector>              // For vector
+
+#include "Batch.h"
+#include "IoRing.h"
+
+
+/// How FileDiscovery prefetches the files it finds
+enum class IoMode {
+    ADVISE  ///< Ask the kernel to read ahead with `posix_fadvise()`
+   ,URING   ///< Read the start of each file through an IoRing (falling back to ADVISE)
+};
+
+
+/// A PathSource that walks its inputs on a producer thread
+class FileDiscovery : public PathSource {
+protected:
+   /// A read that the ring may have in flight
+   struct RingRead {
+      int               fd { -1 };  ///< The file being read (open until the read completes)
+      std::vector<char> buffer;     ///< Where the read goes (the bytes are only wanted in the page cache)
+   };
+
+   std::vector<std::string> inputs_;                 ///< The files, directories and listfiles to walk
+   size_t                   capacity_;               ///< The most paths to hold at once
+   size_t                   prefetch_bytes_;         ///< How much of each file to prefetch (0 for all of it)
+   std::unique_ptr<IoRing>  ring_;                   ///< The ring (if IoMode::URING is available)
+   std::vector<RingRead>    ring_reads_;             ///< One per entry in #ring_
+   std::vector<size_t>      idle_reads_;             ///< The #ring_reads_ that aren't in flight
+   bool                     ring_failed_ { false };  ///< Set if #ring_ stopped working (so it's no longer used)
+   std::mutex               mutex_;                  ///< Guards everything below
+   std::condition_variable  room_;                   ///< Signalled when a path is taken or the queue closes
+   std::deque<std::string>  queue_;                  ///< The paths that have been found but not taken
+   bool                     finished_ { false };     ///< Set when the walk is over
+   bool                     closed_   { false };     ///< Set when nobody will take any more paths
+   std::function<void()>    wake_;                   ///< Called when a path is queued or the walk is over
+   std::thread              producer_;               ///< Walks #inputs_ (started last)
+
+   /// Walk every input (the body of #producer_)
+   void walk();
+
+   /// Queue every regular file under the directory at `path`
+   ///
+   /// @return `false` if the queue closed
+   bool walk_directory( const std::string& path );
+
+   /// Queue the file, directory or listfile at `input` (`@` isn't expanded if `is_listed`)
+   ///
+   /// @return `false` if the queue closed
+   bool walk_input( const std::string& input, bool is_listed );
+
+   /// Start reading the start of `path` through #ring_ (the producer is the only thread that touches it)
+   void ring_prefetch( const std::string& path );
+
+   /// Close the files whose ring reads have completed (waiting for at least `wait_for` of them)
+   void reap( unsigned wait_for );
+
+   /// Prefetch `path` and queue it, waiting for room
+   ///
+   /// @return `false` if the queue closed
+   bool push( const std::string& path );
+
+public:
+   /// Start finding the files in `new_inputs`
+   ///
+   /// @param new_inputs         Files, directories and `@LISTFILE`s
+   /// @param new_capacity       The most paths to find ahead of the Batch
+   /// @param new_prefetch_bytes How much of each file to prefetch (0 for all of it)
+   /// @param new_io_mode        How to prefetch
+   FileDiscovery( std::vector<std::string> new_inputs, size_t new_capacity, size_t new_prefetch_bytes, IoMode new_io_mode = IoMode::ADVISE );
+
+   /// Stop the walk and join the producer
+   ~FileDiscovery() override;
+
+   FileDiscovery( const FileDiscovery& ) = delete;             ///< A FileDiscovery owns a thread
+   FileDiscovery& operator=( const FileDiscovery& ) = delete;  ///< A FileDiscovery owns a thread
+
+   /// @return `true` if `input` is a directory or a listfile (so the number of files isn't known up front)
+   static bool expands( const std::string& input );
+
+   Next next( std::string& path ) override;
+   void wake_on_ready( std::function<void()> wake ) override;
+}; // FileDiscovery
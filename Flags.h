@@ -0,0 +1,338 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// The names of the values and flags in the PE headers
+///
+/// Each table is a `constexpr` array sorted by value, so a lookup is a
+/// binary search over integers with no allocations and no string keys.
+///
+/// @see https://learn.microsoft.com/en-us/windows/win32/debug/pe-format
+///
+/// @file   Flags.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <algorithm>  // For lower_bound()
+#include <array>      // For array
+#include <bit>        // For countr_zero()
+#include <cstdint>    // For uint64_t
+#include <span>       // For span
+
+
+/// The name of one value (or one flag bit)
+struct FlagName {
+   uint64_t    value;  ///< The value or the bit
+   const char* name;   ///< What to print
+};
+
+
+/// How to decode the value of a field into names
+///
+/// Most bits are independent flags that are named one at a time.  Some
+/// fields also pack a small number into a group of bits (like the section
+/// alignment); those bits are #enum_mask and their values are named by #enums.
+struct FlagTable {
+   std::span<const FlagName> names;             ///< The names of single values or bits (sorted by value)
+   uint64_t                  enum_mask { 0 };   ///< The bits that hold a number rather than flags
+   std::span<const FlagName> enums     {};      ///< The names of the numbers under #enum_mask (sorted by value)
+
+   /// @return The name of `value` in `table`, or `nullptr` if it has no name
+   static constexpr const char* lookup( const std::span<const FlagName> table, const uint64_t value ) {
+      const FlagName* found = std::lower_bound( table.data(), table.data() + table.size(), value
+                                               ,[]( const FlagName& flag, const uint64_t key ) { return flag.value < key; } );
+      return found != table.data() + table.size() && found->value == value ? found->name : nullptr;
+   }
+
+   /// @return The name of `value` in #names, or `nullptr` if it has no name
+   constexpr const char* lookup( const uint64_t value ) const {
+      return lookup( names, value );
+   }
+
+   /// Call `visit( name, mask )` for each flag that's set in `value`
+   ///
+   /// Only the bits that are set are visited.  The bits under #enum_mask
+   /// are visited once, as a number.  `name` is `nullptr` if `mask` has no
+   /// name.
+   template <typename VISITOR>
+   constexpr void for_each_set( const uint64_t value, VISITOR visit ) const {
+      for( uint64_t remaining = value ; remaining != 0 ; ) {
+         uint64_t    mask = uint64_t{ 1 } << std::countr_zero( remaining );
+         const char* name;
+
+         if( mask & enum_mask ) {  // A number packed into several bits is named all at once
+            mask = value & enum_mask;
+            name = lookup( enums, mask );
+         } else {
+            name = lookup( mask );
+         }
+         remaining &= ~mask;
+
+         visit( name, mask );
+      }
+   }
+}; // FlagTable
+
+
+/// @return `true` if `table` is sorted by value with no duplicates
+constexpr bool is_sorted_table( const std::span<const FlagName> table ) {
+   for( size_t i = 1 ; i < table.size() ; i++ ) {
+      if( !( table[i-1].value < table[i].value ) ) { return false; }
+   }
+   return true;
+}
+
+
+/// The names of the COFF Machine values
+inline constexpr std::array<FlagName, 33> MACHINE_NAMES {{
+    { 0x0000, "IMAGE_FILE_MACHINE_UNKNOWN"     }
+   ,{ 0x014c, "IMAGE_FILE_MACHINE_I386"        }
+   ,{ 0x0162, "IMAGE_FILE_MACHINE_R3000"       }
+   ,{ 0x0166, "IMAGE_FILE_MACHINE_R4000"       }
+   ,{ 0x0168, "IMAGE_FILE_MACHINE_R10000"      }
+   ,{ 0x0169, "IMAGE_FILE_MACHINE_WCEMIPSV2"   }
+   ,{ 0x0184, "IMAGE_FILE_MACHINE_ALPHA"       }
+   ,{ 0x01a2, "IMAGE_FILE_MACHINE_SH3"         }
+   ,{ 0x01a3, "IMAGE_FILE_MACHINE_SH3DSP"      }
+   ,{ 0x01a6, "IMAGE_FILE_MACHINE_SH4"         }
+   ,{ 0x01a8, "IMAGE_FILE_MACHINE_SH5"         }
+   ,{ 0x01c0, "IMAGE_FILE_MACHINE_ARM"         }
+   ,{ 0x01c2, "IMAGE_FILE_MACHINE_THUMB"       }
+   ,{ 0x01c4, "IMAGE_FILE_MACHINE_ARMNT"       }
+   ,{ 0x01d3, "IMAGE_FILE_MACHINE_AM33"        }
+   ,{ 0x01f0, "IMAGE_FILE_MACHINE_POWERPC"     }
+   ,{ 0x01f1, "IMAGE_FILE_MACHINE_POWERPCFP"   }
+   ,{ 0x0200, "IMAGE_FILE_MACHINE_IA64"        }
+   ,{ 0x0266, "IMAGE_FILE_MACHINE_MIPS16"      }
+   ,{ 0x0284, "IMAGE_FILE_MACHINE_ALPHA64"     }
+   ,{ 0x0366, "IMAGE_FILE_MACHINE_MIPSFPU"     }
+   ,{ 0x0466, "IMAGE_FILE_MACHINE_MIPSFPU16"   }
+   ,{ 0x0ebc, "IMAGE_FILE_MACHINE_EBC"         }
+   ,{ 0x5032, "IMAGE_FILE_MACHINE_RISCV32"     }
+   ,{ 0x5064, "IMAGE_FILE_MACHINE_RISCV64"     }
+   ,{ 0x5128, "IMAGE_FILE_MACHINE_RISCV128"    }
+   ,{ 0x6232, "IMAGE_FILE_MACHINE_LOONGARCH32" }
+   ,{ 0x6264, "IMAGE_FILE_MACHINE_LOONGARCH64" }
+   ,{ 0x8664, "IMAGE_FILE_MACHINE_AMD64"       }
+   ,{ 0x9041, "IMAGE_FILE_MACHINE_M32R"        }
+   ,{ 0xa641, "IMAGE_FILE_MACHINE_ARM64EC"     }
+   ,{ 0xa64e, "IMAGE_FILE_MACHINE_ARM64X"      }
+   ,{ 0xaa64, "IMAGE_FILE_MACHINE_ARM64"       }
+}}; // MACHINE_NAMES
+
+
+/// The names of the COFF Characteristics flags (0x0040 is reserved)
+inline constexpr std::array<FlagName, 15> COFF_CHARACTERISTIC_NAMES {{
+    { 0x0001, "IMAGE_FILE_RELOCS_STRIPPED"         }
+   ,{ 0x0002, "IMAGE_FILE_EXECUTABLE_IMAGE"        }
+   ,{ 0x0004, "IMAGE_FILE_LINE_NUMS_STRIPPED"      }
+   ,{ 0x0008, "IMAGE_FILE_LOCAL_SYMS_STRIPPED"     }
+   ,{ 0x0010, "IMAGE_FILE_AGGRESSIVE_WS_TRIM"      }
+   ,{ 0x0020, "IMAGE_FILE_LARGE_ADDRESS_AWARE"     }
+   ,{ 0x0080, "IMAGE_FILE_BYTES_REVERSED_LO"       }
+   ,{ 0x0100, "IMAGE_FILE_32BIT_MACHINE"           }
+   ,{ 0x0200, "IMAGE_FILE_DEBUG_STRIPPED"          }
+   ,{ 0x0400, "IMAGE_FILE_REMOVABLE_RUN_FROM_SWAP" }
+   ,{ 0x0800, "IMAGE_FILE_NET_RUN_FROM_SWAP"       }
+   ,{ 0x1000, "IMAGE_FILE_SYSTEM"                  }
+   ,{ 0x2000, "IMAGE_FILE_DLL"                     }
+   ,{ 0x4000, "IMAGE_FILE_UP_SYSTEM_ONLY"          }
+   ,{ 0x8000, "IMAGE_FILE_BYTES_REVERSED_HI"       }
+}}; // COFF_CHARACTERISTIC_NAMES
+
+
+/// The names of the section Characteristics flags (not including the alignment)
+inline constexpr std::array<FlagName, 20> SECTION_CHARACTERISTIC_NAMES {{
+    { 0x00000008, "IMAGE_SCN_TYPE_NO_PAD"            }
+   ,{ 0x00000020, "IMAGE_SCN_CNT_CODE"               }
+   ,{ 0x00000040, "IMAGE_SCN_CNT_INITIALIZED_DATA"   }
+   ,{ 0x00000080, "IMAGE_SCN_CNT_UNINITIALIZED_DATA" }
+   ,{ 0x00000100, "IMAGE_SCN_LNK_OTHER"              }
+   ,{ 0x00000200, "IMAGE_SCN_LNK_INFO"               }
+   ,{ 0x00000800, "IMAGE_SCN_LNK_REMOVE"             }
+   ,{ 0x00001000, "IMAGE_SCN_LNK_COMDAT"             }
+   ,{ 0x00008000, "IMAGE_SCN_GPREL"                  }
+   ,{ 0x00020000, "IMAGE_SCN_MEM_PURGEABLE"          }
+   ,{ 0x00040000, "IMAGE_SCN_MEM_LOCKED"             }
+   ,{ 0x00080000, "IMAGE_SCN_MEM_PRELOAD"            }
+   ,{ 0x01000000, "IMAGE_SCN_LNK_NRELOC_OVFL"        }
+   ,{ 0x02000000, "IMAGE_SCN_MEM_DISCARDABLE"        }
+   ,{ 0x04000000, "IMAGE_SCN_MEM_NOT_CACHED"         }
+   ,{ 0x08000000, "IMAGE_SCN_MEM_NOT_PAGED"          }
+   ,{ 0x10000000, "IMAGE_SCN_MEM_SHARED"             }
+   ,{ 0x20000000, "IMAGE_SCN_MEM_EXECUTE"            }
+   ,{ 0x40000000, "IMAGE_SCN_MEM_READ"               }
+   ,{ 0x80000000, "IMAGE_SCN_MEM_WRITE"              }
+}}; // SECTION_CHARACTERISTIC_NAMES
+
+
+/// The names of the section alignments (the number in bits 20-23 of the Characteristics)
+inline constexpr std::array<FlagName, 14> SECTION_ALIGNMENT_NAMES {{
+    { 0x00100000, "IMAGE_SCN_ALIGN_1BYTES"    }
+   ,{ 0x00200000, "IMAGE_SCN_ALIGN_2BYTES"    }
+   ,{ 0x00300000, "IMAGE_SCN_ALIGN_4BYTES"    }
+   ,{ 0x00400000, "IMAGE_SCN_ALIGN_8BYTES"    }
+   ,{ 0x00500000, "IMAGE_SCN_ALIGN_16BYTES"   }
+   ,{ 0x00600000, "IMAGE_SCN_ALIGN_32BYTES"   }
+   ,{ 0x00700000, "IMAGE_SCN_ALIGN_64BYTES"   }
+   ,{ 0x00800000, "IMAGE_SCN_ALIGN_128BYTES"  }
+   ,{ 0x00900000, "IMAGE_SCN_ALIGN_256BYTES"  }
+   ,{ 0x00A00000, "IMAGE_SCN_ALIGN_512BYTES"  }
+   ,{ 0x00B00000, "IMAGE_SCN_ALIGN_1024BYTES" }
+   ,{ 0x00C00000, "IMAGE_SCN_ALIGN_2048BYTES" }
+   ,{ 0x00D00000, "IMAGE_SCN_ALIGN_4096BYTES" }
+   ,{ 0x00E00000, "IMAGE_SCN_ALIGN_8192BYTES" }
+}}; // SECTION_ALIGNMENT_NAMES
+
+
+/// The names of the optional header magic numbers
+inline constexpr std::array<FlagName, 3> OPTIONAL_MAGIC_NAMES {{
+    { 0x0107, "IMAGE_ROM_OPTIONAL_HDR_MAGIC"  }
+   ,{ 0x010b, "IMAGE_NT_OPTIONAL_HDR32_MAGIC" }
+   ,{ 0x020b, "IMAGE_NT_OPTIONAL_HDR64_MAGIC" }
+}}; // OPTIONAL_MAGIC_NAMES
+
+
+/// The names of the Windows subsystems
+inline constexpr std::array<FlagName, 14> SUBSYSTEM_NAMES {{
+    {  0, "IMAGE_SUBSYSTEM_UNKNOWN"                  }
+   ,{  1, "IMAGE_SUBSYSTEM_NATIVE"                   }
+   ,{  2, "IMAGE_SUBSYSTEM_WINDOWS_GUI"              }
+   ,{  3, "IMAGE_SUBSYSTEM_WINDOWS_CUI"              }
+   ,{  5, "IMAGE_SUBSYSTEM_OS2_CUI"                  }
+   ,{  7, "IMAGE_SUBSYSTEM_POSIX_CUI"                }
+   ,{  8, "IMAGE_SUBSYSTEM_NATIVE_WINDOWS"           }
+   ,{  9, "IMAGE_SUBSYSTEM_WINDOWS_CE_GUI"           }
+   ,{ 10, "IMAGE_SUBSYSTEM_EFI_APPLICATION"          }
+   ,{ 11, "IMAGE_SUBSYSTEM_EFI_BOOT_SERVICE_DRIVER"  }
+   ,{ 12, "IMAGE_SUBSYSTEM_EFI_RUNTIME_DRIVER"       }
+   ,{ 13, "IMAGE_SUBSYSTEM_EFI_ROM"                  }
+   ,{ 14, "IMAGE_SUBSYSTEM_XBOX"                     }
+   ,{ 16, "IMAGE_SUBSYSTEM_WINDOWS_BOOT_APPLICATION" }
+}}; // SUBSYSTEM_NAMES
+
+
+/// The names of the DllCharacteristics flags in the optional header
+inline constexpr std::array<FlagName, 11> DLL_CHARACTERISTIC_NAMES {{
+    { 0x0020, "IMAGE_DLLCHARACTERISTICS_HIGH_ENTROPY_VA"       }
+   ,{ 0x0040, "IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE"          }
+   ,{ 0x0080, "IMAGE_DLLCHARACTERISTICS_FORCE_INTEGRITY"       }
+   ,{ 0x0100, "IMAGE_DLLCHARACTERISTICS_NX_COMPAT"             }
+   ,{ 0x0200, "IMAGE_DLLCHARACTERISTICS_NO_ISOLATION"          }
+   ,{ 0x0400, "IMAGE_DLLCHARACTERISTICS_NO_SEH"                }
+   ,{ 0x0800, "IMAGE_DLLCHARACTERISTICS_NO_BIND"               }
+   ,{ 0x1000, "IMAGE_DLLCHARACTERISTICS_APPCONTAINER"          }
+   ,{ 0x2000, "IMAGE_DLLCHARACTERISTICS_WDM_DRIVER"            }
+   ,{ 0x4000, "IMAGE_DLLCHARACTERISTICS_GUARD_CF"              }
+   ,{ 0x8000, "IMAGE_DLLCHARACTERISTICS_TERMINAL_SERVER_AWARE" }
+}}; // DLL_CHARACTERISTIC_NAMES
+
+
+/// The names of the resource types (the IDs at the top of the resource tree)
+inline constexpr std::array<FlagName, 21> RESOURCE_TYPE_NAMES {{
+    {  1, "RT_CURSOR"       }
+   ,{  2, "RT_BITMAP"       }
+   ,{  3, "RT_ICON"         }
+   ,{  4, "RT_MENU"         }
+   ,{  5, "RT_DIALOG"       }
+   ,{  6, "RT_STRING"       }
+   ,{  7, "RT_FONTDIR"      }
+   ,{  8, "RT_FONT"         }
+   ,{  9, "RT_ACCELERATOR"  }
+   ,{ 10, "RT_RCDATA"       }
+   ,{ 11, "RT_MESSAGETABLE" }
+   ,{ 12, "RT_GROUP_CURSOR" }
+   ,{ 14, "RT_GROUP_ICON"   }
+   ,{ 16, "RT_VERSION"      }
+   ,{ 17, "RT_DLGINCLUDE"   }
+   ,{ 19, "RT_PLUGPLAY"     }
+   ,{ 20, "RT_VXD"          }
+   ,{ 21, "RT_ANICURSOR"    }
+   ,{ 22, "RT_ANIICON"      }
+   ,{ 23, "RT_HTML"         }
+   ,{ 24, "RT_MANIFEST"     }
+}}; // RESOURCE_TYPE_NAMES
+
+
+/// The names of the base relocation types (the top 4 bits of each entry)
+///
+/// Types 5, 7, 8 and 9 mean different things on different machines; they're
+/// named for the machine that most often has them.
+inline constexpr std::array<FlagName, 10> RELOCATION_TYPE_NAMES {{
+    {  0, "IMAGE_REL_BASED_ABSOLUTE"       }
+   ,{  1, "IMAGE_REL_BASED_HIGH"           }
+   ,{  2, "IMAGE_REL_BASED_LOW"            }
+   ,{  3, "IMAGE_REL_BASED_HIGHLOW"        }
+   ,{  4, "IMAGE_REL_BASED_HIGHADJ"        }
+   ,{  5, "IMAGE_REL_BASED_ARM_MOV32"      }
+   ,{  7, "IMAGE_REL_BASED_THUMB_MOV32"    }
+   ,{  8, "IMAGE_REL_BASED_RISCV_LOW12S"   }
+   ,{  9, "IMAGE_REL_BASED_MIPS_JMPADDR16" }
+   ,{ 10, "IMAGE_REL_BASED_DIR64"          }
+}}; // RELOCATION_TYPE_NAMES
+
+
+/// The names of the debug directory types
+inline constexpr std::array<FlagName, 18> DEBUG_TYPE_NAMES {{
+    {  0, "IMAGE_DEBUG_TYPE_UNKNOWN"               }
+   ,{  1, "IMAGE_DEBUG_TYPE_COFF"                  }
+   ,{  2, "IMAGE_DEBUG_TYPE_CODEVIEW"              }
+   ,{  3, "IMAGE_DEBUG_TYPE_FPO"                   }
+   ,{  4, "IMAGE_DEBUG_TYPE_MISC"                  }
+   ,{  5, "IMAGE_DEBUG_TYPE_EXCEPTION"             }
+   ,{  6, "IMAGE_DEBUG_TYPE_FIXUP"                 }
+   ,{  7, "IMAGE_DEBUG_TYPE_OMAP_TO_SRC"           }
+   ,{  8, "IMAGE_DEBUG_TYPE_OMAP_FROM_SRC"         }
+   ,{  9, "IMAGE_DEBUG_TYPE_BORLAND"               }
+   ,{ 10, "IMAGE_DEBUG_TYPE_RESERVED10"            }
+   ,{ 11, "IMAGE_DEBUG_TYPE_CLSID"                 }
+   ,{ 12, "IMAGE_DEBUG_TYPE_VC_FEATURE"            }
+   ,{ 13, "IMAGE_DEBUG_TYPE_POGO"                  }
+   ,{ 14, "IMAGE_DEBUG_TYPE_ILTCG"                 }
+   ,{ 15, "IMAGE_DEBUG_TYPE_MPX"                   }
+   ,{ 16, "IMAGE_DEBUG_TYPE_REPRO"                 }
+   ,{ 20, "IMAGE_DEBUG_TYPE_EX_DLLCHARACTERISTICS" }
+}}; // DEBUG_TYPE_NAMES
+
+
+static_assert( is_sorted_table( MACHINE_NAMES ),                "MACHINE_NAMES must be sorted by value" );
+static_assert( is_sorted_table( COFF_CHARACTERISTIC_NAMES ),    "COFF_CHARACTERISTIC_NAMES must be sorted by value" );
+static_assert( is_sorted_table( SECTION_CHARACTERISTIC_NAMES ), "SECTION_CHARACTERISTIC_NAMES must be sorted by value" );
+static_assert( is_sorted_table( SECTION_ALIGNMENT_NAMES ),      "SECTION_ALIGNMENT_NAMES must be sorted by value" );
+static_assert( is_sorted_table( OPTIONAL_MAGIC_NAMES ),         "OPTIONAL_MAGIC_NAMES must be sorted by value" );
+static_assert( is_sorted_table( SUBSYSTEM_NAMES ),              "SUBSYSTEM_NAMES must be sorted by value" );
+static_assert( is_sorted_table( DLL_CHARACTERISTIC_NAMES ),     "DLL_CHARACTERISTIC_NAMES must be sorted by value" );
+static_assert( is_sorted_table( RESOURCE_TYPE_NAMES ),          "RESOURCE_TYPE_NAMES must be sorted by value" );
+static_assert( is_sorted_table( RELOCATION_TYPE_NAMES ),        "RELOCATION_TYPE_NAMES must be sorted by value" );
+static_assert( is_sorted_table( DEBUG_TYPE_NAMES ),             "DEBUG_TYPE_NAMES must be sorted by value" );
+
+
+/// Decode the COFF Machine
+inline constexpr FlagTable MACHINE_FLAGS { MACHINE_NAMES };
+
+/// Decode the COFF Characteristics
+inline constexpr FlagTable COFF_CHARACTERISTIC_FLAGS { COFF_CHARACTERISTIC_NAMES };
+
+/// Decode the section Characteristics
+inline constexpr FlagTable SECTION_CHARACTERISTIC_FLAGS { SECTION_CHARACTERISTIC_NAMES, 0x00F00000, SECTION_ALIGNMENT_NAMES };
+
+/// Decode the optional header Magic
+inline constexpr FlagTable OPTIONAL_MAGIC_FLAGS { OPTIONAL_MAGIC_NAMES };
+
+/// Decode the optional header Subsystem
+inline constexpr FlagTable SUBSYSTEM_FLAGS { SUBSYSTEM_NAMES };
+
+/// Decode the optional header DllCharacteristics
+inline constexpr FlagTable DLL_CHARACTERISTIC_FLAGS { DLL_CHARACTERISTIC_NAMES };
+
+/// Decode a resource type
+inline constexpr FlagTable RESOURCE_TYPE_FLAGS { RESOURCE_TYPE_NAMES };
+
+/// Decode a base relocation type
+inline constexpr FlagTable RELOCATION_TYPE_FLAGS { RELOCATION_TYPE_NAMES };
+
+/// Decode the Type of a debug directory entry
+inline constexpr FlagTable DEBUG_TYPE_FLAGS { DEBUG_TYPE_NAMES };
+
+static_assert( MACHINE_FLAGS.lookup( 0x8664 ) != nullptr, "The Machine lookup is broken" );
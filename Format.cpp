@@ -0,0 +1,172 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Format fields as text without streams
+///
+/// @file   Format.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <charconv>  // For to_chars()
+#include <ctime>     // For gmtime_r() strftime()
+
+#include "Format.h"
+
+using namespace std;
+
+
+/// The number of characters to the left of a field's value
+#define DESCRIPTION_WIDTH 34
+
+/// The indent in front of the name of a characteristic
+#define CHARACTERISTIC_INDENT 42
+
+
+void append_dec( string& out, const uint64_t value ) {
+   char digits[20];  // 2^64 has 20 decimal digits
+   const to_chars_result result = to_chars( begin( digits ), end( digits ), value );
+   out.append( digits, result.ptr );
+}
+
+
+void append_hex( string& out, const uint64_t value ) {
+   char digits[16];  // 2^64 has 16 hex digits
+   const to_chars_result result = to_chars( begin( digits ), end( digits ), value, 16 );
+   out.append( "0x", 2 );
+   out.append( digits, result.ptr );
+}
+
+
+void append_hex_bytes( string& out, const uint8_t* bytes, const size_t length ) {
+   static constexpr char DIGITS[] = "0123456789abcdef";
+   for( size_t i = 0 ; i < length ; i++ ) {
+      out.push_back( DIGITS[ bytes[i] >> 4 ] );
+      out.push_back( DIGITS[ bytes[i] & 0x0F ] );
+   }
+}
+
+
+void append_fixed( string& out, const double value, const int precision ) {
+   char digits[32];
+   const to_chars_result result = to_chars( begin( digits ), end( digits ), value, chars_format::fixed, precision );
+   out.append( digits, result.ptr );
+}
+
+
+void append_padded( string& out, const string_view text, const size_t width ) {
+   out.append( text );
+   if( text.size() < width ) {
+      out.append( width - text.size(), ' ' );
+   }
+}
+
+
+/// Append the bytes of `value` (little-endian, just like the file) as characters
+static void append_chars( string& out, const uint64_t value, const size_t width ) {
+   for( size_t i { 0 } ; i < width ; i++ ) {
+      out.push_back( static_cast<char>( value >> ( i * 8 ) ) );
+   }
+}
+
+
+void append_hex_or_zero( string& out, const uint64_t value ) {
+   if( value == 0 ) {
+      out.append( "0 ", 2 );
+   } else {
+      append_hex( out, value );
+   }
+}
+
+
+void append_label( string& out, const string_view description ) {
+   out.append( "    ", 4 );
+   const size_t label_start = out.size();
+   out.append( description );
+   out.push_back( ':' );
+   const size_t label_length = out.size() - label_start;
+   if( label_length < DESCRIPTION_WIDTH ) {
+      out.append( DESCRIPTION_WIDTH - label_length, ' ' );
+   }
+}
+
+
+void format_value( string& out, const FieldDescriptor& field, const uint64_t value ) {
+   if( field.rules & AS_HEX && field.rules & AS_CHAR ) {
+      append_hex_or_zero( out, value );
+      out.append( " (", 2 );
+      append_chars( out, value, field.width );
+      out.push_back( ')' );
+   } else if( field.rules & AS_DEC && field.rules & AS_HEX ) {
+      append_hex_or_zero( out, value );
+      out.append( " (", 2 );
+      append_dec( out, value );
+      out.append( " bytes)" );
+   } else if( field.rules & AS_DEC ) {
+      append_dec( out, value );
+      out.push_back( ' ' );
+   } else if( field.rules & AS_HEX ) {
+      append_hex_or_zero( out, value );
+   } else if( field.rules & AS_CHAR ) {
+      append_chars( out, value, field.width );
+   }
+
+   if( field.rules & WITH_TIME ) {
+      const time_t timestamp = static_cast<time_t>( value );
+      tm           broken_down {};
+      char         when[64];
+      size_t       length { 0 };
+      if( gmtime_r( &timestamp, &broken_down ) != nullptr ) {
+         length = strftime( when, sizeof( when ), "%c %Z", &broken_down );
+      }
+      out.push_back( '(' );
+      out.append( when, length );
+      out.push_back( ')' );
+   }
+
+   if( field.rules & WITH_FLAG ) {
+      const char* name = field.flags->lookup( value );
+      if( name != nullptr ) {
+         out.push_back( ' ' );
+         out.append( name );
+      } else {
+         out.append( "UNKNOWN FLAG MAPPING" );
+      }
+   }
+} // format_value()
+
+
+void format_characteristics( string& out, const FieldDescriptor& field, const uint64_t value ) {
+   out.append( "    Characteristics names\n" );
+
+   field.flags->for_each_set( value, [&out]( const char* name, const uint64_t mask ) {
+      out.append( CHARACTERISTIC_INDENT, ' ' );
+      if( name != nullptr ) {
+         out.append( name );
+      } else {
+         out.append( "UNKNOWN FLAG MAPPING: " );
+         append_hex( out, mask );
+      }
+      out.push_back( '\n' );
+   } );
+} // format_characteristics()
+
+
+void format_field( string& out, const FieldDescriptor& field, const uint64_t value ) {
+   const size_t start = out.size();
+
+   append_label( out, field.description );
+
+   const size_t value_start = out.size();
+   format_value( out, field, value );
+
+   if( out.size() == value_start ) {  // If it's empty, then skip it
+      out.resize( start );            // We may need to bring in a field
+      return;                         // for validation that we don't want to print
+   }
+   out.push_back( '\n' );
+
+   if( field.rules & WITH_FLAGS ) {
+      format_characteristics( out, field, value );
+   }
+} // format_field()
@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Format fields as text without streams
+///
+/// Numbers are formatted with `std::to_chars()` straight into a caller's
+/// `std::string`, which is meant to be reused from one file to the next so
+/// that formatting doesn't allocate once the buffer has grown.
+///
+/// @file   Format.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstdint>      // For uint64_t
+#include <string>       // For string
+#include <string_view>  // For string_view
+
+#include "HeaderView.h"
+
+
+/// Append `value` in decimal
+extern void append_dec( std::string& out, uint64_t value );
+
+/// Append `value` in lower-case hex with a `0x` prefix
+extern void append_hex( std::string& out, uint64_t value );
+
+/// Append the `length` bytes at `bytes` as lower-case hex pairs (for digests)
+extern void append_hex_bytes( std::string& out, const uint8_t* bytes, size_t length );
+
+/// Append `value` in fixed-point with `precision` digits after the point
+extern void append_fixed( std::string& out, double value, int precision );
+
+/// Append `text` left-justified and padded with spaces to `width` characters
+extern void append_padded( std::string& out, std::string_view text, size_t width );
+
+/// Append `value` in hex, except print `0` (with a trailing space) for zero
+extern void append_hex_or_zero( std::string& out, uint64_t value );
+
+/// Append the indented `description` and a colon, padded out to where the value goes
+extern void append_label( std::string& out, std::string_view description );
+
+/// Append `value` formatted with the rules in `field`
+///
+/// This is the byte-for-byte equivalent of the old stream-based
+/// `Field::get_value()`.
+extern void format_value( std::string& out, const FieldDescriptor& field, uint64_t value );
+
+/// Append the names of the flags that are set in `value`, one per line
+///
+/// Only the bits that are set are visited.
+extern void format_characteristics( std::string& out, const FieldDescriptor& field, uint64_t value );
+
+/// Append the line for one field (and its characteristics if it has #WITH_FLAGS)
+///
+/// Fields that format to nothing are skipped.  Each field is formatted once.
+extern void format_field( std::string& out, const FieldDescriptor& field, uint64_t value );
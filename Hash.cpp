@@ -0,0 +1,298 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Streaming SHA-256 and MD5
+///
+/// @file   Hash.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For min()
+#include <bit>        // For rotl() rotr()
+#include <cstring>    // For memcpy()
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+   #include <immintrin.h>  // For the SHA and SSE intrinsics
+   #define HAVE_SHA_NI_KERNEL
+#endif
+
+#include "Hash.h"
+
+using namespace std;
+
+
+/// The SHA-256 round constants
+alignas( 16 ) static constexpr uint32_t SHA256_K[64] {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5
+   ,0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174
+   ,0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da
+   ,0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967
+   ,0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85
+   ,0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070
+   ,0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3
+   ,0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+
+/// Hashes `count` 64-byte blocks at `blocks` into `state`
+using Sha256Kernel = void (*)( uint32_t state[8], const uint8_t* blocks, size_t count );
+
+
+/// The portable SHA-256 compression function
+static void sha256_scalar( uint32_t state[8], const uint8_t* blocks, size_t count ) {
+   for( ; count > 0 ; count--, blocks += 64 ) {
+      uint32_t w[64];
+      for( size_t i = 0 ; i < 16 ; i++ ) {
+         w[i] = uint32_t{ blocks[i*4] } << 24 | uint32_t{ blocks[i*4+1] } << 16 | uint32_t{ blocks[i*4+2] } << 8 | blocks[i*4+3];
+      }
+      for( size_t i = 16 ; i < 64 ; i++ ) {
+         const uint32_t s0 = rotr( w[i-15], 7 ) ^ rotr( w[i-15], 18 ) ^ ( w[i-15] >> 3 );
+         const uint32_t s1 = rotr( w[i-2], 17 ) ^ rotr( w[i-2], 19 )  ^ ( w[i-2] >> 10 );
+         w[i] = w[i-16] + s0 + w[i-7] + s1;
+      }
+
+      uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+      uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+      for( size_t i = 0 ; i < 64 ; i++ ) {
+         const uint32_t t1 = h + ( rotr( e, 6 ) ^ rotr( e, 11 ) ^ rotr( e, 25 ) ) + ( ( e & f ) ^ ( ~e & g ) ) + SHA256_K[i] + w[i];
+         const uint32_t t2 = ( rotr( a, 2 ) ^ rotr( a, 13 ) ^ rotr( a, 22 ) ) + ( ( a & b ) ^ ( a & c ) ^ ( b & c ) );
+         h = g;  g = f;  f = e;  e = d + t1;
+         d = c;  c = b;  b = a;  a = t1 + t2;
+      }
+      state[0] += a;  state[1] += b;  state[2] += c;  state[3] += d;
+      state[4] += e;  state[5] += f;  state[6] += g;  state[7] += h;
+   }
+} // sha256_scalar()
+
+
+#if defined( HAVE_SHA_NI_KERNEL )
+/// The SHA-256 compression function with the x86 SHA extensions
+///
+/// The message schedule for each group of 4 rounds is built 3 groups ahead
+/// with `sha256msg1` and finished the group before with `sha256msg2`.
+__attribute__(( target( "sha,sse4.1" ) ))
+static void sha256_sha_ni( uint32_t state[8], const uint8_t* blocks, size_t count ) {
+   const __m128i byte_swap = _mm_set_epi64x( 0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL );
+
+   // The instructions want the state as ABEF and CDGH
+   __m128i dcba   = _mm_loadu_si128( reinterpret_cast<const __m128i*>( &state[0] ) );
+   __m128i state1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( &state[4] ) );
+   dcba           = _mm_shuffle_epi32( dcba, 0xB1 );
+   state1         = _mm_shuffle_epi32( state1, 0x1B );
+   __m128i state0 = _mm_alignr_epi8( dcba, state1, 8 );
+   state1         = _mm_blend_epi16( state1, dcba, 0xF0 );
+
+   for( ; count > 0 ; count--, blocks += 64 ) {
+      const __m128i abef_save = state0;
+      const __m128i cdgh_save = state1;
+      __m128i       messages[4];
+
+      for( size_t group = 0 ; group < 16 ; group++ ) {
+         if( group < 4 ) {
+            messages[group] = _mm_shuffle_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( blocks + group * 16 ) ), byte_swap );
+         }
+         const __m128i current = messages[ group % 4 ];
+
+         __m128i message = _mm_add_epi32( current, _mm_load_si128( reinterpret_cast<const __m128i*>( &SHA256_K[ group * 4 ] ) ) );
+         state1 = _mm_sha256rnds2_epu32( state1, state0, message );
+
+         if( group >= 3 && group < 15 ) {  // Finish the schedule for the next group
+            __m128i& next = messages[ ( group + 1 ) % 4 ];
+            next = _mm_add_epi32( next, _mm_alignr_epi8( current, messages[ ( group + 3 ) % 4 ], 4 ) );
+            next = _mm_sha256msg2_epu32( next, current );
+         }
+
+         message = _mm_shuffle_epi32( message, 0x0E );
+         state0  = _mm_sha256rnds2_epu32( state0, state1, message );
+
+         if( group >= 1 && group < 13 ) {  // Start the schedule for the group 3 ahead
+            __m128i& ahead = messages[ ( group + 3 ) % 4 ];
+            ahead = _mm_sha256msg1_epu32( ahead, current );
+         }
+      }
+
+      state0 = _mm_add_epi32( state0, abef_save );
+      state1 = _mm_add_epi32( state1, cdgh_save );
+   }
+
+   // Back to ABCD and EFGH
+   const __m128i feba = _mm_shuffle_epi32( state0, 0x1B );
+   state1             = _mm_shuffle_epi32( state1, 0xB1 );
+   state0             = _mm_blend_epi16( feba, state1, 0xF0 );
+   state1             = _mm_alignr_epi8( state1, feba, 8 );
+   _mm_storeu_si128( reinterpret_cast<__m128i*>( &state[0] ), state0 );
+   _mm_storeu_si128( reinterpret_cast<__m128i*>( &state[4] ), state1 );
+} // sha256_sha_ni()
+#endif
+
+
+/// The SHA-256 kernel for this CPU and its name
+struct Sha256KernelChoice {
+   Sha256Kernel kernel;  ///< The function
+   const char*  name;    ///< What to call it
+};
+
+
+/// @return The SHA-256 kernel (chosen once, the first time it's asked for)
+static const Sha256KernelChoice& sha256_kernel() {
+   static const Sha256KernelChoice choice = [] () -> Sha256KernelChoice {
+#if defined( HAVE_SHA_NI_KERNEL )
+      __builtin_cpu_init();
+      if( __builtin_cpu_supports( "sha" ) && __builtin_cpu_supports( "sse4.1" ) ) {
+         return { sha256_sha_ni, "sha-ni" };
+      }
+#endif
+      return { sha256_scalar, "scalar" };
+   }();
+   return choice;
+}
+
+
+Sha256::Sha256() : state_ { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 } {}
+
+
+void Sha256::update( const void* data, size_t length ) {
+   if( length == 0 ) {
+      return;  // An empty section has no bytes (and `data` may be `nullptr`)
+   }
+   const Sha256Kernel kernel = sha256_kernel().kernel;
+   const uint8_t*     bytes  = static_cast<const uint8_t*>( data );
+   length_ += length;
+
+   if( block_size_ > 0 ) {  // Top up the partial block first
+      const size_t take = min( length, block_.size() - block_size_ );
+      memcpy( block_.data() + block_size_, bytes, take );
+      block_size_ += take;
+      bytes       += take;
+      length      -= take;
+      if( block_size_ < block_.size() ) {
+         return;
+      }
+      kernel( state_.data(), block_.data(), 1 );
+      block_size_ = 0;
+   }
+
+   // Whole blocks are hashed where they are
+   if( length >= 64 ) {
+      kernel( state_.data(), bytes, length / 64 );
+      bytes  += length / 64 * 64;
+      length %= 64;
+   }
+
+   memcpy( block_.data(), bytes, length );
+   block_size_ = length;
+} // Sha256::update()
+
+
+Sha256::Digest Sha256::finish() {
+   const uint64_t bit_length = length_ * 8;
+
+   const uint8_t padding[64] { 0x80 };
+   update( padding, 1 + ( 119 - block_size_ ) % 64 );  // Leave 8 bytes for the length
+
+   uint8_t length_bytes[8];
+   for( size_t i = 0 ; i < 8 ; i++ ) {
+      length_bytes[i] = static_cast<uint8_t>( bit_length >> ( 56 - i * 8 ) );
+   }
+   update( length_bytes, sizeof( length_bytes ) );
+
+   Digest digest;
+   for( size_t i = 0 ; i < 8 ; i++ ) {
+      for( size_t j = 0 ; j < 4 ; j++ ) {
+         digest[i*4+j] = static_cast<uint8_t>( state_[i] >> ( 24 - j * 8 ) );
+      }
+   }
+   return digest;
+} // Sha256::finish()
+
+
+const char* Sha256::kernel_name() {
+   return sha256_kernel().name;
+}
+
+
+/// The MD5 per-round shift amounts
+static constexpr uint8_t MD5_SHIFT[64] {
+    7, 12, 17, 22,  7, 12, 17, 22,  7, 12, 17, 22,  7, 12, 17, 22
+   ,5,  9, 14, 20,  5,  9, 14, 20,  5,  9, 14, 20,  5,  9, 14, 20
+   ,4, 11, 16, 23,  4, 11, 16, 23,  4, 11, 16, 23,  4, 11, 16, 23
+   ,6, 10, 15, 21,  6, 10, 15, 21,  6, 10, 15, 21,  6, 10, 15, 21
+};
+
+/// The MD5 round constants (the integer part of 2^32 * abs(sin(i + 1)))
+static constexpr uint32_t MD5_K[64] {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501
+   ,0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821
+   ,0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8
+   ,0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a
+   ,0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70
+   ,0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665
+   ,0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1
+   ,0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+
+Md5::Md5() : state_ { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 } {}
+
+
+void Md5::compress( const uint8_t* block ) {
+   uint32_t m[16];
+   for( size_t i = 0 ; i < 16 ; i++ ) {
+      m[i] = uint32_t{ block[i*4] } | uint32_t{ block[i*4+1] } << 8 | uint32_t{ block[i*4+2] } << 16 | uint32_t{ block[i*4+3] } << 24;
+   }
+
+   uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+   for( size_t i = 0 ; i < 64 ; i++ ) {
+      uint32_t f;
+      size_t   g;
+      if( i < 16 )      { f = ( b & c ) | ( ~b & d );  g = i;                }
+      else if( i < 32 ) { f = ( d & b ) | ( ~d & c );  g = ( 5 * i + 1 ) % 16; }
+      else if( i < 48 ) { f = b ^ c ^ d;               g = ( 3 * i + 5 ) % 16; }
+      else              { f = c ^ ( b | ~d );          g = ( 7 * i ) % 16;     }
+
+      const uint32_t rotated = b + rotl( a + f + MD5_K[i] + m[g], MD5_SHIFT[i] );
+      a = d;  d = c;  c = b;  b = rotated;
+   }
+   state_[0] += a;  state_[1] += b;  state_[2] += c;  state_[3] += d;
+} // Md5::compress()
+
+
+void Md5::update( const void* data, size_t length ) {
+   const uint8_t* bytes = static_cast<const uint8_t*>( data );
+   length_ += length;
+
+   while( length > 0 ) {
+      const size_t take = min( length, block_.size() - block_size_ );
+      memcpy( block_.data() + block_size_, bytes, take );
+      block_size_ += take;
+      bytes       += take;
+      length      -= take;
+      if( block_size_ == block_.size() ) {
+         compress( block_.data() );
+         block_size_ = 0;
+      }
+   }
+} // Md5::update()
+
+
+Md5::Digest Md5::finish() {
+   const uint64_t bit_length = length_ * 8;
+
+   const uint8_t padding[64] { 0x80 };
+   update( padding, 1 + ( 119 - block_size_ ) % 64 );  // Leave 8 bytes for the length
+
+   uint8_t length_bytes[8];
+   for( size_t i = 0 ; i < 8 ; i++ ) {
+      length_bytes[i] = static_cast<uint8_t>( bit_length >> ( i * 8 ) );
+   }
+   update( length_bytes, sizeof( length_bytes ) );
+
+   Digest digest;
+   for( size_t i = 0 ; i < 4 ; i++ ) {
+      for( size_t j = 0 ; j < 4 ; j++ ) {
+         digest[i*4+j] = static_cast<uint8_t>( state_[i] >> ( j * 8 ) );
+      }
+   }
+   return digest;
+} // Md5::finish()
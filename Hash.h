@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Streaming SHA-256 and MD5
+///
+/// Both hash the bytes they're given in place (from the mapping or the
+/// buffer of a ByteSource) without copying them.  SHA-256 uses the x86 SHA
+/// extensions when the CPU has them.  MD5 is only here for the imphash.
+///
+/// @file   Hash.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <array>    // For array
+#include <cstddef>  // For size_t
+#include <cstdint>  // For uint8_t uint32_t uint64_t
+
+
+/// A streaming SHA-256 (FIPS 180-4)
+class Sha256 {
+public:
+   using Digest = std::array<uint8_t, 32>;  ///< A SHA-256 digest
+
+protected:
+   std::array<uint32_t, 8> state_;                 ///< The chaining value
+   std::array<uint8_t, 64> block_;                 ///< A partial block
+   size_t                  block_size_ { 0 };      ///< The bytes in #block_
+   uint64_t                length_     { 0 };      ///< The number of bytes hashed
+
+public:
+   Sha256();
+
+   /// Hash `length` more bytes at `data`
+   void update( const void* data, size_t length );
+
+   /// @return The digest of everything that was hashed (the object can't be updated after this)
+   Digest finish();
+
+   /// @return The name of the compression function used on this CPU
+   static const char* kernel_name();
+}; // Sha256
+
+
+/// A streaming MD5 (RFC 1321)
+class Md5 {
+public:
+   using Digest = std::array<uint8_t, 16>;  ///< An MD5 digest
+
+protected:
+   std::array<uint32_t, 4> state_;                 ///< The chaining value
+   std::array<uint8_t, 64> block_;                 ///< A partial block
+   size_t                  block_size_ { 0 };      ///< The bytes in #block_
+   uint64_t                length_     { 0 };      ///< The number of bytes hashed
+
+   /// Hash the 64-byte block at `block`
+   void compress( const uint8_t* block );
+
+public:
+   Md5();
+
+   /// Hash `length` more bytes at `data`
+   void update( const void* data, size_t length );
+
+   /// @return The digest of everything that was hashed (the object can't be updated after this)
+   Digest finish();
+}; // Md5
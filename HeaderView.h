@@ -0,0 +1,733 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// The layout of the PE headers and zero-copy views over them
+///
+/// A header view is a pointer into PEFile.source_ plus the number of bytes
+/// that are really there.  Fields are loaded on demand, one at a time, with
+/// bounds-checked, endian-safe, unaligned loads, so looking at one field
+/// (like `Machine`) never touches the rest of the header.
+///
+/// @file   HeaderView.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <algorithm>  // For max() min()
+#include <array>      // For array
+#include <cstddef>    // For size_t
+#include <cstdint>    // For uint8_t uint16_t uint32_t uint64_t
+#include <stdexcept>  // For out_of_range domain_error
+#include <string>     // For string
+
+#include "ByteSource.h"
+#include "Flags.h"
+
+
+typedef uint8_t Rules;  ///< The base-type of our rules flag.
+
+// Special processing rules
+#define AS_DEC     0x01  ///< Print the value as a decimal number
+#define AS_HEX     0x02  ///< Print the value as a hexadecimal number
+#define AS_CHAR    0x04  ///< Print as a fixed-width character array
+#define WITH_TIME  0x08  ///< Print with timestamp
+#define WITH_FLAG  0x10  ///< Decode a single flag
+#define WITH_FLAGS 0x20  ///< Decode several flags
+
+
+/// Describes one field in a group of fields: where it is, how wide it is
+/// and how to print it
+///
+/// A group of fields is laid out as a `constexpr` array of these, sorted by #label.
+struct FieldDescriptor {
+   const char* label;        ///< A unique, sortable name for this field like `02_coff_machine`
+   size_t      offset;       ///< The offset into this group of fields
+   size_t      width;        ///< The size of this field in bytes (1, 2, 4 or 8)
+   Rules       rules;        ///< Special processing rules for this field such as #AS_HEX or #WITH_TIME
+   const char* description;  ///< A description of this field
+   const FlagTable* flags { nullptr };  ///< How to decode #WITH_FLAG and #WITH_FLAGS fields
+   bool        has_flags { false };     ///< `true` if the field was given a FlagTable (a test that works in a constant expression)
+
+   /// A field that doesn't decode flags
+   constexpr FieldDescriptor( const char* new_label, const size_t new_offset, const size_t new_width, const Rules new_rules, const char* new_description )
+         :label      ( new_label )        // Member initialization
+         ,offset     ( new_offset )       // Member initialization
+         ,width      ( new_width )        // Member initialization
+         ,rules      ( new_rules )        // Member initialization
+         ,description( new_description )  // Member initialization
+   {}
+
+   /// A field that decodes flags with `new_flags`
+   constexpr FieldDescriptor( const char* new_label, const size_t new_offset, const size_t new_width, const Rules new_rules, const char* new_description, const FlagTable* new_flags )
+         :label      ( new_label )        // Member initialization
+         ,offset     ( new_offset )       // Member initialization
+         ,width      ( new_width )        // Member initialization
+         ,rules      ( new_rules )        // Member initialization
+         ,description( new_description )  // Member initialization
+         ,flags      ( new_flags )        // Member initialization
+         ,has_flags  ( true )             // Member initialization
+   {}
+}; // FieldDescriptor
+
+
+/// The unsigned integer type that is `WIDTH` bytes wide
+template <size_t WIDTH> struct UnsignedOfWidth;
+template <> struct UnsignedOfWidth<1> { using type = uint8_t;  };  ///< A 1 byte field
+template <> struct UnsignedOfWidth<2> { using type = uint16_t; };  ///< A 2 byte field
+template <> struct UnsignedOfWidth<4> { using type = uint32_t; };  ///< A 4 byte field
+template <> struct UnsignedOfWidth<8> { using type = uint64_t; };  ///< An 8 byte field
+
+
+/// @return `true` if `left` sorts before `right` (a `constexpr` `strcmp()`)
+constexpr bool label_less( const char* left, const char* right ) {
+   while( *left != '\0' && *left == *right ) {
+      left++;
+      right++;
+   }
+   return static_cast<unsigned char>( *left ) < static_cast<unsigned char>( *right );
+}
+
+
+/// Check a layout at compile time
+///
+/// Every field needs a description and a supported width, fields that
+/// decode flags need a FlagTable, and the labels must be sorted so fields
+/// print in the same order as before.
+///
+/// @return `true` if `layout` is well formed
+template <size_t SIZE>
+constexpr bool is_valid_layout( const std::array<FieldDescriptor, SIZE>& layout ) {
+   for( size_t i = 0 ; i < SIZE ; i++ ) {
+      if( layout[i].description == nullptr || layout[i].description[0] == '\0' ) { return false; }
+      if( layout[i].width != 1 && layout[i].width != 2 && layout[i].width != 4 && layout[i].width != 8 ) { return false; }
+      if( ( layout[i].rules & ( WITH_FLAG | WITH_FLAGS ) ) && !layout[i].has_flags ) { return false; }
+      if( i > 0 && !label_less( layout[i-1].label, layout[i].label ) ) { return false; }
+   }
+   return true;
+}
+
+
+/// @return The index of the field called `label` in `layout` (or `SIZE` if there isn't one)
+template <size_t SIZE>
+constexpr size_t field_index( const std::array<FieldDescriptor, SIZE>& layout, const char* label ) {
+   for( size_t i = 0 ; i < SIZE ; i++ ) {
+      if( !label_less( layout[i].label, label ) && !label_less( label, layout[i].label ) ) { return i; }
+   }
+   return SIZE;
+}
+
+
+/// @return The number of bytes that `layout` spans from the start of its group
+template <size_t SIZE>
+constexpr size_t layout_extent( const std::array<FieldDescriptor, SIZE>& layout ) {
+   size_t extent { 0 };
+   for( const FieldDescriptor& field : layout ) {
+      extent = std::max( extent, field.offset + field.width );
+   }
+   return extent;
+}
+
+
+/// Load a `T` that's stored little-endian at `bytes` (which need not be aligned)
+///
+/// Compilers turn this into a single load on little-endian hosts.
+///
+/// @return The value
+template <typename T>
+inline T load_le( const char* bytes ) {
+   T value { 0 };
+   for( size_t i = 0 ; i < sizeof( T ) ; i++ ) {
+      value |= static_cast<T>( static_cast<T>( static_cast<unsigned char>( bytes[i] ) ) << ( i * 8 ) );
+   }
+   return value;
+}
+
+
+/// Load a little-endian value that's `width` bytes wide (1, 2, 4 or 8)
+///
+/// @return The value widened to 64 bits
+inline uint64_t load_le( const char* bytes, const size_t width ) {
+   switch( width ) {
+      case 1:  return load_le<uint8_t> ( bytes );
+      case 2:  return load_le<uint16_t>( bytes );
+      case 4:  return load_le<uint32_t>( bytes );
+      default: return load_le<uint64_t>( bytes );
+   }
+}
+
+
+/// A zero-copy view of a group of fields laid out by the `constexpr` table `LAYOUT`
+///
+/// The view never copies the header.  Each field is loaded only when it's
+/// asked for, after checking that it lies inside the bytes that the file
+/// really has (a truncated header is fine until a missing field is read).
+/// bind() works out which fields are in the file once for the whole group,
+/// so a loop over the fields (ReportWriter::fields()) checks the group once
+/// and then loads each field with load(), which doesn't check.
+///
+/// @tparam LAYOUT A `constexpr std::array` of FieldDescriptor
+template <const auto& LAYOUT>
+class HeaderView {
+public:
+   static constexpr size_t SIZE   = LAYOUT.size();           ///< The number of fields in this group
+   static constexpr size_t EXTENT = layout_extent( LAYOUT );  ///< The number of bytes this group spans
+
+   static_assert( is_valid_layout( LAYOUT ), "Fields need a description, a width of 1, 2, 4 or 8, a FlagTable for flags and sorted labels" );
+   static_assert( SIZE <= 64, "A group needs one bit per field" );
+
+   static constexpr uint64_t ALL_FIELDS = UINT64_MAX >> ( 64 - SIZE );  ///< One bit for each field in the group
+
+protected:
+   size_t      file_offset_ { 0 };        ///< Offset into PEFile.source_ where this group of fields start
+   const char* base_        { nullptr };  ///< The first byte of this group of fields
+   size_t      available_   { 0 };        ///< The number of bytes at #base_ that are in the file (up to #EXTENT)
+   uint64_t    present_     { 0 };        ///< Bit `i` is set if field `i` is inside #available_
+
+public:
+   /// Throw `out_of_range` unless field `index` is inside #available_
+   void check_field( const size_t index ) const {
+      if( LAYOUT[index].offset + LAYOUT[index].width > available_ ) {
+         throw std::out_of_range( std::string( "Field " ) + LAYOUT[index].label + " is past the end of the file" );
+      }
+   }
+
+   /// Create a view of the group of fields at `new_file_offset` (not bound to any bytes yet)
+   ///
+   /// @param new_file_offset The offset into PEFile.source_ for this group of fields
+   explicit HeaderView( const size_t new_file_offset ) : file_offset_( new_file_offset ) {}
+
+   /// Point this view at the bytes in `file_source`
+   ///
+   /// Only the part of the group that is inside the file (and inside
+   /// `limit`, for groups whose real size is in another header) is mapped in.
+   ///
+   /// @param file_source Reference to PEFile.source_
+   /// @param limit       The most bytes this group can have
+   void bind( ByteSource& file_source, const size_t limit = EXTENT ) {
+      available_ = file_offset_ < file_source.size() ? std::min( { EXTENT, limit, file_source.size() - file_offset_ } ) : 0;
+      base_      = available_ > 0 ? file_source.read( file_offset_, available_ ) : nullptr;
+
+      // A whole group (the usual case) is one comparison
+      present_ = available_ == EXTENT ? ALL_FIELDS : 0;
+      if( available_ < EXTENT ) {
+         for( size_t i = 0 ; i < SIZE ; i++ ) {
+            if( LAYOUT[i].offset + LAYOUT[i].width <= available_ ) {
+               present_ |= uint64_t { 1 } << i;
+            }
+         }
+      }
+   }
+
+   static constexpr const auto& layout() {
+      return LAYOUT;  /// @return The layout of this group of fields
+   }
+
+   size_t get_file_offset() const {
+      return file_offset_;  /// @return The offset into PEFile.source_ for this group of fields
+   }
+
+   bool is_complete() const {
+      return available_ == EXTENT;  /// @return `true` if every field in the group is inside the file
+   }
+
+   uint64_t present() const {
+      return present_;  /// @return Bit `i` is set if field `i` is inside the file
+   }
+
+   /// @return The value of field `INDEX` with the type that matches its width
+   template <size_t INDEX>
+   auto get() const {
+      static_assert( INDEX < SIZE, "There is no such field" );
+      check_field( INDEX );
+      return load_le<typename UnsignedOfWidth<LAYOUT[INDEX].width>::type>( base_ + LAYOUT[INDEX].offset );
+   }
+
+   /// @return The value of the field called `LABEL`
+   ///
+   /// This is for views that share field names across several layouts.
+   template <const char* const& LABEL>
+   auto get_by_label() const {
+      constexpr size_t index = field_index( LAYOUT, LABEL );
+      static_assert( index < SIZE, "There is no field with that label" );
+      return get<index>();
+   }
+
+   /// @return The value of field `index` (picked at runtime) widened to 64 bits
+   uint64_t value( const size_t index ) const {
+      check_field( index );
+      return load( index );
+   }
+
+   /// @return The value of field `index` widened to 64 bits, without checking
+   ///         that it's in the file (its bit in present() must be set)
+   uint64_t load( const size_t index ) const {
+      return load_le( base_ + LAYOUT[index].offset, LAYOUT[index].width );
+   }
+}; // HeaderView
+
+
+/// The layout of the DOS header
+///
+/// @see DOS header reference: http://www.sunshine2k.de/reversing/tuts/tut_pe.htm
+inline constexpr std::array<FieldDescriptor, 16> DOS_LAYOUT {{
+    { "01_dos_e_magic",    0x00, 2, AS_HEX | AS_CHAR, "Magic number"                 }
+   ,{ "02_dos_e_cblp",     0x02, 2, AS_DEC,           "Bytes in last page"           }
+   ,{ "03_dos_e_cp",       0x04, 2, AS_DEC,           "Pages in file"                }
+   ,{ "04_dos_e_crlc",     0x06, 2, AS_DEC,           "Relocations"                  }
+   ,{ "05_dos_e_cparhdr",  0x08, 2, AS_DEC,           "Size of header in paragraphs" }
+   ,{ "06_dos_e_minalloc", 0x0A, 2, AS_DEC,           "Minimum extra paragraphs"     }
+   ,{ "07_dos_e_maxalloc", 0x0C, 2, AS_DEC,           "Maximum extra paragraphs"     }
+   ,{ "08_dos_e_ss",       0x0E, 2, AS_DEC,           "Initial (relative) SS value"  }
+   ,{ "09_dos_e_sp",       0x10, 2, AS_HEX,           "Initial SP value"             }
+   ,{ "10_dos_e_ip",       0x14, 2, AS_HEX,           "Initial IP value"             }
+   ,{ "11_dos_e_cs",       0x16, 2, AS_HEX,           "Initial (relative) CS value"  }
+   ,{ "12_dos_e_lfarlc",   0x18, 2, AS_HEX,           "Address of relocation table"  }
+   ,{ "13_dos_e_ovno",     0x1A, 2, AS_DEC,           "Overlay number"               }
+   ,{ "14_dos_e_oemid",    0x24, 2, AS_DEC,           "OEM identifier"               }
+   ,{ "15_dos_e_oeminfo",  0x26, 2, AS_DEC,           "OEM information"              }
+   ,{ "16_dos_e_lfanew",   0x3C, 4, AS_HEX,           "PE header offset"             }
+}}; // DOS_LAYOUT
+
+/// Indexes into #DOS_LAYOUT
+enum DOS_Field : size_t {
+    DOS_E_MAGIC
+   ,DOS_E_CBLP
+   ,DOS_E_CP
+   ,DOS_E_CRLC
+   ,DOS_E_CPARHDR
+   ,DOS_E_MINALLOC
+   ,DOS_E_MAXALLOC
+   ,DOS_E_SS
+   ,DOS_E_SP
+   ,DOS_E_IP
+   ,DOS_E_CS
+   ,DOS_E_LFARLC
+   ,DOS_E_OVNO
+   ,DOS_E_OEMID
+   ,DOS_E_OEMINFO
+   ,DOS_E_LFANEW
+};
+
+
+/// The layout of the COFF/File header (starting at the `PE\0\0` signature)
+inline constexpr std::array<FieldDescriptor, 8> COFF_LAYOUT {{
+    { "01_coff_signature",            0x00, 4, 0,                   "coff_signature"          }
+   ,{ "02_coff_machine",              0x04, 2, AS_HEX | WITH_FLAG,  "Machine",                 &MACHINE_FLAGS             }
+   ,{ "03_coff_sections",             0x06, 2, AS_DEC,              "Number of Sections"      }
+   ,{ "04_coff_timedatestamp",        0x08, 4, AS_DEC | WITH_TIME,  "Date/time stamp"         }
+   ,{ "05_coff_PointerToSymbolTable", 0x0C, 4, AS_DEC,              "Symbol Table offset"     }
+   ,{ "06_coff_NumberOfSymbols",      0x10, 4, AS_DEC,              "Number of symbols"       }
+   ,{ "07_coff_SizeOfOptionalHeader", 0x14, 2, AS_HEX,              "Size of optional header" }
+   ,{ "08_coff_characteristics",      0x16, 2, AS_HEX | WITH_FLAGS, "Characteristics",         &COFF_CHARACTERISTIC_FLAGS }
+}}; // COFF_LAYOUT
+
+/// Indexes into #COFF_LAYOUT
+enum COFF_Field : size_t {
+    COFF_SIGNATURE
+   ,COFF_MACHINE
+   ,COFF_SECTIONS
+   ,COFF_TIMEDATESTAMP
+   ,COFF_POINTER_TO_SYMBOL_TABLE
+   ,COFF_NUMBER_OF_SYMBOLS
+   ,COFF_SIZE_OF_OPTIONAL_HEADER
+   ,COFF_CHARACTERISTICS
+};
+
+
+/// The layout of one entry in the section table
+inline constexpr std::array<FieldDescriptor, 7> SECTION_LAYOUT {{
+    { "01_section_name",                0x00, 8, AS_CHAR,             "    Name"                  }
+   ,{ "02_section_virtual_size",        0x08, 4, AS_DEC | AS_HEX,     "    Virtual Size"          }
+   ,{ "03_section_virtual_Address",     0x0C, 4, AS_HEX,              "    Virtual Address"       }
+   ,{ "04_section_raw_size",            0x10, 4, AS_DEC | AS_HEX,     "    Size Of Raw Data"      }
+   ,{ "05_section_raw_offset",          0x14, 4, AS_HEX,              "    Pointer To Raw Data"   }
+   ,{ "06_section_NumberOfRelocations", 0x20, 2, AS_HEX,              "    Number Of Relocations" }
+   ,{ "07_section_characteristics",     0x24, 4, AS_HEX | WITH_FLAGS, "    Characteristics",       &SECTION_CHARACTERISTIC_FLAGS }
+}}; // SECTION_LAYOUT
+
+/// Indexes into #SECTION_LAYOUT
+enum Section_Field : size_t {
+    SECTION_NAME
+   ,SECTION_VIRTUAL_SIZE
+   ,SECTION_VIRTUAL_ADDRESS
+   ,SECTION_RAW_SIZE
+   ,SECTION_RAW_OFFSET
+   ,SECTION_NUMBER_OF_RELOCATIONS
+   ,SECTION_CHARACTERISTICS
+};
+
+
+/// A view of the DOS header
+class DosHeaderView : public HeaderView<DOS_LAYOUT> {
+public:
+   /// The DOS header is always at the start of the file
+   DosHeaderView() : HeaderView( 0 ) {}
+
+   /// @return The PEFile.source_ offset to the COFF section
+   uint32_t get_exe_header_offset() const {
+      return get<DOS_E_LFANEW>();
+   }
+
+   /// Validate the DOS magic number
+   void validate() const {
+      if( get<DOS_E_MAGIC>() != 0x5a4d ) { throw std::domain_error( "Invalid magic in DOS header" ); }
+   }
+}; // DosHeaderView
+
+
+/// A view of the COFF/File header
+class CoffHeaderView : public HeaderView<COFF_LAYOUT> {
+public:
+   /// Create a view of the COFF header at `new_file_offset`
+   ///
+   /// @param new_file_offset The offset into PEFile.source_ for this group of fields
+   explicit CoffHeaderView( const size_t new_file_offset ) : HeaderView( new_file_offset ) {}
+
+   /// @return The file offset to the top of the section table
+   uint32_t get_section_table_offset() const {
+      // The first section starts immediately after the optional header...
+      // So, it's at: file_offset_ + 18 (size of the COFF header) + coff_SizeOfOptionalHeader
+      return file_offset_ + 0x18 + get<COFF_SIZE_OF_OPTIONAL_HEADER>();
+   }
+
+   /// @return The file offset to the optional header (right after the COFF header)
+   uint32_t get_optional_header_offset() const {
+      return file_offset_ + 0x18;
+   }
+
+   /// @return The size of the optional header (0 for object files)
+   uint16_t get_size_of_optional_header() const {
+      return get<COFF_SIZE_OF_OPTIONAL_HEADER>();
+   }
+
+   /// @return The number of sections in this PEFile
+   uint16_t get_number_of_sections() const {
+      return get<COFF_SECTIONS>();
+   }
+
+   /// Validate the `PE\0\0` signature
+   void validate() const {
+      if( get<COFF_SIGNATURE>() != 0x4550 ) { // Validate the magic is "PE"
+         throw( std::domain_error( "Invalid COFF signature magic") );
+      }
+   }
+}; // CoffHeaderView
+
+
+/// A view of one entry in the section table
+class SectionHeaderView : public HeaderView<SECTION_LAYOUT> {
+public:
+   /// Create a view of the section header at `new_file_offset`
+   ///
+   /// @param new_file_offset The offset into PEFile.source_ for this group of fields
+   explicit SectionHeaderView( const size_t new_file_offset ) : HeaderView( new_file_offset ) {}
+
+   /// Nothing to validate in a section header
+   void validate() const {}
+}; // SectionHeaderView
+
+
+/// The layout of a PE32 optional header (up to the data directories)
+inline constexpr std::array<FieldDescriptor, 30> OPTIONAL32_LAYOUT {{
+    { "01_opt_magic",                       0x00, 2, AS_HEX | WITH_FLAG,  "Magic",                        &OPTIONAL_MAGIC_FLAGS     }
+   ,{ "02_opt_MajorLinkerVersion",          0x02, 1, AS_DEC,              "Major linker version"                                  }
+   ,{ "03_opt_MinorLinkerVersion",          0x03, 1, AS_DEC,              "Minor linker version"                                  }
+   ,{ "04_opt_SizeOfCode",                  0x04, 4, AS_DEC | AS_HEX,     "Size of code"                                          }
+   ,{ "05_opt_SizeOfInitializedData",       0x08, 4, AS_DEC | AS_HEX,     "Size of initialized data"                              }
+   ,{ "06_opt_SizeOfUninitializedData",     0x0C, 4, AS_DEC | AS_HEX,     "Size of uninitialized data"                            }
+   ,{ "07_opt_AddressOfEntryPoint",         0x10, 4, AS_HEX,              "Entry point"                                           }
+   ,{ "08_opt_BaseOfCode",                  0x14, 4, AS_HEX,              "Base of code"                                          }
+   ,{ "09_opt_BaseOfData",                  0x18, 4, AS_HEX,              "Base of data"                                          }
+   ,{ "10_opt_ImageBase",                   0x1C, 4, AS_HEX,              "Image base"                                            }
+   ,{ "11_opt_SectionAlignment",            0x20, 4, AS_HEX,              "Section alignment"                                     }
+   ,{ "12_opt_FileAlignment",               0x24, 4, AS_HEX,              "File alignment"                                        }
+   ,{ "13_opt_MajorOperatingSystemVersion", 0x28, 2, AS_DEC,              "Major OS version"                                      }
+   ,{ "14_opt_MinorOperatingSystemVersion", 0x2A, 2, AS_DEC,              "Minor OS version"                                      }
+   ,{ "15_opt_MajorImageVersion",           0x2C, 2, AS_DEC,              "Major image version"                                   }
+   ,{ "16_opt_MinorImageVersion",           0x2E, 2, AS_DEC,              "Minor image version"                                   }
+   ,{ "17_opt_MajorSubsystemVersion",       0x30, 2, AS_DEC,              "Major subsystem version"                               }
+   ,{ "18_opt_MinorSubsystemVersion",       0x32, 2, AS_DEC,              "Minor subsystem version"                               }
+   ,{ "19_opt_Win32VersionValue",           0x34, 4, AS_DEC,              "Win32 version value"                                   }
+   ,{ "20_opt_SizeOfImage",                 0x38, 4, AS_DEC | AS_HEX,     "Size of image"                                         }
+   ,{ "21_opt_SizeOfHeaders",               0x3C, 4, AS_DEC | AS_HEX,     "Size of headers"                                       }
+   ,{ "22_opt_CheckSum",                    0x40, 4, AS_HEX,              "Checksum"                                              }
+   ,{ "23_opt_Subsystem",                   0x44, 2, AS_HEX | WITH_FLAG,  "Subsystem",                    &SUBSYSTEM_FLAGS          }
+   ,{ "24_opt_DllCharacteristics",          0x46, 2, AS_HEX | WITH_FLAGS, "DLL characteristics",          &DLL_CHARACTERISTIC_FLAGS }
+   ,{ "25_opt_SizeOfStackReserve",          0x48, 4, AS_DEC | AS_HEX,     "Size of stack reserve"                                 }
+   ,{ "26_opt_SizeOfStackCommit",           0x4C, 4, AS_DEC | AS_HEX,     "Size of stack commit"                                  }
+   ,{ "27_opt_SizeOfHeapReserve",           0x50, 4, AS_DEC | AS_HEX,     "Size of heap reserve"                                  }
+   ,{ "28_opt_SizeOfHeapCommit",            0x54, 4, AS_DEC | AS_HEX,     "Size of heap commit"                                   }
+   ,{ "29_opt_LoaderFlags",                 0x58, 4, AS_HEX,              "Loader flags"                                          }
+   ,{ "30_opt_NumberOfRvaAndSizes",         0x5C, 4, AS_DEC,              "Number of data directories"                            }
+}}; // OPTIONAL32_LAYOUT
+
+
+/// The layout of a PE32+ optional header (up to the data directories)
+///
+/// There's no BaseOfData, and ImageBase and the stack and heap sizes are 8 bytes.
+inline constexpr std::array<FieldDescriptor, 29> OPTIONAL64_LAYOUT {{
+    { "01_opt_magic",                       0x00, 2, AS_HEX | WITH_FLAG,  "Magic",                        &OPTIONAL_MAGIC_FLAGS     }
+   ,{ "02_opt_MajorLinkerVersion",          0x02, 1, AS_DEC,              "Major linker version"                                  }
+   ,{ "03_opt_MinorLinkerVersion",          0x03, 1, AS_DEC,              "Minor linker version"                                  }
+   ,{ "04_opt_SizeOfCode",                  0x04, 4, AS_DEC | AS_HEX,     "Size of code"                                          }
+   ,{ "05_opt_SizeOfInitializedData",       0x08, 4, AS_DEC | AS_HEX,     "Size of initialized data"                              }
+   ,{ "06_opt_SizeOfUninitializedData",     0x0C, 4, AS_DEC | AS_HEX,     "Size of uninitialized data"                            }
+   ,{ "07_opt_AddressOfEntryPoint",         0x10, 4, AS_HEX,              "Entry point"                                           }
+   ,{ "08_opt_BaseOfCode",                  0x14, 4, AS_HEX,              "Base of code"                                          }
+   ,{ "10_opt_ImageBase",                   0x18, 8, AS_HEX,              "Image base"                                            }
+   ,{ "11_opt_SectionAlignment",            0x20, 4, AS_HEX,              "Section alignment"                                     }
+   ,{ "12_opt_FileAlignment",               0x24, 4, AS_HEX,              "File alignment"                                        }
+   ,{ "13_opt_MajorOperatingSystemVersion", 0x28, 2, AS_DEC,              "Major OS version"                                      }
+   ,{ "14_opt_MinorOperatingSystemVersion", 0x2A, 2, AS_DEC,              "Minor OS version"                                      }
+   ,{ "15_opt_MajorImageVersion",           0x2C, 2, AS_DEC,              "Major image version"                                   }
+   ,{ "16_opt_MinorImageVersion",           0x2E, 2, AS_DEC,              "Minor image version"                                   }
+   ,{ "17_opt_MajorSubsystemVersion",       0x30, 2, AS_DEC,              "Major subsystem version"                               }
+   ,{ "18_opt_MinorSubsystemVersion",       0x32, 2, AS_DEC,              "Minor subsystem version"                               }
+   ,{ "19_opt_Win32VersionValue",           0x34, 4, AS_DEC,              "Win32 version value"                                   }
+   ,{ "20_opt_SizeOfImage",                 0x38, 4, AS_DEC | AS_HEX,     "Size of image"                                         }
+   ,{ "21_opt_SizeOfHeaders",               0x3C, 4, AS_DEC | AS_HEX,     "Size of headers"                                       }
+   ,{ "22_opt_CheckSum",                    0x40, 4, AS_HEX,              "Checksum"                                              }
+   ,{ "23_opt_Subsystem",                   0x44, 2, AS_HEX | WITH_FLAG,  "Subsystem",                    &SUBSYSTEM_FLAGS          }
+   ,{ "24_opt_DllCharacteristics",          0x46, 2, AS_HEX | WITH_FLAGS, "DLL characteristics",          &DLL_CHARACTERISTIC_FLAGS }
+   ,{ "25_opt_SizeOfStackReserve",          0x48, 8, AS_DEC | AS_HEX,     "Size of stack reserve"                                 }
+   ,{ "26_opt_SizeOfStackCommit",           0x50, 8, AS_DEC | AS_HEX,     "Size of stack commit"                                  }
+   ,{ "27_opt_SizeOfHeapReserve",           0x58, 8, AS_DEC | AS_HEX,     "Size of heap reserve"                                  }
+   ,{ "28_opt_SizeOfHeapCommit",            0x60, 8, AS_DEC | AS_HEX,     "Size of heap commit"                                   }
+   ,{ "29_opt_LoaderFlags",                 0x68, 4, AS_HEX,              "Loader flags"                                          }
+   ,{ "30_opt_NumberOfRvaAndSizes",         0x6C, 4, AS_DEC,              "Number of data directories"                            }
+}}; // OPTIONAL64_LAYOUT
+
+
+/// The labels of the optional header fields that PE32 and PE32+ share
+namespace OptionalLabel {
+   inline constexpr const char* MAGIC                   = "01_opt_magic";                ///< Magic
+   inline constexpr const char* ADDRESS_OF_ENTRY_POINT  = "07_opt_AddressOfEntryPoint";  ///< AddressOfEntryPoint
+   inline constexpr const char* IMAGE_BASE              = "10_opt_ImageBase";            ///< ImageBase
+   inline constexpr const char* SIZE_OF_IMAGE           = "20_opt_SizeOfImage";          ///< SizeOfImage
+   inline constexpr const char* SIZE_OF_HEADERS         = "21_opt_SizeOfHeaders";        ///< SizeOfHeaders
+   inline constexpr const char* SUBSYSTEM               = "23_opt_Subsystem";            ///< Subsystem
+   inline constexpr const char* NUMBER_OF_RVA_AND_SIZES = "30_opt_NumberOfRvaAndSizes";  ///< NumberOfRvaAndSizes
+}
+
+
+/// A view of a PE32 or PE32+ optional header (picked by `LAYOUT`)
+///
+/// @tparam LAYOUT #OPTIONAL32_LAYOUT or #OPTIONAL64_LAYOUT
+template <const auto& LAYOUT>
+class OptionalHeaderView : public HeaderView<LAYOUT> {
+public:
+   using HeaderView<LAYOUT>::HeaderView;
+
+   /// @return The RVA of the entry point
+   uint32_t get_entry_point() const {
+      return this->template get_by_label<OptionalLabel::ADDRESS_OF_ENTRY_POINT>();
+   }
+
+   /// @return The preferred load address (widened to 64 bits for PE32)
+   uint64_t get_image_base() const {
+      return this->template get_by_label<OptionalLabel::IMAGE_BASE>();
+   }
+
+   /// @return The size of the image once it's loaded
+   uint32_t get_size_of_image() const {
+      return this->template get_by_label<OptionalLabel::SIZE_OF_IMAGE>();
+   }
+
+   /// @return The combined size of the headers (rounded up to FileAlignment)
+   uint32_t get_size_of_headers() const {
+      return this->template get_by_label<OptionalLabel::SIZE_OF_HEADERS>();
+   }
+
+   /// @return The Windows subsystem
+   uint16_t get_subsystem() const {
+      return this->template get_by_label<OptionalLabel::SUBSYSTEM>();
+   }
+
+   /// @return The number of data directories that the header claims to have
+   uint32_t get_number_of_rva_and_sizes() const {
+      return this->template get_by_label<OptionalLabel::NUMBER_OF_RVA_AND_SIZES>();
+   }
+}; // OptionalHeaderView
+
+using Optional32HeaderView = OptionalHeaderView<OPTIONAL32_LAYOUT>;  ///< A PE32 optional header
+using Optional64HeaderView = OptionalHeaderView<OPTIONAL64_LAYOUT>;  ///< A PE32+ optional header
+
+
+/// The entries in the data directory (in the order they appear in the file)
+enum DataDirectoryIndex : size_t {
+    EXPORT_TABLE
+   ,IMPORT_TABLE
+   ,RESOURCE_TABLE
+   ,EXCEPTION_TABLE
+   ,CERTIFICATE_TABLE
+   ,BASE_RELOCATION_TABLE
+   ,DEBUG_DIRECTORY
+   ,ARCHITECTURE
+   ,GLOBAL_PTR
+   ,TLS_TABLE
+   ,LOAD_CONFIG_TABLE
+   ,BOUND_IMPORT
+   ,IAT
+   ,DELAY_IMPORT_DESCRIPTOR
+   ,CLR_RUNTIME_HEADER
+   ,RESERVED_DIRECTORY
+   ,NUMBER_OF_DATA_DIRECTORIES  ///< The number of entries the spec defines
+};
+
+/// The descriptions of the data directory entries (indexed by DataDirectoryIndex)
+inline constexpr std::array<const char*, NUMBER_OF_DATA_DIRECTORIES> DATA_DIRECTORY_NAMES {
+    "Export Table"
+   ,"Import Table"
+   ,"Resource Table"
+   ,"Exception Table"
+   ,"Certificate Table"
+   ,"Base Relocation Table"
+   ,"Debug"
+   ,"Architecture"
+   ,"Global Ptr"
+   ,"TLS Table"
+   ,"Load Config Table"
+   ,"Bound Import"
+   ,"IAT"
+   ,"Delay Import Descriptor"
+   ,"CLR Runtime Header"
+   ,"Reserved"
+};
+
+
+/// One entry in the data directory
+///
+/// For every entry but the Certificate Table, #virtual_address is an RVA.
+/// The Certificate Table holds a file offset.
+struct DataDirectory {
+   uint32_t virtual_address { 0 };  ///< Where the table is
+   uint32_t size            { 0 };  ///< The size of the table in bytes
+};
+
+
+/// The optional header, which is a PE32 or a PE32+ layout depending on its magic
+///
+/// The data directory is decoded into a fixed-size array when the header is
+/// parsed, so later stages can look up any table in O(1).  Entries that the
+/// file doesn't have are left empty.
+class OptionalHeader {
+public:
+   static constexpr uint16_t PE32_MAGIC      = 0x10b;  ///< A 32-bit image
+   static constexpr uint16_t PE32_PLUS_MAGIC = 0x20b;  ///< A 64-bit image
+
+protected:
+   size_t               file_offset_;           ///< Offset into PEFile.source_ where the optional header starts
+   size_t               size_;                  ///< SizeOfOptionalHeader from the COFF header
+   uint16_t             magic_ { 0 };           ///< PE32_MAGIC or PE32_PLUS_MAGIC
+   Optional32HeaderView pe32_;                  ///< The header if it's PE32
+   Optional64HeaderView pe64_;                  ///< The header if it's PE32+
+   size_t               number_of_data_directories_ { 0 };  ///< The entries of #data_directories_ that are in the file
+   std::array<DataDirectory, NUMBER_OF_DATA_DIRECTORIES> data_directories_ {};  ///< The data directory
+
+   /// @return `function` called with whichever view matches the magic
+   template <typename FUNCTION>
+   decltype(auto) visit( FUNCTION&& function ) const {
+      return is_pe32_plus() ? function( pe64_ ) : function( pe32_ );
+   }
+
+public:
+   /// Create an OptionalHeader at `new_file_offset` that's `new_size` bytes long
+   ///
+   /// @param new_file_offset The offset into PEFile.source_ for the optional header
+   /// @param new_size        SizeOfOptionalHeader from the COFF header
+   OptionalHeader( const size_t new_file_offset, const size_t new_size )
+         :file_offset_( new_file_offset )  // Member initialization
+         ,size_       ( new_size )         // Member initialization
+         ,pe32_       ( new_file_offset )  // Member initialization
+         ,pe64_       ( new_file_offset )  // Member initialization
+   {}
+
+   /// Read the magic, bind the matching view and decode the data directory
+   ///
+   /// @param file_source Reference to PEFile.source_
+   void parse( ByteSource& file_source ) {
+      if( !is_present() ) {
+         return;
+      }
+      if( size_ < sizeof( magic_ ) ) {
+         throw std::domain_error( "The optional header is too small" );
+      }
+      magic_ = load_le<uint16_t>( file_source.read( file_offset_, sizeof( magic_ ) ) );
+      if( magic_ != PE32_MAGIC && magic_ != PE32_PLUS_MAGIC ) {
+         throw std::domain_error( "Invalid magic in optional header" );
+      }
+
+      const size_t extent = is_pe32_plus() ? Optional64HeaderView::EXTENT : Optional32HeaderView::EXTENT;
+      if( size_ < extent ) {
+         throw std::domain_error( "The optional header is too small" );
+      }
+      if( is_pe32_plus() ) {
+         pe64_.bind( file_source, size_ );
+      } else {
+         pe32_.bind( file_source, size_ );
+      }
+
+      // Believe NumberOfRvaAndSizes only as far as SizeOfOptionalHeader goes
+      number_of_data_directories_ = std::min<size_t>( { visit( []( const auto& view ) { return view.get_number_of_rva_and_sizes(); } )
+                                                       ,NUMBER_OF_DATA_DIRECTORIES
+                                                       ,( size_ - extent ) / 8 } );
+      if( number_of_data_directories_ > 0 ) {
+         const char* entries = file_source.read( file_offset_ + extent, number_of_data_directories_ * 8 );
+         for( size_t i = 0 ; i < number_of_data_directories_ ; i++ ) {
+            data_directories_[i].virtual_address = load_le<uint32_t>( entries + i * 8 );
+            data_directories_[i].size            = load_le<uint32_t>( entries + i * 8 + 4 );
+         }
+      }
+   } // parse()
+
+   bool is_present() const {
+      return size_ != 0;  /// @return `true` if the file has an optional header (images do, objects don't)
+   }
+
+   bool is_pe32_plus() const {
+      return magic_ == PE32_PLUS_MAGIC;  /// @return `true` for a PE32+ (64-bit) image
+   }
+
+   uint16_t get_magic() const {
+      return magic_;  /// @return PE32_MAGIC or PE32_PLUS_MAGIC (or 0 if there's no optional header)
+   }
+
+   /// @return The RVA of the entry point
+   uint32_t get_entry_point() const {
+      return visit( []( const auto& view ) { return view.get_entry_point(); } );
+   }
+
+   /// @return The preferred load address
+   uint64_t get_image_base() const {
+      return visit( []( const auto& view ) { return view.get_image_base(); } );
+   }
+
+   /// @return The size of the image once it's loaded
+   uint32_t get_size_of_image() const {
+      return visit( []( const auto& view ) { return view.get_size_of_image(); } );
+   }
+
+   /// @return The combined size of the headers
+   uint32_t get_size_of_headers() const {
+      return visit( []( const auto& view ) { return view.get_size_of_headers(); } );
+   }
+
+   /// @return The Windows subsystem
+   uint16_t get_subsystem() const {
+      return visit( []( const auto& view ) { return view.get_subsystem(); } );
+   }
+
+   size_t get_number_of_data_directories() const {
+      return number_of_data_directories_;  /// @return The number of data directory entries in the file
+   }
+
+   /// @return The data directory entry at `index` (empty if the file doesn't have it)
+   const DataDirectory& get_data_directory( const DataDirectoryIndex index ) const {
+      return data_directories_[ index ];
+   }
+
+   const std::array<DataDirectory, NUMBER_OF_DATA_DIRECTORIES>& get_data_directories() const {
+      return data_directories_;  /// @return The whole data directory
+   }
+}; // OptionalHeader
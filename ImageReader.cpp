@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Read the bytes of a PE image by RVA
+///
+/// @file   ImageReader.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For min()
+#include <cstring>    // For memchr()
+#include <optional>   // For optional
+#include <stdexcept>  // For out_of_range
+
+#include "ImageReader.h"
+
+using namespace std;
+
+
+/// Most strings are short; look for the NUL in a small window first so a
+/// PagedByteSource doesn't read a new extent for every name
+#define FIRST_STRING_WINDOW 256
+
+
+const char* ImageReader::read( const uint32_t rva, const size_t length ) const {
+   const optional<FileSpan> span = sections_->rva_to_span( rva );
+   if( !span || length > span->length ) {
+      throw out_of_range( "RVA is not in the file" );
+   }
+   return source_->read( span->offset, length );
+}
+
+
+string_view ImageReader::read_string( const uint32_t rva ) const {
+   const optional<FileSpan> span = sections_->rva_to_span( rva );
+   if( !span || span->offset >= source_->size() ) {
+      throw out_of_range( "RVA is not in the file" );
+   }
+
+   const size_t limit = min( { static_cast<size_t>( span->length ), source_->size() - span->offset, MAX_STRING_LENGTH } );
+
+   for( size_t window = min<size_t>( FIRST_STRING_WINDOW, limit ) ; ; window = limit ) {
+      const char* text = source_->read( span->offset, window );
+      const void* nul  = memchr( text, '\0', window );
+      if( nul != nullptr ) {
+         return string_view( text, static_cast<size_t>( static_cast<const char*>( nul ) - text ) );
+      }
+      if( window == limit ) {
+         throw out_of_range( "Unterminated string in the image" );
+      }
+   }
+} // read_string()
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Read the bytes of a PE image by RVA
+///
+/// @file   ImageReader.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>      // For size_t
+#include <cstdint>      // For uint32_t
+#include <string_view>  // For string_view
+
+#include "ByteSource.h"
+#include "HeaderView.h"
+#include "SectionTable.h"
+
+
+/// Reads structures and strings out of a PEFile by RVA
+///
+/// Everything it returns points into the ByteSource, so nothing is copied.
+/// A reader is two references; pass it around by value or by pointer.
+class ImageReader {
+public:
+   /// The longest string that read_string() will look for a NUL in
+   static constexpr size_t MAX_STRING_LENGTH = 4096;
+
+protected:
+   ByteSource*         source_;      ///< The bytes of the PEFile
+   const SectionTable* sections_;    ///< For translating RVAs
+   bool                pe32_plus_;   ///< `true` if pointers in the image are 64 bits
+
+public:
+   /// Read from `source` through `sections`
+   ///
+   /// @param source    The bytes of the PEFile
+   /// @param sections  The section table of the PEFile
+   /// @param pe32_plus `true` if the image is PE32+
+   ImageReader( ByteSource& source, const SectionTable& sections, const bool pe32_plus )
+         :source_   ( &source )    // Member initialization
+         ,sections_ ( &sections )  // Member initialization
+         ,pe32_plus_( pe32_plus )  // Member initialization
+   {}
+
+   bool is_pe32_plus() const {
+      return pe32_plus_;  /// @return `true` if pointers in the image are 64 bits
+   }
+
+   size_t pointer_size() const {
+      return pe32_plus_ ? 8 : 4;  /// @return The size of a pointer (or a thunk) in the image
+   }
+
+   ByteSource& source() const {
+      return *source_;  /// @return The bytes of the PEFile
+   }
+
+   const SectionTable& sections() const {
+      return *sections_;  /// @return The section table of the PEFile
+   }
+
+   /// Get `length` bytes at `rva`
+   ///
+   /// @throws out_of_range if the bytes aren't all in the file
+   /// @return A pointer to the bytes
+   const char* read( uint32_t rva, size_t length ) const;
+
+   /// @return The little-endian `T` at `rva`
+   template <typename T>
+   T read_le( const uint32_t rva ) const {
+      return load_le<T>( read( rva, sizeof( T ) ) );
+   }
+
+   /// @return The pointer-sized value at `rva` (widened to 64 bits)
+   uint64_t read_pointer( uint32_t rva ) const {
+      return pe32_plus_ ? read_le<uint64_t>( rva ) : read_le<uint32_t>( rva );
+   }
+
+   /// Get the NUL-terminated string at `rva`
+   ///
+   /// The search for the NUL stops at the end of the section or after
+   /// #MAX_STRING_LENGTH bytes.
+   ///
+   /// @throws out_of_range if `rva` isn't in the file or the string isn't terminated
+   /// @return A view of the string (without the NUL)
+   std::string_view read_string( uint32_t rva ) const;
+}; // ImageReader
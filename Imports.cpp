@@ -0,0 +1,141 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Walk the import table of a PE image
+///
+/// @file   Imports.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cctype>    // For tolower()
+#include <charconv>  // For to_chars()
+
+#include "Imports.h"
+
+using namespace std;
+
+
+ImportFunctionRange::iterator::iterator( const ImageReader& image, const uint32_t lookup_rva, const uint32_t iat_rva )
+      :image_     ( &image )      // Member initialization
+      ,lookup_rva_( lookup_rva )  // Member initialization
+      ,iat_rva_   ( iat_rva )     // Member initialization
+      ,at_end_    ( false )       // Member initialization
+{
+   load();
+}
+
+
+void ImportFunctionRange::iterator::load() {
+   const uint64_t thunk = image_->read_pointer( lookup_rva_ );
+   if( thunk == 0 ) {
+      at_end_ = true;
+      return;
+   }
+
+   // The top bit of the thunk says it's an ordinal
+   const uint64_t ordinal_flag = uint64_t{ 1 } << ( image_->pointer_size() * 8 - 1 );
+
+   current_.iat_rva = iat_rva_;
+   if( thunk & ordinal_flag ) {
+      current_.by_ordinal = true;
+      current_.ordinal    = static_cast<uint16_t>( thunk );
+      current_.hint       = 0;
+      current_.name       = {};
+   } else {
+      const uint32_t hint_name_rva = static_cast<uint32_t>( thunk & 0x7FFFFFFF );
+      current_.by_ordinal = false;
+      current_.ordinal    = 0;
+      current_.hint       = image_->read_le<uint16_t>( hint_name_rva );
+      current_.name       = image_->read_string( hint_name_rva + 2 );
+   }
+} // ImportFunctionRange::iterator::load()
+
+
+ImportTable::iterator::iterator( const ImageReader& image, const uint32_t rva )
+      :image_ ( &image )  // Member initialization
+      ,rva_   ( rva )     // Member initialization
+      ,at_end_( false )   // Member initialization
+{
+   load();
+}
+
+
+void ImportTable::iterator::load() {
+   const char* descriptor = image_->read( rva_, DESCRIPTOR_SIZE );
+
+   current_.original_first_thunk = load_le<uint32_t>( descriptor + 0x00 );
+   current_.time_date_stamp      = load_le<uint32_t>( descriptor + 0x04 );
+   current_.forwarder_chain      = load_le<uint32_t>( descriptor + 0x08 );
+   current_.name_rva             = load_le<uint32_t>( descriptor + 0x0C );
+   current_.first_thunk          = load_le<uint32_t>( descriptor + 0x10 );
+
+   // The table ends with an empty descriptor (a DLL without a name or an IAT can't be loaded either)
+   if( current_.name_rva == 0 || current_.first_thunk == 0 ) {
+      at_end_ = true;
+      return;
+   }
+   current_.dll_name = image_->read_string( current_.name_rva );
+} // ImportTable::iterator::load()
+
+
+/// Hash `text` in lower case
+static void update_lower( Md5& md5, const string_view text ) {
+   char   lower[64];
+   size_t used = 0;
+   for( const char character : text ) {
+      lower[ used++ ] = static_cast<char>( tolower( static_cast<unsigned char>( character ) ) );
+      if( used == sizeof( lower ) ) {
+         md5.update( lower, used );
+         used = 0;
+      }
+   }
+   md5.update( lower, used );
+}
+
+
+Md5::Digest imphash( const ImportTable& table ) {
+   Md5    md5;
+   bool   first   = true;
+   size_t entries = 0;
+
+   for( const ImportDescriptor& dll : table ) {
+      ImportTable::count_entry( entries );
+
+      // Drop the extension if it's one that the loader would add
+      string_view library = dll.dll_name;
+      const size_t dot = library.rfind( '.' );
+      if( dot != string_view::npos ) {
+         char extension[4] {};
+         const string_view suffix = library.substr( dot + 1 );
+         if( suffix.size() == 3 ) {
+            for( size_t i = 0 ; i < 3 ; i++ ) {
+               extension[i] = static_cast<char>( tolower( static_cast<unsigned char>( suffix[i] ) ) );
+            }
+            const string_view lower_extension( extension, 3 );
+            if( lower_extension == "dll" || lower_extension == "ocx" || lower_extension == "sys" ) {
+               library = library.substr( 0, dot );
+            }
+         }
+      }
+
+      for( const ImportedFunction& function : table.functions( dll ) ) {
+         ImportTable::count_entry( entries );
+         if( !first ) {
+            md5.update( ",", 1 );
+         }
+         first = false;
+
+         update_lower( md5, library );
+         md5.update( ".", 1 );
+         if( function.by_ordinal ) {
+            char digits[8] { 'o', 'r', 'd' };
+            const to_chars_result result = to_chars( digits + 3, end( digits ), function.ordinal );
+            md5.update( digits, static_cast<size_t>( result.ptr - digits ) );
+         } else {
+            update_lower( md5, function.name );
+         }
+      }
+   }
+   return md5.finish();
+} // imphash()
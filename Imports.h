@@ -0,0 +1,248 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Walk the import table of a PE image
+///
+/// The import directory is an array of descriptors (one per DLL) that ends
+/// with an empty descriptor.  Each descriptor points at an array of thunks
+/// (one per function) that ends with a zero thunk.  Both are presented as
+/// lazy forward ranges: nothing is read until an iterator gets to it, the
+/// names are `string_view`s into the image, and nothing is allocated.  A
+/// caller that only wants the DLL names can stop whenever it likes.
+///
+/// @see https://learn.microsoft.com/en-us/windows/win32/debug/pe-format#the-idata-section
+///
+/// @file   Imports.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>      // For ptrdiff_t size_t
+#include <cstdint>      // For uint16_t uint32_t uint64_t
+#include <iterator>     // For default_sentinel_t forward_iterator_tag
+#include <stdexcept>    // For domain_error
+#include <string_view>  // For string_view
+
+#include "Hash.h"
+#include "HeaderView.h"
+#include "ImageReader.h"
+
+
+/// One function imported from a DLL
+struct ImportedFunction {
+   bool             by_ordinal { false };  ///< `true` if it's imported by ordinal (and has no name)
+   uint16_t         ordinal    { 0 };      ///< The ordinal (if #by_ordinal)
+   uint16_t         hint       { 0 };      ///< The index into the DLL's export name table to try first
+   std::string_view name;                  ///< The name of the function (unless #by_ordinal)
+   uint32_t         iat_rva    { 0 };      ///< The RVA of this function's slot in the IAT
+};
+
+
+/// The functions imported from one DLL (a forward range over its thunks)
+class ImportFunctionRange {
+protected:
+   ImageReader image_;       ///< Where to read the thunks
+   uint32_t    lookup_rva_;  ///< The first thunk to decode (the lookup table, or the IAT if there isn't one)
+   uint32_t    iat_rva_;     ///< The first slot in the IAT
+
+public:
+   /// Walks the thunks one at a time
+   class iterator {
+   protected:
+      const ImageReader* image_      { nullptr };  ///< Where to read the thunks
+      uint32_t           lookup_rva_ { 0 };        ///< The thunk that #current_ came from
+      uint32_t           iat_rva_    { 0 };        ///< The IAT slot for #current_
+      bool               at_end_     { true };     ///< Set at the zero thunk
+      ImportedFunction   current_;                 ///< The function at #lookup_rva_
+
+      /// Decode the thunk at #lookup_rva_ into #current_ (or set #at_end_)
+      void load();
+
+   public:
+      using iterator_category = std::forward_iterator_tag;  ///< A multi-pass range
+      using value_type        = ImportedFunction;           ///< What it walks over
+      using difference_type   = std::ptrdiff_t;             ///< Required by the iterator concepts
+      using pointer           = const ImportedFunction*;    ///< Required by the iterator concepts
+      using reference         = const ImportedFunction&;    ///< Required by the iterator concepts
+
+      iterator() = default;
+
+      /// Start at the thunk at `lookup_rva`
+      iterator( const ImageReader& image, uint32_t lookup_rva, uint32_t iat_rva );
+
+      reference operator*()  const { return current_; }   ///< @return The current function
+      pointer   operator->() const { return &current_; }  ///< @return The current function
+
+      /// Move to the next thunk
+      iterator& operator++() {
+         lookup_rva_ += static_cast<uint32_t>( image_->pointer_size() );
+         iat_rva_    += static_cast<uint32_t>( image_->pointer_size() );
+         load();
+         return *this;
+      }
+
+      /// Move to the next thunk
+      iterator operator++( int ) {
+         iterator before = *this;
+         ++*this;
+         return before;
+      }
+
+      /// @return `true` if both are at the end or at the same thunk
+      bool operator==( const iterator& other ) const {
+         return at_end_ == other.at_end_ && ( at_end_ || lookup_rva_ == other.lookup_rva_ );
+      }
+
+      /// @return `true` at the end of the thunks
+      bool operator==( std::default_sentinel_t ) const {
+         return at_end_;
+      }
+   }; // iterator
+
+   /// The thunks that start at `lookup_rva` (with IAT slots from `iat_rva`)
+   ImportFunctionRange( const ImageReader& image, const uint32_t lookup_rva, const uint32_t iat_rva )
+         :image_     ( image )       // Member initialization
+         ,lookup_rva_( lookup_rva )  // Member initialization
+         ,iat_rva_   ( iat_rva )     // Member initialization
+   {}
+
+   iterator begin() const {
+      return iterator( image_, lookup_rva_, iat_rva_ );  /// @return The first function
+   }
+
+   std::default_sentinel_t end() const {
+      return {};  /// @return The end of the functions
+   }
+}; // ImportFunctionRange
+
+
+/// One entry in the import directory (one DLL)
+struct ImportDescriptor {
+   uint32_t         original_first_thunk { 0 };  ///< The RVA of the import lookup table
+   uint32_t         time_date_stamp      { 0 };  ///< 0 unless the imports are bound
+   uint32_t         forwarder_chain      { 0 };  ///< The first forwarder reference
+   uint32_t         name_rva             { 0 };  ///< The RVA of the name of the DLL
+   uint32_t         first_thunk          { 0 };  ///< The RVA of the IAT
+   std::string_view dll_name;                    ///< The name of the DLL
+};
+
+
+/// The DLLs in the import directory (a forward range over its descriptors)
+class ImportTable {
+public:
+   /// The size of one import descriptor
+   static constexpr uint32_t DESCRIPTOR_SIZE = 20;
+
+   /// The most descriptors and thunks that one walk of the table visits
+   ///
+   /// Every descriptor can point at the same thunk array, so a hostile
+   /// table's walk would grow with descriptors × thunks (the square of the
+   /// file's size) without a limit on the two together.
+   static constexpr size_t MAX_ENTRIES = 262144;
+
+protected:
+   ImageReader image_;          ///< Where to read the descriptors
+   uint32_t    directory_rva_;  ///< The first descriptor (0 if there are no imports)
+
+public:
+   /// Walks the descriptors one at a time
+   class iterator {
+   protected:
+      const ImageReader* image_   { nullptr };  ///< Where to read the descriptors
+      uint32_t           rva_     { 0 };        ///< The descriptor that #current_ came from
+      bool               at_end_  { true };     ///< Set at the empty descriptor
+      ImportDescriptor   current_;              ///< The descriptor at #rva_
+
+      /// Decode the descriptor at #rva_ into #current_ (or set #at_end_)
+      void load();
+
+   public:
+      using iterator_category = std::forward_iterator_tag;  ///< A multi-pass range
+      using value_type        = ImportDescriptor;           ///< What it walks over
+      using difference_type   = std::ptrdiff_t;             ///< Required by the iterator concepts
+      using pointer           = const ImportDescriptor*;    ///< Required by the iterator concepts
+      using reference         = const ImportDescriptor&;    ///< Required by the iterator concepts
+
+      iterator() = default;
+
+      /// Start at the descriptor at `rva`
+      iterator( const ImageReader& image, uint32_t rva );
+
+      reference operator*()  const { return current_; }   ///< @return The current descriptor
+      pointer   operator->() const { return &current_; }  ///< @return The current descriptor
+
+      /// Move to the next descriptor
+      iterator& operator++() {
+         rva_ += DESCRIPTOR_SIZE;
+         load();
+         return *this;
+      }
+
+      /// Move to the next descriptor
+      iterator operator++( int ) {
+         iterator before = *this;
+         ++*this;
+         return before;
+      }
+
+      /// @return `true` if both are at the end or at the same descriptor
+      bool operator==( const iterator& other ) const {
+         return at_end_ == other.at_end_ && ( at_end_ || rva_ == other.rva_ );
+      }
+
+      /// @return `true` at the end of the descriptors
+      bool operator==( std::default_sentinel_t ) const {
+         return at_end_;
+      }
+   }; // iterator
+
+   /// The import directory described by `directory`
+   ///
+   /// @param image     Where to read the image
+   /// @param directory The Import Table entry from the data directory
+   ImportTable( const ImageReader& image, const DataDirectory& directory )
+         :image_        ( image )                                               // Member initialization
+         ,directory_rva_( directory.size == 0 ? 0 : directory.virtual_address )  // Member initialization
+   {}
+
+   bool empty() const {
+      return directory_rva_ == 0;  /// @return `true` if the image has no import directory
+   }
+
+   iterator begin() const {
+      return empty() ? iterator() : iterator( image_, directory_rva_ );  /// @return The first DLL
+   }
+
+   std::default_sentinel_t end() const {
+      return {};  /// @return The end of the DLLs
+   }
+
+   /// Count one more descriptor or thunk of a walk
+   ///
+   /// @param entries The descriptors and thunks visited so far
+   /// @throws domain_error if the walk has visited more than #MAX_ENTRIES
+   static void count_entry( size_t& entries ) {
+      if( ++entries > MAX_ENTRIES ) {
+         throw std::domain_error( "The import table is too large" );
+      }
+   }
+
+   /// @return The functions imported from the DLL in `descriptor`
+   ImportFunctionRange functions( const ImportDescriptor& descriptor ) const {
+      const uint32_t lookup = descriptor.original_first_thunk != 0 ? descriptor.original_first_thunk : descriptor.first_thunk;
+      return ImportFunctionRange( image_, lookup, descriptor.first_thunk );
+   }
+}; // ImportTable
+
+
+/// Compute the imphash of `table`
+///
+/// This is the MD5 of `dll.function` for every import (lower case, with a
+/// `.dll`, `.ocx` or `.sys` extension dropped), joined with commas.  It's
+/// hashed as the table is walked, so the string is never built.  Imports
+/// by ordinal are named `ordN`.
+///
+/// @throws domain_error if the walk visits more than ImportTable::MAX_ENTRIES descriptors and thunks
+/// @return The digest
+extern Md5::Digest imphash( const ImportTable& table );
@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// A minimal io_uring, set up with raw system calls (Linux)
+///
+/// @file   IoRing.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For max()
+#include <atomic>     // For atomic_ref
+#include <cerrno>     // For errno
+#include <cstring>    // For memset()
+#include <stdexcept>  // For runtime_error
+
+#include <linux/io_uring.h>  // For io_uring_params io_uring_sqe io_uring_cqe
+#include <sys/mman.h>        // For mmap() munmap()
+#include <sys/syscall.h>     // For __NR_io_uring_setup __NR_io_uring_enter
+#include <unistd.h>          // For syscall() close()
+
+#include "IoRing.h"
+
+using namespace std;
+
+
+/// @return The `unsigned` at `offset` bytes into `ring`
+static unsigned* at( void* ring, const unsigned offset ) {
+   return reinterpret_cast<unsigned*>( static_cast<char*>( ring ) + offset );
+}
+
+
+/// @return A mapping of `size` bytes of the ring `fd` at `offset`
+static void* map_ring( const int fd, const size_t size, const off_t offset ) {
+   void* mapping = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset );
+   if( mapping == MAP_FAILED ) {
+      throw runtime_error( "Unable to map the io_uring" );
+   }
+   return mapping;
+}
+
+
+IoRing::IoRing( const unsigned entries ) {
+   io_uring_params params;
+   memset( &params, 0, sizeof( params ) );
+   fd_ = static_cast<int>( syscall( __NR_io_uring_setup, entries, &params ) );
+   if( fd_ < 0 ) {
+      throw runtime_error( "io_uring isn't available" );
+   }
+
+   try {
+      capacity_     = params.sq_entries;
+      sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+      cq_ring_size_ = params.cq_off.cqes  + params.cq_entries * sizeof( io_uring_cqe );
+      if( params.features & IORING_FEAT_SINGLE_MMAP ) {
+         sq_ring_size_ = max( sq_ring_size_, cq_ring_size_ );
+      }
+
+      sq_ring_ = map_ring( fd_, sq_ring_size_, IORING_OFF_SQ_RING );
+      if( params.features & IORING_FEAT_SINGLE_MMAP ) {
+         cq_ring_ = sq_ring_;
+      } else {
+         cq_ring_ = map_ring( fd_, cq_ring_size_, IORING_OFF_CQ_RING );
+      }
+      sqes_size_ = params.sq_entries * sizeof( io_uring_sqe );
+      sqes_      = static_cast<io_uring_sqe*>( map_ring( fd_, sqes_size_, IORING_OFF_SQES ) );
+   } catch( ... ) {
+      release();
+      throw;
+   }
+
+   sq_tail_  = at( sq_ring_, params.sq_off.tail );
+   sq_array_ = at( sq_ring_, params.sq_off.array );
+   sq_mask_  = *at( sq_ring_, params.sq_off.ring_mask );
+   cq_head_  = at( cq_ring_, params.cq_off.head );
+   cq_tail_  = at( cq_ring_, params.cq_off.tail );
+   cq_mask_  = *at( cq_ring_, params.cq_off.ring_mask );
+   cqes_     = reinterpret_cast<io_uring_cqe*>( static_cast<char*>( cq_ring_ ) + params.cq_off.cqes );
+} // IoRing()
+
+
+IoRing::~IoRing() {
+   release();
+}
+
+
+void IoRing::release() {
+   if( sqes_ != nullptr ) {
+      munmap( sqes_, sqes_size_ );
+   }
+   if( cq_ring_ != nullptr && cq_ring_ != sq_ring_ ) {
+      munmap( cq_ring_, cq_ring_size_ );
+   }
+   if( sq_ring_ != nullptr ) {
+      munmap( sq_ring_, sq_ring_size_ );
+   }
+   close( fd_ );
+}
+
+
+void IoRing::read( const int fd, void* buffer, const unsigned length, const uint64_t offset, const uint64_t tag ) {
+   const unsigned tail  = *sq_tail_;  // Only this thread writes the tail
+   const unsigned index = tail & sq_mask_;
+
+   io_uring_sqe& sqe = sqes_[index];
+   memset( &sqe, 0, sizeof( sqe ) );
+   sqe.opcode    = IORING_OP_READ;
+   sqe.fd        = fd;
+   sqe.addr      = reinterpret_cast<uint64_t>( buffer );
+   sqe.len       = length;
+   sqe.off       = offset;
+   sqe.user_data = tag;
+
+   sq_array_[index] = index;
+   atomic_ref<unsigned>( *sq_tail_ ).store( tail + 1, memory_order_release );  // The kernel sees the entry before the tail
+   to_submit_++;
+}
+
+
+void IoRing::submit( const unsigned wait_for ) {
+   const unsigned flags = wait_for > 0 ? IORING_ENTER_GETEVENTS : 0;
+   for( ;; ) {
+      const long submitted = syscall( __NR_io_uring_enter, fd_, to_submit_, wait_for, flags, nullptr, 0 );
+      if( submitted >= 0 ) {
+         to_submit_ -= static_cast<unsigned>( submitted );
+         return;
+      }
+      if( errno != EINTR ) {
+         throw runtime_error( "Unable to submit to the io_uring" );
+      }
+   }
+}
+
+
+bool IoRing::complete( uint64_t& tag, int& result ) {
+   const unsigned head = *cq_head_;  // Only this thread writes the head
+   if( head == atomic_ref<unsigned>( *cq_tail_ ).load( memory_order_acquire ) ) {
+      return false;
+   }
+
+   const io_uring_cqe& cqe = cqes_[ head & cq_mask_ ];
+   tag    = cqe.user_data;
+   result = cqe.res;
+   atomic_ref<unsigned>( *cq_head_ ).store( head + 1, memory_order_release );  // The kernel can reuse the entry
+   return true;
+}
@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// A minimal io_uring, set up with raw system calls (Linux)
+///
+/// Just enough of io_uring to keep a lot of reads in flight from one
+/// thread: queue reads, submit them with one `io_uring_enter()` and reap
+/// their completions.  It doesn't need liburing.
+///
+/// @file   IoRing.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>  // For size_t
+#include <cstdint>  // For uint64_t
+
+struct io_uring_sqe;  // From <linux/io_uring.h>
+struct io_uring_cqe;  // From <linux/io_uring.h>
+
+
+/// A submission and completion queue shared with the kernel
+///
+/// An IoRing is used by one thread at a time.  The caller keeps no more
+/// than capacity() reads in flight.
+class IoRing {
+protected:
+   int           fd_           { -1 };       ///< The ring
+   unsigned      capacity_     { 0 };        ///< The number of submission queue entries
+   void*         sq_ring_      { nullptr };  ///< The mapped submission queue ring
+   size_t        sq_ring_size_ { 0 };        ///< The size of #sq_ring_
+   void*         cq_ring_      { nullptr };  ///< The mapped completion queue ring (may be #sq_ring_)
+   size_t        cq_ring_size_ { 0 };        ///< The size of #cq_ring_
+   io_uring_sqe* sqes_         { nullptr };  ///< The mapped submission queue entries
+   size_t        sqes_size_    { 0 };        ///< The size of #sqes_
+   unsigned*     sq_tail_      { nullptr };  ///< Where the next entry goes (written by us)
+   unsigned*     sq_array_     { nullptr };  ///< The indexes of the entries to submit
+   unsigned      sq_mask_      { 0 };        ///< Wraps an index into the submission queue
+   unsigned*     cq_head_      { nullptr };  ///< The next completion to reap (written by us)
+   unsigned*     cq_tail_      { nullptr };  ///< After the last completion (written by the kernel)
+   unsigned      cq_mask_      { 0 };        ///< Wraps an index into the completion queue
+   io_uring_cqe* cqes_         { nullptr };  ///< The completion queue entries
+   unsigned      to_submit_    { 0 };        ///< Entries that have been queued but not submitted
+
+   /// Unmap the rings and close the ring
+   void release();
+
+public:
+   /// Set up a ring with room for `entries` reads
+   ///
+   /// @throws runtime_error if the kernel doesn't support io_uring (or won't let us use it)
+   explicit IoRing( unsigned entries );
+
+   ~IoRing();
+
+   IoRing( const IoRing& ) = delete;             ///< A ring owns OS resources
+   IoRing& operator=( const IoRing& ) = delete;  ///< A ring owns OS resources
+
+   unsigned capacity() const {
+      return capacity_;  /// @return The most reads that can be in flight
+   }
+
+   /// Queue a read of `length` bytes at `offset` in `fd` into `buffer`
+   ///
+   /// `buffer` must stay valid until the read completes.  `tag` comes back
+   /// with its completion.
+   void read( int fd, void* buffer, unsigned length, uint64_t offset, uint64_t tag );
+
+   /// Submit the queued reads and wait until at least `wait_for` reads have completed
+   ///
+   /// @throws runtime_error if `io_uring_enter()` fails
+   void submit( unsigned wait_for = 0 );
+
+   /// Reap one completion (without waiting for it)
+   ///
+   /// @param tag    Set to the tag of the read
+   /// @param result Set to the number of bytes read or `-errno`
+   /// @return `false` if nothing has completed
+   bool complete( uint64_t& tag, int& result );
+}; // IoRing
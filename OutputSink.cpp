@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// A buffer that holds a whole report until it's written
+///
+/// @file   OutputSink.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cerrno>     // For errno EINTR
+#include <stdexcept>  // For runtime_error
+#include <vector>     // For vector
+
+#include <sys/uio.h>  // For writev() iovec
+#include <unistd.h>   // For write()
+
+#include "OutputSink.h"
+
+using namespace std;
+
+
+void OutputSink::flush_to( const int fd ) {
+   OutputSink* const self[] { this };
+   flush_to( fd, self, 1 );
+}
+
+
+void OutputSink::flush_to( const int fd, OutputSink* const sinks[], const size_t count ) {
+   vector<iovec> pieces;
+   pieces.reserve( count );
+   for( size_t i = 0 ; i < count ; i++ ) {
+      if( !sinks[i]->empty() ) {
+         pieces.push_back( { const_cast<char*>( sinks[i]->data() ), sinks[i]->size() } );
+      }
+   }
+
+   size_t next { 0 };  // The first piece that still has bytes to write
+   while( next < pieces.size() ) {
+      const ssize_t written = writev( fd, &pieces[next], static_cast<int>( pieces.size() - next ) );
+      if( written < 0 ) {
+         if( errno == EINTR ) {
+            continue;
+         }
+         throw runtime_error( "Unable to write output" );
+      }
+
+      // Skip over what the kernel took
+      size_t remaining = static_cast<size_t>( written );
+      while( next < pieces.size() && remaining >= pieces[next].iov_len ) {
+         remaining -= pieces[next].iov_len;
+         next++;
+      }
+      if( next < pieces.size() ) {
+         pieces[next].iov_base = static_cast<char*>( pieces[next].iov_base ) + remaining;
+         pieces[next].iov_len -= remaining;
+      }
+   }
+
+   for( size_t i = 0 ; i < count ; i++ ) {
+      sinks[i]->clear();
+   }
+} // flush_to()
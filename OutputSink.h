@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// A buffer that holds a whole report until it's written
+///
+/// @file   OutputSink.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>      // For size_t
+#include <string>       // For string
+#include <string_view>  // For string_view
+
+
+/// Collects a report in memory and writes it out with as few `write()`
+/// calls as possible
+///
+/// All of the print() methods write to an OutputSink rather than a stream.
+/// A sink keeps its capacity when it's cleared, so a sink that's reused
+/// from file to file stops allocating once it has grown to fit a report.
+class OutputSink {
+protected:
+   std::string buffer_;  ///< The report so far
+
+public:
+   /// The buffer itself, for the functions in Format.h to append to
+   /// @return A reference to #buffer_
+   std::string& buffer() {
+      return buffer_;
+   }
+
+   /// Append `text` to the report
+   void append( const std::string_view text ) {
+      buffer_.append( text );
+   }
+
+   /// Append one character to the report
+   void put( const char character ) {
+      buffer_.push_back( character );
+   }
+
+   const char* data() const {
+      return buffer_.data();  /// @return The report so far
+   }
+
+   size_t size() const {
+      return buffer_.size();  /// @return The number of bytes in the report
+   }
+
+   bool empty() const {
+      return buffer_.empty();  /// @return `true` if nothing has been written
+   }
+
+   /// Throw away the report but keep the memory
+   void clear() {
+      buffer_.clear();
+   }
+
+   /// Write the report to `fd` and clear it
+   ///
+   /// @throws runtime_error if the write fails
+   void flush_to( int fd );
+
+   /// Write `count` sinks to `fd` with one `writev()` (more only if the
+   /// kernel takes less than all of it) and clear them
+   ///
+   /// @throws runtime_error if the write fails
+   static void flush_to( int fd, OutputSink* const sinks[], size_t count );
+}; // OutputSink
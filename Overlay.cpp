@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Find the data appended after the last section and scan it for payloads
+///
+/// @file   Overlay.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For min() max()
+#include <cstring>    // For memcmp()
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+   #include <immintrin.h>  // For the AVX2 intrinsics
+   #define HAVE_X86_KERNELS
+#endif
+
+#if defined( __ARM_NEON ) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   #include <arm_neon.h>   // For the NEON intrinsics
+   #define HAVE_NEON_KERNELS
+#endif
+
+#include "Overlay.h"
+
+using namespace std;
+
+
+/// The number of bytes of the overlay that are read and scanned at a time
+#define WINDOW_SIZE ( 1024 * 1024 )
+
+
+/// The distinct pairs of bytes that the signatures start with
+struct Prefixes {
+   size_t        count { 0 };                               ///< The number of pairs
+   unsigned char first [ NUMBER_OF_OVERLAY_SIGNATURES ] {};  ///< The first byte of each pair
+   unsigned char second[ NUMBER_OF_OVERLAY_SIGNATURES ] {};  ///< The second byte of each pair
+};
+
+
+/// @return The distinct pairs of bytes that #OVERLAY_SIGNATURES start with
+static constexpr Prefixes make_prefixes() {
+   Prefixes prefixes;
+   for( const OverlaySignature& signature : OVERLAY_SIGNATURES ) {
+      const unsigned char first  = static_cast<unsigned char>( signature.magic[0] );
+      const unsigned char second = static_cast<unsigned char>( signature.magic[1] );
+      bool is_new = true;
+      for( size_t i = 0 ; i < prefixes.count ; i++ ) {
+         is_new = is_new && ( prefixes.first[i] != first || prefixes.second[i] != second );
+      }
+      if( is_new ) {
+         prefixes.first [ prefixes.count ] = first;
+         prefixes.second[ prefixes.count ] = second;
+         prefixes.count++;
+      }
+   }
+   return prefixes;
+}
+
+/// The pairs that the kernels look for
+static constexpr Prefixes PREFIXES = make_prefixes();
+
+
+/// @return The length of the longest of #OVERLAY_SIGNATURES
+static constexpr size_t longest_signature() {
+   size_t longest = 0;
+   for( const OverlaySignature& signature : OVERLAY_SIGNATURES ) {
+      longest = max( longest, signature.magic.size() );
+   }
+   return longest;
+}
+
+/// The bytes that one window overlaps the next by (so a match can straddle them)
+static constexpr size_t WINDOW_OVERLAP = longest_signature() - 1;
+
+
+/// A kernel adds the matches that start in the first `starts` of `length` bytes to `matches`
+using Kernel = void (*)( const char* bytes, size_t length, size_t starts, uint64_t offset, OverlayMatches& matches );
+
+
+/// Add each signature that starts at `bytes[ position ]` to `matches`
+static void check_at( const char* bytes, const size_t length, const size_t position, const uint64_t offset, OverlayMatches& matches ) {
+   for( size_t i = 0 ; i < NUMBER_OF_OVERLAY_SIGNATURES ; i++ ) {
+      const string_view magic = OVERLAY_SIGNATURES[i].magic;
+      if( magic.size() > length - position || memcmp( bytes + position, magic.data(), magic.size() ) != 0 ) {
+         continue;
+      }
+      if( matches[i].count++ == 0 ) {
+         matches[i].first = offset + position;
+      }
+   }
+}
+
+
+/// The portable kernel: one position at a time
+static void scan_scalar( const char* bytes, const size_t length, const size_t starts, const uint64_t offset, OverlayMatches& matches ) {
+   for( size_t position = 0 ; position < starts && position + 1 < length ; position++ ) {
+      const unsigned char first  = static_cast<unsigned char>( bytes[ position ] );
+      const unsigned char second = static_cast<unsigned char>( bytes[ position + 1 ] );
+      for( size_t i = 0 ; i < PREFIXES.count ; i++ ) {
+         if( PREFIXES.first[i] == first && PREFIXES.second[i] == second ) {
+            check_at( bytes, length, position, offset, matches );
+            break;
+         }
+      }
+   }
+}
+
+
+#if defined( HAVE_X86_KERNELS )
+/// The AVX2 kernel: 32 positions per pair of 256-bit loads
+__attribute__(( target( "avx2" ) ))
+static void scan_avx2( const char* bytes, const size_t length, const size_t starts, const uint64_t offset, OverlayMatches& matches ) {
+   __m256i firsts [ NUMBER_OF_OVERLAY_SIGNATURES ];
+   __m256i seconds[ NUMBER_OF_OVERLAY_SIGNATURES ];
+   for( size_t p = 0 ; p < PREFIXES.count ; p++ ) {
+      firsts [p] = _mm256_set1_epi8( static_cast<char>( PREFIXES.first [p] ) );
+      seconds[p] = _mm256_set1_epi8( static_cast<char>( PREFIXES.second[p] ) );
+   }
+
+   size_t i = 0;
+   for( ; i < starts && i + 33 <= length ; i += 32 ) {
+      const __m256i here = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( bytes + i ) );
+      const __m256i next = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( bytes + i + 1 ) );
+      __m256i hits = _mm256_setzero_si256();
+      for( size_t p = 0 ; p < PREFIXES.count ; p++ ) {
+         hits = _mm256_or_si256( hits, _mm256_and_si256( _mm256_cmpeq_epi8( here, firsts[p] ), _mm256_cmpeq_epi8( next, seconds[p] ) ) );
+      }
+      uint32_t mask = static_cast<uint32_t>( _mm256_movemask_epi8( hits ) );
+      if( starts - i < 32 ) {
+         mask &= ( 1u << ( starts - i ) ) - 1;
+      }
+      for( ; mask != 0 ; mask &= mask - 1 ) {
+         check_at( bytes, length, i + static_cast<size_t>( __builtin_ctz( mask ) ), offset, matches );
+      }
+   }
+   if( i < starts ) {
+      scan_scalar( bytes + i, length - i, starts - i, offset + i, matches );
+   }
+}
+#endif
+
+
+#if defined( HAVE_NEON_KERNELS )
+/// The NEON kernel: 16 positions per pair of 128-bit loads
+static void scan_neon( const char* bytes, const size_t length, const size_t starts, const uint64_t offset, OverlayMatches& matches ) {
+   size_t i = 0;
+   for( ; i < starts && i + 17 <= length ; i += 16 ) {
+      const uint8x16_t here = vld1q_u8( reinterpret_cast<const uint8_t*>( bytes + i ) );
+      const uint8x16_t next = vld1q_u8( reinterpret_cast<const uint8_t*>( bytes + i + 1 ) );
+      uint8x16_t hits = vdupq_n_u8( 0 );
+      for( size_t p = 0 ; p < PREFIXES.count ; p++ ) {
+         hits = vorrq_u8( hits, vandq_u8( vceqq_u8( here, vdupq_n_u8( PREFIXES.first[p] ) ), vceqq_u8( next, vdupq_n_u8( PREFIXES.second[p] ) ) ) );
+      }
+      // Narrow each byte to a nibble, so the mask is 4 bits per position
+      uint64_t mask = vget_lane_u64( vreinterpret_u64_u8( vshrn_n_u16( vreinterpretq_u16_u8( hits ), 4 ) ), 0 );
+      if( starts - i < 16 ) {
+         mask &= ( uint64_t{ 1 } << ( ( starts - i ) * 4 ) ) - 1;
+      }
+      while( mask != 0 ) {
+         const size_t nibble = static_cast<size_t>( __builtin_ctzll( mask ) ) / 4;
+         check_at( bytes, length, i + nibble, offset, matches );
+         mask &= ~( uint64_t{ 0xF } << ( nibble * 4 ) );
+      }
+   }
+   if( i < starts ) {
+      scan_scalar( bytes + i, length - i, starts - i, offset + i, matches );
+   }
+}
+#endif
+
+
+/// The kernel for this CPU and its name
+struct KernelChoice {
+   Kernel      kernel;  ///< The function
+   const char* name;    ///< What to call it
+};
+
+
+/// @return The widest kernel that this CPU can run
+static KernelChoice select_kernel() {
+#if defined( HAVE_X86_KERNELS )
+   __builtin_cpu_init();
+   if( __builtin_cpu_supports( "avx2" ) ) {
+      return { scan_avx2, "avx2" };
+   }
+#endif
+#if defined( HAVE_NEON_KERNELS )
+   return { scan_neon, "neon" };
+#endif
+   return { scan_scalar, "scalar" };
+}
+
+
+/// @return The kernel (chosen once, the first time it's asked for)
+static const KernelChoice& kernel_choice() {
+   static const KernelChoice choice = select_kernel();
+   return choice;
+}
+
+
+const char* overlay_kernel_name() {
+   return kernel_choice().name;
+}
+
+
+void scan_overlay( const char* bytes, const size_t length, const size_t starts, const uint64_t offset, OverlayMatches& matches ) {
+   kernel_choice().kernel( bytes, length, min( starts, length ), offset, matches );
+}
+
+
+OverlayMatches find_overlay_signatures( ByteSource& source, const OverlayInfo& overlay ) {
+   OverlayMatches matches {};
+   const size_t   end = source.size();
+   for( size_t position = overlay.offset ; position < end ; position += WINDOW_SIZE ) {
+      const size_t length = min<size_t>( WINDOW_SIZE + WINDOW_OVERLAP, end - position );
+      scan_overlay( source.read( position, length ), length, WINDOW_SIZE, position, matches );
+   }
+   return matches;
+}
@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Find the data appended after the last section and scan it for payloads
+///
+/// The loader maps the headers and each section's raw data, and nothing
+/// else.  Whatever follows the end of the last section's raw data (the
+/// largest `05_section_raw_offset` + `04_section_raw_size`) is an overlay:
+/// an Authenticode signature, or the archive that an installer unpacks.
+/// Finding it only needs the section table.
+///
+/// The overlay is then scanned for the signatures of the usual payloads in
+/// one pass, a window at a time.  The kernels compare a whole vector of
+/// positions against the first two bytes of every signature at once (each
+/// position against the first byte, the next one against the second) and
+/// only check a whole signature where a pair matches, which is rare.
+///
+/// @file   Overlay.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <array>        // For array
+#include <cstddef>      // For size_t
+#include <cstdint>      // For uint32_t uint64_t
+#include <string_view>  // For string_view
+
+#include "ByteSource.h"
+
+
+/// A payload that can be found in an overlay
+struct OverlaySignature {
+   const char*      name;   ///< What to call it in the report
+   std::string_view magic;  ///< The bytes that it starts with (at least 2)
+};
+
+
+/// The signatures that scan_overlay() looks for
+inline constexpr OverlaySignature OVERLAY_SIGNATURES[] = {
+    { "nsis",         std::string_view { "\xEF\xBE\xAD\xDE" "NullsoftInst", 16 } }  // The NSIS first header
+   ,{ "inno_setup",   std::string_view { "Inno Setup Setup Data", 21 } }             // The Inno Setup setup-0 data
+   ,{ "inno_loader",  std::string_view { "rDlPtS\xCD\xE6\xD7\x7B\x0B\x2A", 12 } }   // The Inno Setup loader's offset table
+   ,{ "zip",          std::string_view { "PK\x03\x04", 4 } }                         // A zip local file header
+   ,{ "zip_end",      std::string_view { "PK\x05\x06", 4 } }                         // A zip end of central directory
+   ,{ "7z",           std::string_view { "7z\xBC\xAF\x27\x1C", 6 } }
+   ,{ "rar",          std::string_view { "Rar!\x1A\x07", 6 } }
+   ,{ "cab",          std::string_view { "MSCF\0\0\0\0", 8 } }
+};
+
+/// The number of #OVERLAY_SIGNATURES
+inline constexpr size_t NUMBER_OF_OVERLAY_SIGNATURES = sizeof( OVERLAY_SIGNATURES ) / sizeof( OVERLAY_SIGNATURES[0] );
+
+
+/// Where one signature was found
+struct OverlayMatch {
+   uint64_t first { 0 };  ///< The file offset of the first match
+   uint64_t count { 0 };  ///< The number of matches
+};
+
+/// The matches for each of #OVERLAY_SIGNATURES
+using OverlayMatches = std::array<OverlayMatch, NUMBER_OF_OVERLAY_SIGNATURES>;
+
+
+/// The overlay of a PEFile
+struct OverlayInfo {
+   uint64_t offset           { 0 };  ///< Where the overlay starts (the end of the last section's raw data)
+   uint64_t size             { 0 };  ///< The number of bytes from #offset to the end of the file
+   uint32_t certificate_size { 0 };  ///< The bytes of the overlay that are the Certificate Table (the Authenticode signature)
+};
+
+
+/// Scan `length` bytes at `bytes` for each of #OVERLAY_SIGNATURES
+///
+/// Only matches that start in the first `starts` bytes are counted, so a
+/// caller that scans a window at a time can overlap the windows by the
+/// length of the longest signature.  A match has to fit in `length`.
+///
+/// @param bytes   The bytes to scan
+/// @param length  How many bytes there are
+/// @param starts  How many of them a match can start in
+/// @param offset  The file offset of `bytes` (for OverlayMatch::first)
+/// @param matches Where to add the matches
+extern void scan_overlay( const char* bytes, size_t length, size_t starts, uint64_t offset, OverlayMatches& matches );
+
+/// Scan `overlay` in `source` for each of #OVERLAY_SIGNATURES, a window at a time
+///
+/// @throws out_of_range if the overlay can't be read
+/// @return Where each signature was found
+extern OverlayMatches find_overlay_signatures( ByteSource& source, const OverlayInfo& overlay );
+
+/// @return The name of the kernel that scan_overlay() uses on this CPU
+extern const char* overlay_kernel_name();
@@ -0,0 +1,474 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// A Windows Portable Executable file and the report that readpe prints for it
+///
+/// @file   PEFile.cpp
+/// @author Thanh Ly thanhly@hawaii.edu>
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For min() max()
+#include <cstdlib>    // For strtoul()
+#include <exception>  // For exception_ptr rethrow_exception()
+#include <optional>   // For optional
+#include <utility>    // For move()
+
+#include "Arena.h"
+#include "Entropy.h"
+#include "DebugDirectory.h"
+#include "Imports.h"
+#include "Overlay.h"
+#include "Relocations.h"
+#include "Resources.h"
+#include "PEFile.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+
+/// Look up this many exports or more in one file and it's worth building an ExportHashIndex
+#define EXPORT_HASH_THRESHOLD 16
+
+
+PEFile::RawData PEFile::raw_data( const SectionHeaderView& section ) const {
+   const size_t raw_offset = section.get<SECTION_RAW_OFFSET>();
+   const size_t raw_size   = raw_offset < source_->size() ? min<size_t>( section.get<SECTION_RAW_SIZE>(), source_->size() - raw_offset ) : 0;
+   if( raw_size == 0 ) {
+      return {};
+   }
+   return { reinterpret_cast<const unsigned char*>( source_->read( raw_offset, raw_size ) ), raw_size };
+}
+
+
+void PEFile::analyze_section( const SectionHeaderView& section, SectionAnalysis& analysis ) const {
+   STATS_SCOPE( ANALYZE );
+   const RawData data = raw_data( section );
+   if( options_.entropy ) {
+      analysis.stage = Stage::ENTROPY;
+      ByteHistogram histogram {};
+      count_bytes( data.bytes, data.length, histogram );
+      analysis.entropy       = shannon_entropy( histogram );
+      analysis.entropy_bytes = data.length;
+   }
+   if( options_.hash_sections ) {
+      analysis.stage = Stage::HASHES;
+      Sha256 sha256;
+      sha256.update( data.bytes, data.length );
+      analysis.digest = sha256.finish();
+   }
+}
+
+
+void PEFile::print_section_analysis( ReportWriter& out, const SectionAnalysis& analysis ) const {
+   STATS_SCOPE( FORMAT );
+   if( options_.entropy ) {
+      out.entropy( analysis.entropy, analysis.entropy_bytes );
+   }
+   if( options_.hash_sections ) {
+      out.digest( "sha256", "    SHA-256", analysis.digest.data(), analysis.digest.size() );
+   }
+}
+
+
+void PEFile::print_imports( ReportWriter& out, const ImageReader& image, const DataDirectory& imports ) const {
+   STATS_SCOPE( IMPORTS );
+   out.begin_group( Group::IMPORTS );
+
+   const ImportTable table { image, imports };
+   size_t            entries = 0;
+   for( const ImportDescriptor& dll : table ) {
+      ImportTable::count_entry( entries );
+      out.begin_import( dll.dll_name );
+      for( const ImportedFunction& function : table.functions( dll ) ) {
+         ImportTable::count_entry( entries );
+         out.imported_function( function );
+      }
+      out.end_import();
+   }
+   out.end_group( Group::IMPORTS );
+} // print_imports()
+
+
+void PEFile::print_exports( ReportWriter& out, const ExportTable& table ) const {
+   out.begin_group( Group::EXPORTS );
+   if( !table.empty() ) {
+      out.fields( table.header(), options_.fields.mask<ExportDirectoryView>() );
+      out.text( "dll_name", "DLL name", table.dll_name() );
+
+      out.begin_group( Group::NAMED_EXPORTS );
+      for( uint32_t i = 0 ; i < table.get_number_of_names() ; i++ ) {
+         out.named_export( table.name_at( i ), table.named_export_at( i ) );
+      }
+      out.end_group( Group::NAMED_EXPORTS );
+   }
+   out.end_group( Group::EXPORTS );
+} // print_exports()
+
+
+void PEFile::print_export_lookups( ReportWriter& out, const ExportTable& table ) const {
+   out.begin_group( Group::EXPORT_LOOKUP );
+
+   // Repeated lookups by name are cheaper through a hash index
+   optional<ExportHashIndex> index;
+   if( options_.export_queries.size() >= EXPORT_HASH_THRESHOLD ) {
+      index.emplace( table, arena_ );
+   }
+
+   for( const string& query : options_.export_queries ) {
+      optional<ExportedFunction> function;
+      if( query.size() > 1 && query[0] == '#' ) {
+         char* end;
+         const unsigned long ordinal = strtoul( query.c_str() + 1, &end, 10 );
+         if( *end == '\0' && ordinal <= UINT32_MAX ) {
+            function = table.find( static_cast<uint32_t>( ordinal ) );
+         }
+      } else {
+         function = index ? index->find( query ) : table.find( string_view( query ) );
+      }
+
+      out.export_lookup( query, function );
+   }
+   out.end_group( Group::EXPORT_LOOKUP );
+} // print_export_lookups()
+
+
+void PEFile::print_resources( ReportWriter& out, const ImageReader& image, const DataDirectory& resources ) const {
+   STATS_SCOPE( RESOURCES );
+   out.begin_group( Group::RESOURCES );
+
+   const ResourceTable table { image, resources };
+   if( !table.empty() ) {
+      const auto print_leaf = [&out]( const ResourceEntry& type, const ResourceEntry& name, const ResourceEntry& language, const ResourceData& data ) {
+         out.resource( type, name, language, data );
+      };
+      const ResourceDirectory types = table.root();
+      size_t entries = 0;
+      if( options_.resource_types.empty() ) {
+         for( size_t i = 0 ; i < types.size() ; i++ ) {
+            table.for_each_leaf( types.entry( i ), print_leaf, entries );
+         }
+      } else {
+         // Only the paths to the types that were asked for are read
+         for( const uint32_t type_id : options_.resource_types ) {
+            const optional<ResourceEntry> type = types.find( type_id );
+            if( type ) {
+               table.for_each_leaf( *type, print_leaf, entries );
+            }
+         }
+      }
+   }
+   out.end_group( Group::RESOURCES );
+} // print_resources()
+
+
+void PEFile::print_relocations( ReportWriter& out, const ImageReader& image, const DataDirectory& relocations ) const {
+   STATS_SCOPE( RELOCATIONS );
+   out.begin_group( Group::RELOCATIONS );
+
+   RelocationSummary summary;
+   out.begin_group( Group::RELOCATION_PAGES );
+   RelocationTable { image, relocations }.for_each_block( [&out, &summary]( const RelocationBlock& block ) {
+      RelocationCounts page {};
+      count_relocation_types( block.entries, block.number_of_entries, page );
+      out.relocation_page( block.page_rva, block.number_of_entries - page[ IMAGE_REL_BASED_ABSOLUTE ] );
+
+      summary.blocks++;
+      for( size_t type = 0 ; type < RELOCATION_TYPES ; type++ ) {
+         summary.types[ type ] += page[ type ];
+      }
+   } );
+   out.end_group( Group::RELOCATION_PAGES );
+
+   out.relocation_summary( summary );
+   out.end_group( Group::RELOCATIONS );
+} // print_relocations()
+
+
+void PEFile::print_debug( ReportWriter& out, const ImageReader& image, const DataDirectory& debug ) const {
+   STATS_SCOPE( DEBUG );
+   out.begin_group( Group::DEBUG );
+
+   const DebugDirectory directory { image, debug };
+   for( size_t i = 0 ; i < directory.size() ; i++ ) {
+      const DebugDirectoryView entry = directory.entry( i );
+      out.begin_group( Group::DEBUG_ENTRY );
+      out.fields( entry, options_.fields.mask<DebugDirectoryView>() );
+      const optional<CodeViewInfo> info = directory.codeview( entry );
+      if( info ) {
+         out.codeview( *info );
+      }
+      out.end_group( Group::DEBUG_ENTRY );
+   }
+   out.end_group( Group::DEBUG );
+} // print_debug()
+
+
+void PEFile::print_overlay( ReportWriter& out, const span<const Section_FieldMap> sections, const uint64_t headers_end, const DataDirectory& certificate ) const {
+   STATS_SCOPE( OVERLAY );
+   out.begin_group( Group::OVERLAY );
+
+   OverlayInfo overlay;
+   overlay.offset = headers_end;
+   for( const Section_FieldMap& section : sections ) {
+      const uint32_t raw_size = section.get<SECTION_RAW_SIZE>();
+      if( raw_size > 0 ) {
+         overlay.offset = max( overlay.offset, uint64_t{ section.get<SECTION_RAW_OFFSET>() } + raw_size );
+      }
+   }
+   const uint64_t file_size = source_->size();
+   overlay.size = overlay.offset < file_size ? file_size - overlay.offset : 0;
+
+   // A signed file's overlay is usually just its Authenticode signature
+   if( certificate.size > 0 && certificate.virtual_address >= overlay.offset && uint64_t{ certificate.virtual_address } + certificate.size <= file_size ) {
+      overlay.certificate_size = certificate.size;
+   }
+   out.overlay( overlay );
+
+   out.begin_group( Group::OVERLAY_MATCHES );
+   if( overlay.size > 0 ) {
+      const OverlayMatches matches = find_overlay_signatures( *source_, overlay );
+      for( size_t i = 0 ; i < NUMBER_OF_OVERLAY_SIGNATURES ; i++ ) {
+         if( matches[i].count > 0 ) {
+            out.overlay_signature( OVERLAY_SIGNATURES[i], matches[i] );
+         }
+      }
+   }
+   out.end_group( Group::OVERLAY_MATCHES );
+   out.end_group( Group::OVERLAY );
+} // print_overlay()
+
+
+PEFile::PEFile( const string& new_file_path, const LoadMode load_mode, const ReportOptions& options, pmr::memory_resource* arena )
+      :PEFile( open_byte_source( new_file_path, load_mode ), options, arena )  // Delegating constructor
+{}
+
+
+PEFile::PEFile( unique_ptr<ByteSource> new_source, const ReportOptions& options, pmr::memory_resource* arena )
+      :arena_    ( arena )                                   // Member initialization
+      ,file_path_( new_source->get_file_path(), arena )      // Member initialization
+      ,source_   ( std::move( new_source ) )                 // Member initialization
+      ,options_  ( options )                                 // Member initialization
+      ,sections_ ( arena )                                   // Member initialization
+{
+   file_size_ = static_cast<long>( source_->size() );
+}
+
+
+void PEFile::print( ReportWriter& out, Stage& stage ) {
+   // The whole-file hash doesn't depend on the headers, so start it first
+   Sha256::Digest file_digest {};
+   TaskGroup      file_tasks;
+   if( options_.hash_file ) {
+      file_tasks.run( [this, &file_digest] {
+         STATS_SCOPE( ANALYZE );
+         Sha256 sha256;
+         sha256.update( source_->read( 0, source_->size() ), source_->size() );
+         file_digest = sha256.finish();
+      } );
+   }
+
+   // The tables need the optional header and the section table to translate RVAs, selected or not
+   const FieldProjection& fields          = options_.fields;
+   const bool             reads_image     = options_.imports || options_.exports || !options_.export_queries.empty() || options_.resources || options_.relocations || options_.debug || options_.overlay || options_.imphash;
+   const bool             prints_sections = fields.mask<SectionHeaderView>() != 0 || has_section_analysis();
+
+   // The structural fields (the magics, e_lfanew and the sizes) are read and validated whatever is selected
+   stage = Stage::DOS_HEADER;
+   DOS_FieldMap dos_field_map_;
+
+   dos_field_map_.parse( *source_ );
+   dos_field_map_.validate();
+   dos_field_map_.print( out, fields );
+
+   const uint32_t coff_offset = dos_field_map_.get_exe_header_offset();
+
+   stage = Stage::COFF_HEADER;
+   COFF_FieldMap coff_header_map { coff_offset };
+   coff_header_map.parse( *source_ );
+   coff_header_map.validate();
+   coff_header_map.print( out, fields );
+
+   stage = Stage::OPTIONAL_HEADER;
+   Optional_FieldMap optional_header_map { coff_header_map.get_optional_header_offset(), coff_header_map.get_size_of_optional_header() };
+   const bool prints_optional_header = options_.optional_header && fields.has_optional_header();
+   const bool reads_optional_header  = optional_header_map.is_present() && ( prints_optional_header || reads_image );
+   if( reads_optional_header ) {
+      optional_header_map.parse( *source_ );
+      if( prints_optional_header ) {
+         optional_header_map.print( out, fields );
+      }
+   }
+
+   stage = Stage::SECTION_TABLE;
+   if( prints_sections ) {
+      out.begin_group( Group::SECTIONS );
+   }
+
+   // The section table is only read if it's printed or the tables need it
+   const uint16_t declared_sections    = prints_sections || reads_image ? coff_header_map.get_number_of_sections() : 0;
+   const uint32_t section_table_offset = coff_header_map.get_section_table_offset();
+
+   // A hostile NumberOfSections doesn't get more headers than start in the
+   // file, plus the first one past the end (which fails when it's read)
+   const size_t   table_bytes        = section_table_offset < source_->size() ? source_->size() - section_table_offset : 0;
+   const uint16_t number_of_sections = static_cast<uint16_t>( min<size_t>( declared_sections, ( table_bytes + Section_FieldMap::EXTENT - 1 ) / Section_FieldMap::EXTENT + 1 ) );
+
+   // Read the whole section table first, so the per-section analyses can run in parallel
+   pmr::vector<Section_FieldMap> section_headers { arena_ };
+   section_headers.reserve( number_of_sections );
+   for( uint16_t i = 0 ; i < number_of_sections ; i++ ) {
+      section_headers.emplace_back( section_table_offset + (i * Section_FieldMap::EXTENT) );
+      section_headers.back().parse( *source_ );
+   }
+
+   pmr::vector<SectionAnalysis> analyses( has_section_analysis() ? number_of_sections : 0, arena_ );
+   if( !analyses.empty() ) {
+      TaskGroup group;
+      for( uint16_t i = 0 ; i < number_of_sections ; i++ ) {
+         if( !section_headers[i].is_complete() ) {
+            continue;  // Printing the header will report it
+         }
+         group.run( [this, &section = section_headers[i], &analysis = analyses[i]] {
+            try {
+               analyze_section( section, analysis );
+            } catch( ... ) {
+               analysis.error = current_exception();
+            }
+         } );
+      }
+      group.wait();
+   }
+
+   // Print in section order, just like a serial run (stopping at the first failure)
+   sections_.reset( number_of_sections, reads_optional_header ? optional_header_map.get_size_of_headers() : 0, source_->size() );
+   for( uint16_t i = 0 ; i < number_of_sections ; i++ ) {
+      Section_FieldMap& newSection = section_headers[i];
+      newSection.validate();
+      if( prints_sections ) {
+         newSection.print( out, fields );
+         if( !analyses.empty() ) {
+            if( analyses[i].error ) {
+               stage = analyses[i].stage;
+               rethrow_exception( analyses[i].error );
+            }
+            print_section_analysis( out, analyses[i] );
+         }
+         out.end_group( Group::SECTION );
+      }
+      sections_.add( newSection, i );
+   }
+   if( prints_sections ) {
+      out.end_group( Group::SECTIONS );
+   }
+   sections_.finish();
+
+   // Only an image has data directories (an object file has no optional header)
+   const ImageReader image { *source_, sections_, optional_header_map.is_pe32_plus() };
+
+   if( options_.imports && reads_optional_header ) {
+      stage = Stage::IMPORTS;
+      print_imports( out, image, optional_header_map.get_data_directory( IMPORT_TABLE ) );
+   }
+
+   if( ( options_.exports || !options_.export_queries.empty() ) && reads_optional_header ) {
+      stage = Stage::EXPORTS;
+      STATS_SCOPE( EXPORTS );
+      const ExportTable exports { image, optional_header_map.get_data_directory( EXPORT_TABLE ) };
+      if( options_.exports ) {
+         print_exports( out, exports );
+      }
+      if( !options_.export_queries.empty() ) {
+         print_export_lookups( out, exports );
+      }
+   }
+
+   if( options_.resources && reads_optional_header ) {
+      stage = Stage::RESOURCES;
+      print_resources( out, image, optional_header_map.get_data_directory( RESOURCE_TABLE ) );
+   }
+
+   if( options_.relocations && reads_optional_header ) {
+      stage = Stage::RELOCATIONS;
+      print_relocations( out, image, optional_header_map.get_data_directory( BASE_RELOCATION_TABLE ) );
+   }
+
+   if( options_.debug && reads_optional_header ) {
+      stage = Stage::DEBUG;
+      print_debug( out, image, optional_header_map.get_data_directory( DEBUG_DIRECTORY ) );
+   }
+
+   if( options_.overlay ) {
+      stage = Stage::OVERLAY;
+      const uint64_t headers_end = uint64_t{ section_table_offset } + uint64_t{ number_of_sections } * Section_FieldMap::EXTENT;
+      print_overlay( out, section_headers, headers_end, reads_optional_header ? optional_header_map.get_data_directory( CERTIFICATE_TABLE ) : DataDirectory {} );
+   }
+
+   if( options_.hash_file || options_.imphash ) {
+      stage = Stage::HASHES;
+      out.begin_group( Group::HASHES );
+      if( options_.hash_file ) {
+         file_tasks.wait();
+         out.digest( "sha256", "SHA-256", file_digest.data(), file_digest.size() );
+      }
+      if( options_.imphash && reads_optional_header ) {
+         STATS_SCOPE( ANALYZE );
+         const Md5::Digest digest = imphash( ImportTable { image, optional_header_map.get_data_directory( IMPORT_TABLE ) } );
+         out.digest( "imphash", "Imphash", digest.data(), digest.size() );
+      }
+      out.end_group( Group::HASHES );
+   }
+} // print()
+
+
+/// Open the PEFile at `path` and print its report
+///
+/// If it fails, the writer finishes the report with the failure and the
+/// exception is rethrown for the Batch.
+///
+/// @param path      The PE file to process
+/// @param load_mode How to get the bytes of the file
+/// @param options   What to print
+/// @param out       Where to print
+/// @param stage     Updated as each part of the file is worked on
+static void report_file( const string& path, const LoadMode load_mode, const ReportOptions& options, ReportWriter& out, Stage& stage ) {
+   out.begin_file( path );
+   const ArenaScope arena;  // Everything the file allocates is released at once when it's done
+   try {
+      stage = Stage::OPEN;
+      PEFile pe_file( path, load_mode, options, arena.resource() );
+      pe_file.print( out, stage );
+   } catch( const exception& e ) {
+      out.fail( stage_name( stage ), e.what() );
+      throw;
+   }
+   out.end_file();
+}
+
+
+void write_report( const string& path, const LoadMode load_mode, const ReportFormat format, const ReportOptions& options, OutputSink& report, Stage& stage ) {
+   if( format == ReportFormat::JSON ) {
+      JsonReportWriter writer { report };
+      report_file( path, load_mode, options, writer, stage );
+   } else if( format == ReportFormat::BINARY ) {
+      BinaryReportWriter writer { report };
+      report_file( path, load_mode, options, writer, stage );
+   } else {
+      TextReportWriter writer { report };
+      report_file( path, load_mode, options, writer, stage );
+   }
+}
+
+
+void write_skipped_report( const string& path, const ReportFormat format, const string_view reason, OutputSink& report ) {
+   if( format == ReportFormat::JSON ) {
+      JsonReportWriter writer { report };
+      writer.begin_file( path );
+      writer.skip( reason );
+   } else if( format == ReportFormat::BINARY ) {
+      BinaryReportWriter writer { report };
+      writer.begin_file( path );
+      writer.skip( reason );
+   }
+}
@@ -0,0 +1,320 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// A Windows Portable Executable file and the report that readpe prints for it
+///
+/// @file   PEFile.h
+/// @author Thanh Ly thanhly@hawaii.edu>
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>          // For size_t
+#include <cstdint>          // For uint32_t
+#include <exception>        // For exception_ptr
+#include <memory>           // For unique_ptr
+#include <memory_resource>  // For memory_resource
+#include <span>             // For span
+#include <string>           // For pmr::string
+#include <string_view>      // For string_view
+#include <vector>           // For pmr::vector
+
+#include "Batch.h"
+#include "ByteSource.h"
+#include "Exports.h"
+#include "FieldProjection.h"
+#include "Hash.h"
+#include "HeaderView.h"
+#include "ImageReader.h"
+#include "OutputSink.h"
+#include "ReportWriter.h"
+#include "SectionTable.h"
+#include "Stats.h"
+
+
+/// Print a group of fields through the header view `VIEW`
+///
+/// @tparam VIEW A HeaderView like DosHeaderView
+template <typename VIEW>
+class FieldMap : public VIEW {
+public:
+   using VIEW::VIEW;
+
+   /// Point this FieldMap at its bytes in PEFile.source_ (nothing is copied)
+   /// @param file_source Reference to PEFile.source_
+   void parse( ByteSource& file_source ) {
+      STATS_SCOPE( PARSE );
+      VIEW::bind( file_source );
+   }
+
+   /// Print the fields of this FieldMap that `fields` selects (generic)
+   /// @param out    Where to print
+   /// @param fields What to print
+   void print( ReportWriter& out, const FieldProjection& fields ) const {
+      out.fields( *this, fields.mask<VIEW>() );
+   }
+}; // FieldMap
+
+
+/// A DOS-specific FieldMap
+class DOS_FieldMap : public FieldMap<DosHeaderView> {
+public:
+   /// Print the DOS header (if any of its fields are selected)
+   /// @param out    Where to print
+   /// @param fields What to print
+   void print( ReportWriter& out, const FieldProjection& fields ) const {
+      if( fields.mask<DosHeaderView>() == 0 ) {
+         return;
+      }
+      STATS_SCOPE( FORMAT );
+      out.begin_group( Group::DOS_HEADER );
+      FieldMap::print( out, fields );
+      out.end_group( Group::DOS_HEADER );
+   }
+}; // DOS_FieldMap
+
+
+/// A COFF-specific FieldMap
+class COFF_FieldMap : public FieldMap<CoffHeaderView> {
+public:
+   using FieldMap::FieldMap;
+
+   /// Print the COFF header (if any of its fields are selected)
+   /// @param out    Where to print
+   /// @param fields What to print
+   void print( ReportWriter& out, const FieldProjection& fields ) const {
+      if( fields.mask<CoffHeaderView>() == 0 ) {
+         return;
+      }
+      STATS_SCOPE( FORMAT );
+      out.begin_group( Group::COFF_HEADER );
+      FieldMap::print( out, fields );
+      out.end_group( Group::COFF_HEADER );
+   }
+}; // COFF_FieldMap
+
+
+/// A FieldMap for the optional header
+///
+/// The optional header is PE32 or PE32+ depending on its magic, so this
+/// prints whichever layout the file has, followed by the data directory.
+class Optional_FieldMap : public OptionalHeader {
+public:
+   using OptionalHeader::OptionalHeader;
+
+   /// Read the optional header from `file_source`
+   /// @param file_source Reference to PEFile.source_
+   void parse( ByteSource& file_source ) {
+      STATS_SCOPE( PARSE );
+      OptionalHeader::parse( file_source );
+   }
+
+   /// Print the optional header and its data directory (if any of them are selected)
+   /// @param out    Where to print
+   /// @param fields What to print
+   void print( ReportWriter& out, const FieldProjection& fields ) const {
+      const uint64_t mask = is_pe32_plus() ? fields.mask<Optional64HeaderView>() : fields.mask<Optional32HeaderView>();
+      if( mask == 0 && !fields.has_data_directories() ) {
+         return;
+      }
+      STATS_SCOPE( FORMAT );
+      out.begin_group( Group::OPTIONAL_HEADER );
+      if( is_pe32_plus() ) {
+         out.fields( pe64_, mask );
+      } else {
+         out.fields( pe32_, mask );
+      }
+
+      if( fields.has_data_directories() ) {
+         out.begin_group( Group::DATA_DIRECTORIES );
+         for( size_t i = 0 ; i < number_of_data_directories_ ; i++ ) {
+            out.data_directory( i, data_directories_[i] );
+         }
+         out.end_group( Group::DATA_DIRECTORIES );
+      }
+      out.end_group( Group::OPTIONAL_HEADER );
+   } // print()
+}; // Optional_FieldMap
+
+
+/// A Section-specific FieldMap
+class Section_FieldMap : public FieldMap<SectionHeaderView> {
+public:
+   using FieldMap::FieldMap;
+
+   /// Print the fields of this section (the caller ends the group after the analyses)
+   /// @param out    Where to print
+   /// @param fields What to print
+   void print( ReportWriter& out, const FieldProjection& fields ) const {
+      STATS_SCOPE( FORMAT );
+      out.begin_group( Group::SECTION );
+      FieldMap::print( out, fields );
+   }
+}; // Section_FieldMap
+
+
+/// What to print for each PEFile beyond the headers and the section table
+struct ReportOptions {
+   bool                     optional_header { false };  ///< Print the optional header and its data directories (it's read whenever a table needs it)
+   bool                     imports         { false };  ///< Print the import table
+   bool                     exports         { false };  ///< Print the export table
+   bool                     entropy         { false };  ///< Print the entropy of each section
+   bool                     hash_file       { false };  ///< Print the SHA-256 of the whole file
+   bool                     hash_sections   { false };  ///< Print the SHA-256 of each section's raw data
+   bool                     imphash         { false };  ///< Print the imphash
+   std::vector<std::string> export_queries;             ///< Exports to look up (by name, or by `#ordinal`)
+   bool                     resources       { false };  ///< Print the leaves of the resource tree
+   std::vector<uint32_t>    resource_types;             ///< The resource types to print (all of them if it's empty)
+   bool                     relocations     { false };  ///< Print the base relocations of each page
+   bool                     debug           { false };  ///< Print the debug directory (and the PDB it points at)
+   bool                     overlay         { false };  ///< Print the data after the last section (and the payloads in it)
+   FieldProjection          fields;                     ///< The header fields to print (`--fields`)
+};
+
+
+/// This class represents a Windows Portable Executable file
+class PEFile {
+protected:
+   std::pmr::memory_resource*  arena_;      ///< Where the state of this file is allocated
+   std::pmr::string            file_path_;  ///< The name of the PEFile
+   long                        file_size_;  ///< The size of the PEFile
+   std::unique_ptr<ByteSource> source_;     ///< The contents of the PEFile
+   ReportOptions               options_;    ///< What to print
+   SectionTable                sections_;   ///< The section table, for translating RVAs
+
+   /// The part of a section's raw data that's in the file
+   struct RawData {
+      const unsigned char* bytes  { nullptr };  ///< The first byte
+      size_t               length { 0 };        ///< The number of bytes
+   };
+
+   /// @return The raw data of `section` (clipped to the end of the file)
+   RawData raw_data( const SectionHeaderView& section ) const;
+
+   /// The result of the per-section analyses for one section
+   struct SectionAnalysis {
+      double             entropy       { 0 };               ///< The entropy of the raw data (in bits per byte)
+      size_t             entropy_bytes { 0 };               ///< The number of bytes that were counted
+      Sha256::Digest     digest        {};                  ///< The SHA-256 of the raw data
+      Stage              stage         { Stage::ENTROPY };  ///< The analysis that was running (for a failure)
+      std::exception_ptr error;                             ///< Set if an analysis failed
+   };
+
+   bool has_section_analysis() const {
+      return options_.entropy || options_.hash_sections;  /// @return `true` if anything is printed at the end of each section's block
+   }
+
+   /// Run the per-section analyses for `section` (this can run on any thread)
+   ///
+   /// Only the part of the section that's in the file is counted.
+   ///
+   /// @param section  The section header
+   /// @param analysis Where the results go
+   void analyze_section( const SectionHeaderView& section, SectionAnalysis& analysis ) const;
+
+   /// Print the results of analyze_section()
+   /// @param out      Where to print
+   /// @param analysis The results
+   void print_section_analysis( ReportWriter& out, const SectionAnalysis& analysis ) const;
+
+   /// Print the DLLs and functions in the import table
+   /// @param out   Where to print
+   /// @param image Where to read the import table
+   /// @param imports The Import Table entry in the data directory
+   void print_imports( ReportWriter& out, const ImageReader& image, const DataDirectory& imports ) const;
+
+   /// Print the export directory and its named exports
+   /// @param out   Where to print
+   /// @param table The export table
+   void print_exports( ReportWriter& out, const ExportTable& table ) const;
+
+   /// Print the leaves of the resource tree (only under ReportOptions.resource_types if it's set)
+   /// @param out       Where to print
+   /// @param image     Where to read the resource tree
+   /// @param resources The Resource Table entry in the data directory
+   void print_resources( ReportWriter& out, const ImageReader& image, const DataDirectory& resources ) const;
+
+   /// Print the number of fixups in each page and of each type
+   ///
+   /// @param out         Where to print
+   /// @param image       Where to read the base relocation table
+   /// @param relocations The Base Relocation Table entry in the data directory
+   void print_relocations( ReportWriter& out, const ImageReader& image, const DataDirectory& relocations ) const;
+
+   /// Print each debug directory entry (and the PDB that a CodeView entry points at)
+   ///
+   /// @param out   Where to print
+   /// @param image Where to read the debug directory
+   /// @param debug The Debug entry in the data directory
+   void print_debug( ReportWriter& out, const ImageReader& image, const DataDirectory& debug ) const;
+
+   /// Print where the overlay is and the payloads that are in it
+   ///
+   /// Only the section table is needed to find the overlay (no section's
+   /// raw data is read).
+   ///
+   /// @param out         Where to print
+   /// @param sections    The section table
+   /// @param headers_end The end of the section table (where the overlay starts if no section has raw data)
+   /// @param certificate The Certificate Table entry in the data directory (its address is a file offset)
+   void print_overlay( ReportWriter& out, std::span<const Section_FieldMap> sections, uint64_t headers_end, const DataDirectory& certificate ) const;
+
+   /// Look up each of ReportOptions.export_queries
+   ///
+   /// A query that starts with `#` is an ordinal.
+   ///
+   /// @param out   Where to print
+   /// @param table The export table
+   void print_export_lookups( ReportWriter& out, const ExportTable& table ) const;
+
+public:
+   /// Open the PEFile at `new_file_path`
+   ///
+   /// Nothing past the headers is read unless `load_mode` is LoadMode::READ.
+   ///
+   /// @param new_file_path The name of the PE file to process
+   /// @param load_mode     How to get the bytes of the file
+   /// @param options       What to print
+   /// @param arena         Where to allocate the state of the file (an ArenaScope's resource)
+   PEFile( const std::string& new_file_path, LoadMode load_mode = LoadMode::MMAP, const ReportOptions& options = {}, std::pmr::memory_resource* arena = std::pmr::get_default_resource() );
+
+   /// Read a PEFile from `new_source` (like a MemoryByteSource)
+   ///
+   /// @param new_source The bytes of the file (it's named by ByteSource::get_file_path())
+   /// @param options    What to print
+   /// @param arena      Where to allocate the state of the file (an ArenaScope's resource)
+   explicit PEFile( std::unique_ptr<ByteSource> new_source, const ReportOptions& options = {}, std::pmr::memory_resource* arena = std::pmr::get_default_resource() );
+
+   virtual ~PEFile() = default;
+
+   /// Print the headers and sections of this PEFile
+   /// @param out   Where to print
+   /// @param stage Updated as each part of the file is worked on
+   virtual void print( ReportWriter& out, Stage& stage );
+
+   const SectionTable& get_sections() const {
+      return sections_;  /// @return The section table (once print() has read it)
+   }
+}; // PEFile
+
+
+/// Print the report for the file at `path` in `format`
+/// @param path      The PE file to process
+/// @param load_mode How to get the bytes of the file
+/// @param format    How to write the report
+/// @param options   What to print
+/// @param report    Where to print
+/// @param stage     Updated as each part of the file is worked on
+extern void write_report( const std::string& path, LoadMode load_mode, ReportFormat format, const ReportOptions& options, OutputSink& report, Stage& stage );
+
+/// Print the report for the file at `path`, which was skipped without being parsed
+///
+/// The text format prints nothing.  The JSON and binary formats write a
+/// record that says why, so every path still gets one.
+///
+/// @param path   The file that was skipped
+/// @param format How to write the report
+/// @param reason Why it was skipped
+/// @param report Where to print
+extern void write_skipped_report( const std::string& path, ReportFormat format, std::string_view reason, OutputSink& report );
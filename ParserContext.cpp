@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Everything that stays the same from file to file, kept for reuse
+///
+/// @file   ParserContext.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <optional>  // For optional
+
+#include "ParserContext.h"
+#include "Stats.h"
+
+using namespace std;
+
+
+/// Changes whenever the reports for the same options change (so old cache entries are missed)
+#define REPORT_VERSION "readpe report 1"
+
+
+/// @return A hash of everything that changes the report for a file (for the ResultCache)
+static uint64_t hash_options( const ReportFormat format, const ReportOptions& options ) {
+   string described { REPORT_VERSION };
+   described.push_back( static_cast<char>( '0' + static_cast<int>( format ) ) );
+   for( const bool flag : { options.optional_header, options.imports, options.exports, options.entropy, options.hash_file, options.hash_sections, options.imphash, options.resources, options.relocations, options.debug, options.overlay } ) {
+      described.push_back( flag ? '1' : '0' );
+   }
+   for( const uint32_t type : options.resource_types ) {
+      described.push_back( ',' );
+      described.append( to_string( type ) );
+   }
+   for( const string& query : options.export_queries ) {
+      described.push_back( '\n' );
+      described.append( query );
+   }
+   options.fields.append_key( described );
+   return ResultCache::hash( described );
+}
+
+
+ParserContext::ParserContext( const ParserSettings& settings )
+      :settings_    ( settings )                                          // Member initialization
+      ,options_hash_( hash_options( settings.format, settings.options ) )  // Member initialization
+      ,batch_       ( settings.jobs, settings.keep_going, [this]( const string& path, OutputSink& report, Stage& stage ) { return write( path, report, stage ); } )  // Member initialization
+{}
+
+
+bool ParserContext::write( const string& path, OutputSink& report, Stage& stage ) const {
+   // An unchanged file is served from the cache without being opened
+   optional<CacheKey> key;
+   if( settings_.cache != nullptr ) {
+      stage = Stage::CACHE;
+      STATS_SCOPE( CACHE );
+      key = ResultCache::key_for( path, options_hash_ );
+      if( key ) {
+         const optional<string_view> cached = settings_.cache->find( *key, path );
+         if( cached ) {
+            STATS_ADD( CACHE_HITS, 1 );
+            report.append( *cached );
+            return true;
+         }
+      }
+   }
+
+   // A file that isn't a PE is skipped without being opened as one (and isn't a failure)
+   if( settings_.prefilter && check_pe_signature( path ) == PeSignature::NOT_PE ) {
+      STATS_ADD( REJECTED, 1 );
+      write_skipped_report( path, settings_.format, "not_pe", report );
+      return false;
+   }
+
+   const size_t start = report.size();
+   write_report( path, settings_.load_mode, settings_.format, settings_.options, report, stage );
+
+   if( key ) {
+      stage = Stage::CACHE;
+      STATS_SCOPE( CACHE );
+      settings_.cache->store( *key, path, string_view( report.data() + start, report.size() - start ) );
+   }
+   return true;
+} // write()
+
+
+string_view ParserContext::report( const string& path ) {
+   report_.clear();
+   Stage stage { Stage::OPEN };
+   write( path, report_, stage );
+   return string_view( report_.data(), report_.size() );
+}
@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Everything that stays the same from file to file, kept for reuse
+///
+/// readpe is also a library (`libreadpe.a`).  A program that links it
+/// builds a ParserContext once with the settings that readpe's options map
+/// to, then hands it files for as long as it likes: one at a time on its
+/// own thread with report(), or as many as it has through run().  Either
+/// way it pays for the options (and their ResultCache key) once, and the
+/// worker threads, their arenas and the output buffers stay warm from one
+/// file to the next instead of being started up per process.
+///
+/// @file   ParserContext.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>      // For size_t
+#include <cstdint>      // For uint64_t
+#include <ostream>      // For ostream
+#include <string>       // For string
+#include <string_view>  // For string_view
+
+#include "Batch.h"
+#include "ByteSource.h"
+#include "OutputSink.h"
+#include "PEFile.h"
+#include "ReportWriter.h"
+#include "ResultCache.h"
+#include "ThreadPool.h"
+
+
+/// How a ParserContext reports files (the readpe options that aren't about what to print)
+struct ParserSettings {
+   LoadMode      load_mode  { LoadMode::MMAP };                ///< How to get the bytes of each file
+   ReportFormat  format     { ReportFormat::TEXT };            ///< How to write the reports
+   ReportOptions options;                                       ///< What to print
+   size_t        jobs       { ThreadPool::default_size() };    ///< The number of workers that run() uses
+   bool          keep_going { false };                          ///< Record failures and keep going rather than stopping
+   bool          prefilter  { false };                          ///< Skip files that don't have a PE signature
+   ResultCache*  cache      { nullptr };                        ///< Where to look up and store reports (not owned, and optional)
+};
+
+
+/// A reusable parser: the settings, a Batch with its workers, and a buffer for report()
+class ParserContext {
+protected:
+   ParserSettings settings_;      ///< How files are reported
+   uint64_t       options_hash_;  ///< The part of the ResultCache key that comes from #settings_
+   OutputSink     report_;        ///< The report that report() returns (reused from file to file)
+   Batch          batch_;         ///< The workers that run() uses
+
+public:
+   /// Get ready to report files with `settings` (the workers are started here)
+   explicit ParserContext( const ParserSettings& settings );
+
+   ParserContext( const ParserContext& ) = delete;             ///< A ParserContext owns threads
+   ParserContext& operator=( const ParserContext& ) = delete;  ///< A ParserContext owns threads
+
+   const ParserSettings& settings() const {
+      return settings_;  /// @return How files are reported
+   }
+
+   /// Append the report for the file at `path` to `report`
+   ///
+   /// This is the job that run() gives its workers, and it's safe to call
+   /// from several threads at once.  It looks the file up in the cache,
+   /// skips it if the prefilter says it isn't a PE file, and otherwise
+   /// writes its report (and stores that in the cache).
+   ///
+   /// @param path   The PE file to report
+   /// @param report Where to append the report
+   /// @param stage  Updated as each part of the file is worked on
+   /// @return `false` if the prefilter skipped the file (a JSON or binary report says so)
+   /// @throws Whatever the report failed with (after the failure is in `report`)
+   bool write( const std::string& path, OutputSink& report, Stage& stage ) const;
+
+   /// Report the file at `path` on the calling thread
+   ///
+   /// Only one thread at a time may call this (the report is in a buffer
+   /// that's reused).
+   ///
+   /// @return The report (valid until the next call)
+   /// @throws Whatever the report failed with
+   std::string_view report( const std::string& path );
+
+   /// Report every path in `paths` on the workers and write the reports to `out_fd` in order
+   ///
+   /// @see Batch::run()
+   /// @return The number of files processed and the failures
+   BatchSummary run( PathSource& paths, const int out_fd, std::ostream& errors ) {
+      return batch_.run( paths, out_fd, errors );
+   }
+}; // ParserContext
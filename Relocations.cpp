@@ -0,0 +1,200 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Walk the base relocation table of a PE image
+///
+/// @file   Relocations.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For min()
+#include <stdexcept>  // For domain_error
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+   #include <immintrin.h>  // For the AVX2 intrinsics
+   #define HAVE_X86_KERNELS
+#endif
+
+#if defined( __ARM_NEON ) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   #include <arm_neon.h>   // For the NEON intrinsics
+   #define HAVE_NEON_KERNELS
+#endif
+
+#include "Relocations.h"
+
+using namespace std;
+
+
+/// The size of an `IMAGE_BASE_RELOCATION` header (before its entries)
+#define BLOCK_HEADER_SIZE 8
+
+/// The most vectors a kernel counts before its 16-bit counters are added up
+#define CHUNK_VECTORS 4096
+
+
+/// A kernel adds the types of `count` entries to `counts`
+using Kernel = void (*)( const char* entries, size_t count, RelocationCounts& counts );
+
+
+/// The portable kernel: one entry at a time
+static void count_scalar( const char* entries, const size_t count, RelocationCounts& counts ) {
+   for( size_t i = 0 ; i < count ; i++ ) {
+      counts[ load_le<uint16_t>( entries + i * 2 ) >> 12 ]++;
+   }
+}
+
+
+/// Add a chunk that a kernel counted to `counts`, or count it again one
+/// entry at a time if it had a type that the kernel doesn't look for
+///
+/// @param entries The entries in the chunk
+/// @param count   The number of entries in the chunk
+/// @param found   The number of ABSOLUTE, HIGHLOW and DIR64 entries the kernel found
+/// @param counts  Where to add them
+static void add_chunk( const char* entries, const size_t count, const uint64_t (&found)[3], RelocationCounts& counts ) {
+   if( found[0] + found[1] + found[2] != count ) {
+      count_scalar( entries, count, counts );
+      return;
+   }
+   counts[ IMAGE_REL_BASED_ABSOLUTE ] += found[0];
+   counts[ IMAGE_REL_BASED_HIGHLOW  ] += found[1];
+   counts[ IMAGE_REL_BASED_DIR64    ] += found[2];
+}
+
+
+#if defined( HAVE_X86_KERNELS )
+/// @return The sum of the 16 16-bit lanes in `lanes`
+__attribute__(( target( "avx2" ) ))
+static uint64_t sum_lanes_avx2( const __m256i lanes ) {
+   const __m256i pairs = _mm256_madd_epi16( lanes, _mm256_set1_epi16( 1 ) );  // 8 32-bit sums
+   __m128i sum = _mm_add_epi32( _mm256_castsi256_si128( pairs ), _mm256_extracti128_si256( pairs, 1 ) );
+   sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, 0x4E ) );
+   sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, 0xB1 ) );
+   return static_cast<uint32_t>( _mm_cvtsi128_si32( sum ) );
+}
+
+
+/// The AVX2 kernel: 16 entries per 256-bit load
+__attribute__(( target( "avx2" ) ))
+static void count_avx2( const char* entries, const size_t count, RelocationCounts& counts ) {
+   const __m256i highlow = _mm256_set1_epi16( IMAGE_REL_BASED_HIGHLOW );
+   const __m256i dir64   = _mm256_set1_epi16( IMAGE_REL_BASED_DIR64 );
+
+   size_t i = 0;
+   while( i + 16 <= count ) {
+      const size_t vectors   = min<size_t>( ( count - i ) / 16, CHUNK_VECTORS );
+      __m256i      absolutes = _mm256_setzero_si256();
+      __m256i      highlows  = _mm256_setzero_si256();
+      __m256i      dir64s    = _mm256_setzero_si256();
+      for( size_t v = 0 ; v < vectors ; v++ ) {
+         const __m256i block = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( entries + ( i + v * 16 ) * 2 ) );
+         const __m256i types = _mm256_srli_epi16( block, 12 );
+         absolutes = _mm256_sub_epi16( absolutes, _mm256_cmpeq_epi16( types, _mm256_setzero_si256() ) );  // A match is -1
+         highlows  = _mm256_sub_epi16( highlows,  _mm256_cmpeq_epi16( types, highlow ) );
+         dir64s    = _mm256_sub_epi16( dir64s,    _mm256_cmpeq_epi16( types, dir64 ) );
+      }
+      const uint64_t found[3] = { sum_lanes_avx2( absolutes ), sum_lanes_avx2( highlows ), sum_lanes_avx2( dir64s ) };
+      add_chunk( entries + i * 2, vectors * 16, found, counts );
+      i += vectors * 16;
+   }
+   count_scalar( entries + i * 2, count - i, counts );
+}
+#endif
+
+
+#if defined( HAVE_NEON_KERNELS )
+/// @return The sum of the 8 16-bit lanes in `lanes`
+static uint64_t sum_lanes_neon( const uint16x8_t lanes ) {
+   const uint64x2_t sum = vpaddlq_u32( vpaddlq_u16( lanes ) );
+   return vgetq_lane_u64( sum, 0 ) + vgetq_lane_u64( sum, 1 );
+}
+
+
+/// The NEON kernel: 8 entries per 128-bit load
+static void count_neon( const char* entries, const size_t count, RelocationCounts& counts ) {
+   const uint16x8_t absolute = vdupq_n_u16( IMAGE_REL_BASED_ABSOLUTE );
+   const uint16x8_t highlow  = vdupq_n_u16( IMAGE_REL_BASED_HIGHLOW );
+   const uint16x8_t dir64    = vdupq_n_u16( IMAGE_REL_BASED_DIR64 );
+
+   size_t i = 0;
+   while( i + 8 <= count ) {
+      const size_t vectors   = min<size_t>( ( count - i ) / 8, CHUNK_VECTORS );
+      uint16x8_t   absolutes = vdupq_n_u16( 0 );
+      uint16x8_t   highlows  = vdupq_n_u16( 0 );
+      uint16x8_t   dir64s    = vdupq_n_u16( 0 );
+      for( size_t v = 0 ; v < vectors ; v++ ) {
+         const uint16x8_t types = vshrq_n_u16( vld1q_u16( reinterpret_cast<const uint16_t*>( entries + ( i + v * 8 ) * 2 ) ), 12 );
+         absolutes = vsubq_u16( absolutes, vceqq_u16( types, absolute ) );  // A match is all ones (-1)
+         highlows  = vsubq_u16( highlows,  vceqq_u16( types, highlow ) );
+         dir64s    = vsubq_u16( dir64s,    vceqq_u16( types, dir64 ) );
+      }
+      const uint64_t found[3] = { sum_lanes_neon( absolutes ), sum_lanes_neon( highlows ), sum_lanes_neon( dir64s ) };
+      add_chunk( entries + i * 2, vectors * 8, found, counts );
+      i += vectors * 8;
+   }
+   count_scalar( entries + i * 2, count - i, counts );
+}
+#endif
+
+
+/// The kernel for this CPU and its name
+struct KernelChoice {
+   Kernel      kernel;  ///< The function
+   const char* name;    ///< What to call it
+};
+
+
+/// @return The widest kernel that this CPU can run
+static KernelChoice select_kernel() {
+#if defined( HAVE_X86_KERNELS )
+   __builtin_cpu_init();
+   if( __builtin_cpu_supports( "avx2" ) ) {
+      return { count_avx2, "avx2" };
+   }
+#endif
+#if defined( HAVE_NEON_KERNELS )
+   return { count_neon, "neon" };
+#endif
+   return { count_scalar, "scalar" };
+}
+
+
+/// @return The kernel (chosen once, the first time it's asked for)
+static const KernelChoice& kernel_choice() {
+   static const KernelChoice choice = select_kernel();
+   return choice;
+}
+
+
+const char* relocation_kernel_name() {
+   return kernel_choice().name;
+}
+
+
+void count_relocation_types( const char* entries, const size_t count, RelocationCounts& counts ) {
+   kernel_choice().kernel( entries, count, counts );
+}
+
+
+RelocationBlock RelocationTable::block_at( const uint32_t offset, uint32_t& block_size ) const {
+   const char* header = image_.read( directory_.virtual_address + offset, BLOCK_HEADER_SIZE );
+   block_size = load_le<uint32_t>( header + 4 );
+   if( block_size == 0 ) {
+      return {};
+   }
+   if( block_size < BLOCK_HEADER_SIZE ) {
+      throw domain_error( "A base relocation block is smaller than its header" );
+   }
+   if( block_size > directory_.size - offset ) {
+      throw domain_error( "A base relocation block runs past the end of the table" );
+   }
+
+   RelocationBlock block;
+   block.page_rva          = load_le<uint32_t>( header );
+   block.number_of_entries = ( block_size - BLOCK_HEADER_SIZE ) / 2;
+   if( block.number_of_entries > 0 ) {
+      block.entries = image_.read( directory_.virtual_address + offset + BLOCK_HEADER_SIZE, size_t{ block.number_of_entries } * 2 );
+   }
+   return block;
+} // block_at()
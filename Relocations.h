@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Walk the base relocation table of a PE image
+///
+/// The `.reloc` data is a run of blocks, one per 4K page that has fixups.
+/// Each block is an 8-byte `IMAGE_BASE_RELOCATION` header (the page RVA and
+/// the size of the block) followed by 16-bit entries: the type in the top
+/// 4 bits and the offset into the page in the rest.  A block's entries are
+/// viewed in place and their types are counted with the widest kernel that
+/// the CPU supports (almost every entry is `IMAGE_REL_BASED_DIR64` or
+/// `IMAGE_REL_BASED_HIGHLOW`, plus `IMAGE_REL_BASED_ABSOLUTE` padding, so
+/// the kernels compare whole vectors against those and only fall back to
+/// one entry at a time for the rare block that has something else).
+///
+/// @see https://learn.microsoft.com/en-us/windows/win32/debug/pe-format#the-reloc-section-image-only
+///
+/// @file   Relocations.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <array>    // For array
+#include <cstddef>  // For size_t
+#include <cstdint>  // For uint16_t uint32_t uint64_t
+
+#include "HeaderView.h"
+#include "ImageReader.h"
+
+
+/// The number of relocation types (the top 4 bits of an entry)
+inline constexpr size_t RELOCATION_TYPES = 16;
+
+// The relocation types that the kernels count a vector at a time
+inline constexpr uint16_t IMAGE_REL_BASED_ABSOLUTE = 0;   ///< Padding (an entry that doesn't fix up anything)
+inline constexpr uint16_t IMAGE_REL_BASED_HIGHLOW  = 3;   ///< A 32-bit fixup (PE32)
+inline constexpr uint16_t IMAGE_REL_BASED_DIR64    = 10;  ///< A 64-bit fixup (PE32+)
+
+/// The number of entries of each type
+using RelocationCounts = std::array<uint64_t, RELOCATION_TYPES>;
+
+
+/// One block of the base relocation table (the fixups for one page)
+struct RelocationBlock {
+   uint32_t    page_rva          { 0 };        ///< The page that the entries are offsets into
+   uint32_t    number_of_entries { 0 };        ///< The number of 16-bit entries
+   const char* entries           { nullptr };  ///< The entries (a view into the ByteSource)
+};
+
+
+/// What the whole base relocation table holds
+struct RelocationSummary {
+   uint32_t         blocks { 0 };  ///< The number of blocks (pages with fixups)
+   RelocationCounts types  {};     ///< The number of entries of each type
+};
+
+
+/// Add the types of the `count` 16-bit entries at `entries` to `counts`
+extern void count_relocation_types( const char* entries, size_t count, RelocationCounts& counts );
+
+/// @return The name of the kernel that count_relocation_types() uses on this CPU
+extern const char* relocation_kernel_name();
+
+
+/// The base relocation table of a PEFile
+class RelocationTable {
+protected:
+   ImageReader   image_;      ///< Where to read the blocks
+   DataDirectory directory_;  ///< The Base Relocation Table entry in the data directory
+
+   /// @return The block that starts `offset` bytes into the table (its
+   ///         size in bytes is in `block_size`, or 0 at zero padding)
+   /// @throws domain_error if the block is too small or runs past the end of the table
+   RelocationBlock block_at( uint32_t offset, uint32_t& block_size ) const;
+
+public:
+   /// View the base relocation table described by `directory` (nothing is read yet)
+   ///
+   /// @param image     Where to read the image
+   /// @param directory The Base Relocation Table entry from the data directory
+   RelocationTable( const ImageReader& image, const DataDirectory& directory )
+         :image_    ( image )      // Member initialization
+         ,directory_( directory )  // Member initialization
+   {}
+
+   bool empty() const {
+      return directory_.size == 0;  /// @return `true` if the image has no base relocations
+   }
+
+   /// Call `visit( block )` for each block, in order
+   ///
+   /// The walk stops at the end of the table or at a block with a size of 0
+   /// (some linkers pad the table with zeros).
+   ///
+   /// @throws domain_error if a block is malformed
+   /// @throws out_of_range if a block isn't in the file
+   template <typename VISITOR>
+   void for_each_block( VISITOR visit ) const {
+      uint32_t offset = 0;
+      while( !empty() && directory_.size - offset >= 8 ) {
+         uint32_t              block_size;
+         const RelocationBlock block = block_at( offset, block_size );
+         if( block_size == 0 ) {
+            break;
+         }
+         visit( block );
+         offset += block_size;
+      }
+   }
+}; // RelocationTable
@@ -0,0 +1,886 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Write a report in one of several formats
+///
+/// @file   ReportWriter.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>   // For min()
+#include <cstring>     // For memcpy() strchr() strcmp()
+#include <functional>  // For less
+#include <stdexcept>   // For logic_error
+
+#include "Format.h"
+#include "ReportWriter.h"
+
+using namespace std;
+
+
+/// How each Group is written
+struct GroupFormat {
+   const char* title;     ///< The heading in the text format (with its newline)
+   const char* key;       ///< The key in JSON
+   bool        is_array;  ///< `true` if it's a list in JSON
+};
+
+
+/// The formats of each Group (in the order of Group)
+static constexpr GroupFormat GROUP_FORMATS[] = {
+    { "DOS Header\n",       "dos",              false }
+   ,{ "COFF/File header\n", "coff",             false }
+   ,{ "Optional header\n",  "optional",         false }
+   ,{ "Data directories\n", "data_directories", true  }
+   ,{ "Sections\n",         "sections",         true  }
+   ,{ "    Section\n",      "section",          false }
+   ,{ "Imports\n",          "imports",          true  }
+   ,{ "Exports\n",          "exports",          false }
+   ,{ "Named exports\n",    "named_exports",    true  }
+   ,{ "Export lookup\n",    "export_lookup",    true  }
+   ,{ "Resources\n",        "resources",        true  }
+   ,{ "Base relocations\n", "relocations",      false }
+   ,{ "    Pages\n",        "pages",            true  }
+   ,{ "Debug directory\n",  "debug",            true  }
+   ,{ "    Debug entry\n",  "debug_entry",      false }
+   ,{ "Overlay\n",          "overlay",          false }
+   ,{ "    Signatures\n",   "signatures",       true  }
+   ,{ "Hashes\n",           "hashes",           false }
+};
+
+static_assert( sizeof( GROUP_FORMATS ) / sizeof( GROUP_FORMATS[0] ) == static_cast<size_t>( Group::HASHES ) + 1 );
+
+
+/// @return How `group` is written
+static const GroupFormat& format_of( const Group group ) {
+   return GROUP_FORMATS[ static_cast<size_t>( group ) ];
+}
+
+
+/// Append what `function` resolves to (for the export table and lookups)
+static void append_export( string& out, const ExportedFunction& function ) {
+   out.append( "ordinal " );
+   append_dec( out, function.ordinal );
+   if( function.forwarder.empty() ) {
+      out.append( ", " );
+      append_hex( out, function.rva );
+   } else {
+      out.append( " -> " );
+      out.append( function.forwarder );
+   }
+}
+
+
+/// Append the name of relocation type `type` (or its number if it has no name)
+static void append_relocation_type( string& out, const size_t type ) {
+   const char* type_name = RELOCATION_TYPE_FLAGS.lookup( type );
+   if( type_name != nullptr ) {
+      out.append( type_name );
+   } else {
+      append_dec( out, type );
+   }
+}
+
+
+/// Unpack a field that's characters padded with NULs (like a section name)
+///
+/// @param field      The field
+/// @param value      Its value
+/// @param characters Where to unpack the characters
+/// @return The characters up to the first NUL
+static string_view characters_of( const FieldDescriptor& field, const uint64_t value, char (&characters)[8] ) {
+   size_t length = 0;
+   while( length < field.width && length < sizeof( characters ) && static_cast<char>( value >> ( length * 8 ) ) != '\0' ) {
+      characters[ length ] = static_cast<char>( value >> ( length * 8 ) );
+      length++;
+   }
+   return string_view( characters, length );
+}
+
+
+/////////////////////////////////// Text ///////////////////////////////////
+
+void TextReportWriter::begin_file( string_view ) {}  // The text format has no per-file header
+
+void TextReportWriter::end_file() {}
+
+void TextReportWriter::fail( string_view, string_view ) {}  // The failure is reported on stderr
+
+void TextReportWriter::skip( string_view ) {}  // The skip is counted in the summary
+
+
+void TextReportWriter::begin_group( const Group group ) {
+   out_.append( format_of( group ).title );
+}
+
+
+void TextReportWriter::end_group( const Group group ) {
+   if( group == Group::SECTION ) {
+      out_.put( '\n' );
+   }
+}
+
+
+void TextReportWriter::field( const FieldDescriptor& field, const uint64_t value ) {
+   format_field( out_.buffer(), field, value );
+}
+
+
+void TextReportWriter::text( const char*, const string_view label, const string_view value ) {
+   append_label( out_.buffer(), label );
+   out_.append( value );
+   out_.put( '\n' );
+}
+
+
+void TextReportWriter::digest( const char*, const string_view label, const uint8_t* bytes, const size_t length ) {
+   append_label( out_.buffer(), label );
+   append_hex_bytes( out_.buffer(), bytes, length );
+   out_.put( '\n' );
+}
+
+
+void TextReportWriter::entropy( const double bits, const size_t length ) {
+   append_label( out_.buffer(), "    Entropy" );
+   append_fixed( out_.buffer(), bits, 6 );
+   out_.append( " bits per byte (" );
+   append_dec( out_.buffer(), length );
+   out_.append( " bytes)\n" );
+}
+
+
+void TextReportWriter::data_directory( const size_t index, const DataDirectory& directory ) {
+   append_label( out_.buffer(), DATA_DIRECTORY_NAMES[ index ] );
+   append_hex_or_zero( out_.buffer(), directory.virtual_address );
+   out_.append( " (" );
+   append_dec( out_.buffer(), directory.size );
+   out_.append( " bytes)\n" );
+}
+
+
+void TextReportWriter::begin_import( const string_view dll_name ) {
+   out_.append( "    " );
+   out_.append( dll_name );
+   out_.put( '\n' );
+}
+
+
+void TextReportWriter::end_import() {}
+
+
+void TextReportWriter::imported_function( const ImportedFunction& function ) {
+   if( function.by_ordinal ) {
+      out_.append( "        Ordinal " );
+      append_dec( out_.buffer(), function.ordinal );
+   } else {
+      out_.append( "        " );
+      out_.append( function.name );
+      out_.append( " (hint " );
+      append_dec( out_.buffer(), function.hint );
+      out_.put( ')' );
+   }
+   out_.put( '\n' );
+}
+
+
+void TextReportWriter::named_export( const string_view name, const optional<ExportedFunction>& function ) {
+   out_.append( "        " );
+   out_.append( name );
+   out_.append( " (" );
+   if( function ) {
+      append_export( out_.buffer(), *function );
+   } else {
+      out_.append( "no address" );
+   }
+   out_.append( ")\n" );
+}
+
+
+void TextReportWriter::export_lookup( const string_view query, const optional<ExportedFunction>& function ) {
+   append_label( out_.buffer(), query );
+   if( function ) {
+      append_export( out_.buffer(), *function );
+   } else {
+      out_.append( "not found" );
+   }
+   out_.put( '\n' );
+}
+
+
+void TextReportWriter::resource( const ResourceEntry& type, const ResourceEntry& name, const ResourceEntry& language, const ResourceData& data ) {
+   string& out = out_.buffer();
+   out.append( "    " );
+   append_resource_id( out, type, true );
+   out.push_back( '/' );
+   append_resource_id( out, name, false );
+   out.push_back( '/' );
+   append_resource_id( out, language, false );
+   out.append( " (" );
+   append_dec( out, data.size );
+   out.append( " bytes at " );
+   append_hex( out, data.rva );
+   out.append( ", code page " );
+   append_dec( out, data.code_page );
+   out.append( ")\n" );
+}
+
+
+void TextReportWriter::relocation_page( const uint32_t page_rva, const uint64_t fixups ) {
+   string& out = out_.buffer();
+   out.append( "        " );
+   append_hex( out, page_rva );
+   out.append( ": " );
+   append_dec( out, fixups );
+   out.append( " fixups\n" );
+}
+
+
+void TextReportWriter::relocation_summary( const RelocationSummary& summary ) {
+   string& out = out_.buffer();
+   append_label( out, "Blocks" );
+   append_dec( out, summary.blocks );
+   out.push_back( '\n' );
+   for( size_t type = 0 ; type < RELOCATION_TYPES ; type++ ) {
+      if( summary.types[ type ] == 0 ) {
+         continue;
+      }
+      thread_local string type_name;  // Reused, so it stops allocating once it's grown
+      type_name.clear();
+      append_relocation_type( type_name, type );
+      append_label( out, type_name );
+      append_dec( out, summary.types[ type ] );
+      out.push_back( '\n' );
+   }
+}
+
+
+void TextReportWriter::codeview( const CodeViewInfo& info ) {
+   string& out = out_.buffer();
+   append_label( out, "    PDB path" );
+   out.append( info.pdb_path );
+   out.push_back( '\n' );
+   append_label( out, "    PDB GUID" );
+   append_guid( out, info );
+   out.push_back( '\n' );
+   append_label( out, "    PDB age" );
+   append_dec( out, info.age );
+   out.push_back( '\n' );
+   append_label( out, "    Symbol server key" );
+   append_pdb_signature( out, info );
+   out.push_back( '\n' );
+}
+
+
+void TextReportWriter::overlay( const OverlayInfo& info ) {
+   string& out = out_.buffer();
+   append_label( out, "Offset" );
+   append_hex( out, info.offset );
+   out.push_back( '\n' );
+   append_label( out, "Size" );
+   append_dec( out, info.size );
+   out.append( " bytes\n" );
+   if( info.certificate_size > 0 ) {
+      append_label( out, "Certificate Table" );
+      append_dec( out, info.certificate_size );
+      out.append( " bytes\n" );
+   }
+}
+
+
+void TextReportWriter::overlay_signature( const OverlaySignature& signature, const OverlayMatch& match ) {
+   thread_local string label;  // Reused, so it stops allocating once it's grown
+   label.assign( "    " );
+   label.append( signature.name );
+
+   string& out = out_.buffer();
+   append_label( out, label );
+   append_hex( out, match.first );
+   out.append( " (" );
+   append_dec( out, match.count );
+   out.append( match.count == 1 ? " match)\n" : " matches)\n" );
+}
+
+
+/////////////////////////////////// JSON ///////////////////////////////////
+
+void JsonReportWriter::separate() {
+   if( depth_ == 0 ) {
+      return;
+   }
+   if( !is_empty_[ depth_ - 1 ] ) {
+      out_.put( ',' );
+   }
+   is_empty_[ depth_ - 1 ] = false;
+}
+
+
+void JsonReportWriter::key( const string_view name, const string_view suffix ) {
+   separate();
+   if( depth_ > 0 && is_array_[ depth_ - 1 ] ) {
+      return;  // Array elements don't have keys
+   }
+   out_.put( '"' );
+   out_.append( name );
+   out_.append( suffix );
+   out_.append( "\":" );
+}
+
+
+void JsonReportWriter::open( const char bracket ) {
+   if( depth_ == MAX_DEPTH ) {
+      throw logic_error( "The JSON report is nested too deeply" );
+   }
+   out_.put( bracket );
+   is_array_[ depth_ ] = bracket == '[';
+   is_empty_[ depth_ ] = true;
+   depth_++;
+}
+
+
+void JsonReportWriter::close() {
+   depth_--;
+   out_.put( is_array_[ depth_ ] ? ']' : '}' );
+}
+
+
+void JsonReportWriter::string_value( const string_view value ) {
+   static constexpr char DIGITS[] = "0123456789abcdef";
+
+   out_.put( '"' );
+   size_t run_start = 0;  // Copy runs of characters that don't need escaping all at once
+   for( size_t i = 0 ; i < value.size() ; i++ ) {
+      const unsigned char character = static_cast<unsigned char>( value[i] );
+      if( character >= 0x20 && character < 0x7F && character != '"' && character != '\\' ) {
+         continue;
+      }
+      out_.append( value.substr( run_start, i - run_start ) );
+      run_start = i + 1;
+      if( character == '"' || character == '\\' ) {
+         out_.put( '\\' );
+         out_.put( static_cast<char>( character ) );
+      } else {
+         out_.append( "\\u00" );
+         out_.put( DIGITS[ character >> 4 ] );
+         out_.put( DIGITS[ character & 0x0F ] );
+      }
+   }
+   out_.append( value.substr( run_start ) );
+   out_.put( '"' );
+}
+
+
+void JsonReportWriter::member( const string_view name, const uint64_t value ) {
+   key( name );
+   append_dec( out_.buffer(), value );
+}
+
+
+void JsonReportWriter::member( const string_view name, const string_view value ) {
+   key( name );
+   string_value( value );
+}
+
+
+void JsonReportWriter::export_members( const ExportedFunction& function ) {
+   member( "ordinal", function.ordinal );
+   if( function.forwarder.empty() ) {
+      member( "rva", function.rva );
+   } else {
+      member( "forwarder", function.forwarder );
+   }
+}
+
+
+void JsonReportWriter::begin_file( const string_view path ) {
+   depth_ = 0;
+   open( '{' );
+   member( "path", path );
+}
+
+
+void JsonReportWriter::end_file() {
+   while( depth_ > 0 ) {
+      close();
+   }
+   out_.put( '\n' );
+}
+
+
+void JsonReportWriter::fail( const string_view stage, const string_view reason ) {
+   while( depth_ > 1 ) {  // Close whatever was being written when it failed
+      close();
+   }
+   key( "error" );
+   open( '{' );
+   member( "stage",  stage );
+   member( "reason", reason );
+   close();
+   end_file();
+}
+
+
+void JsonReportWriter::skip( const string_view reason ) {
+   member( "skipped", reason );
+   end_file();
+}
+
+
+void JsonReportWriter::begin_group( const Group group ) {
+   const GroupFormat& format = format_of( group );
+   key( format.key );
+   open( format.is_array ? '[' : '{' );
+}
+
+
+void JsonReportWriter::end_group( Group ) {
+   close();
+}
+
+
+void JsonReportWriter::field( const FieldDescriptor& field, const uint64_t value ) {
+   const char*       separator = strchr( field.label, '_' );
+   const string_view name      = separator != nullptr ? separator + 1 : field.label;
+
+   key( name );
+   if( field.rules & AS_CHAR && !( field.rules & AS_HEX ) ) {
+      char characters[8];
+      string_value( characters_of( field, value, characters ) );
+   } else {
+      append_dec( out_.buffer(), value );
+   }
+
+   if( field.rules & WITH_FLAG ) {
+      key( name, "_name" );
+      const char* flag_name = field.flags->lookup( value );
+      if( flag_name != nullptr ) {
+         string_value( flag_name );
+      } else {
+         out_.append( "null" );
+      }
+   }
+
+   if( field.rules & WITH_FLAGS ) {
+      key( name, "_names" );
+      open( '[' );
+      field.flags->for_each_set( value, [this]( const char* flag_name, uint64_t ) {
+         separate();
+         if( flag_name != nullptr ) {
+            string_value( flag_name );
+         } else {
+            out_.append( "null" );
+         }
+      } );
+      close();
+   }
+} // JsonReportWriter::field()
+
+
+void JsonReportWriter::text( const char* key_name, string_view, const string_view value ) {
+   member( key_name, value );
+}
+
+
+void JsonReportWriter::digest( const char* key_name, string_view, const uint8_t* bytes, const size_t length ) {
+   key( key_name );
+   out_.put( '"' );
+   append_hex_bytes( out_.buffer(), bytes, length );
+   out_.put( '"' );
+}
+
+
+void JsonReportWriter::entropy( const double bits, const size_t length ) {
+   key( "entropy" );
+   open( '{' );
+   key( "bits_per_byte" );
+   append_fixed( out_.buffer(), bits, 6 );
+   member( "bytes", length );
+   close();
+}
+
+
+void JsonReportWriter::data_directory( const size_t index, const DataDirectory& directory ) {
+   separate();
+   open( '{' );
+   member( "name",            DATA_DIRECTORY_NAMES[ index ] );
+   member( "virtual_address", directory.virtual_address );
+   member( "size",            directory.size );
+   close();
+}
+
+
+void JsonReportWriter::begin_import( const string_view dll_name ) {
+   separate();
+   open( '{' );
+   member( "dll", dll_name );
+   key( "functions" );
+   open( '[' );
+}
+
+
+void JsonReportWriter::end_import() {
+   close();
+   close();
+}
+
+
+void JsonReportWriter::imported_function( const ImportedFunction& function ) {
+   separate();
+   open( '{' );
+   if( function.by_ordinal ) {
+      member( "ordinal", function.ordinal );
+   } else {
+      member( "name", function.name );
+      member( "hint", function.hint );
+   }
+   member( "iat_rva", function.iat_rva );
+   close();
+}
+
+
+void JsonReportWriter::named_export( const string_view name, const optional<ExportedFunction>& function ) {
+   separate();
+   open( '{' );
+   member( "name", name );
+   if( function ) {
+      export_members( *function );
+   }
+   close();
+}
+
+
+void JsonReportWriter::export_lookup( const string_view query, const optional<ExportedFunction>& function ) {
+   separate();
+   open( '{' );
+   member( "query", query );
+   key( "found" );
+   out_.append( function ? "true" : "false" );
+   if( function ) {
+      export_members( *function );
+   }
+   close();
+}
+
+
+void JsonReportWriter::resource( const ResourceEntry& type, const ResourceEntry& name, const ResourceEntry& language, const ResourceData& data ) {
+   const auto id_member = [this]( const string_view member_name, const ResourceEntry& entry, const bool is_type ) {
+      thread_local string id;  // Reused, so it stops allocating once it's grown
+      id.clear();
+      append_resource_id( id, entry, is_type );
+      member( member_name, string_view( id ) );
+   };
+
+   separate();
+   open( '{' );
+   id_member( "type",     type,     true  );
+   id_member( "name",     name,     false );
+   id_member( "language", language, false );
+   member( "rva",       data.rva );
+   member( "size",      data.size );
+   member( "code_page", data.code_page );
+   close();
+}
+
+
+void JsonReportWriter::relocation_page( const uint32_t page_rva, const uint64_t fixups ) {
+   separate();
+   open( '{' );
+   member( "page_rva", page_rva );
+   member( "fixups",   fixups );
+   close();
+}
+
+
+void JsonReportWriter::relocation_summary( const RelocationSummary& summary ) {
+   member( "blocks", summary.blocks );
+   key( "types" );
+   open( '{' );
+   for( size_t type = 0 ; type < RELOCATION_TYPES ; type++ ) {
+      if( summary.types[ type ] == 0 ) {
+         continue;
+      }
+      thread_local string type_name;  // Reused, so it stops allocating once it's grown
+      type_name.clear();
+      append_relocation_type( type_name, type );
+      member( type_name, summary.types[ type ] );
+   }
+   close();
+}
+
+
+void JsonReportWriter::codeview( const CodeViewInfo& info ) {
+   thread_local string text;  // Reused, so it stops allocating once it's grown
+
+   key( "codeview" );
+   open( '{' );
+   member( "pdb_path", info.pdb_path );
+   text.clear();
+   append_guid( text, info );
+   member( "guid", string_view( text ) );
+   member( "age", info.age );
+   text.clear();
+   append_pdb_signature( text, info );
+   member( "symbol_server_key", string_view( text ) );
+   close();
+}
+
+
+void JsonReportWriter::overlay( const OverlayInfo& info ) {
+   member( "offset",           info.offset );
+   member( "size",             info.size );
+   member( "certificate_size", info.certificate_size );
+}
+
+
+void JsonReportWriter::overlay_signature( const OverlaySignature& signature, const OverlayMatch& match ) {
+   separate();
+   open( '{' );
+   member( "name",   string_view( signature.name ) );
+   member( "offset", match.first );
+   member( "count",  match.count );
+   close();
+}
+
+
+////////////////////////////////// Binary //////////////////////////////////
+
+/// The string table of the record that this thread is writing (reused from file to file)
+static thread_local string binary_strings;
+
+
+/// Where each field of OPTIONAL64_LAYOUT goes in BinaryRecord::optional
+static constexpr array<size_t, OPTIONAL64_LAYOUT.size()> PE32_PLUS_FIELDS = [] {
+   array<size_t, OPTIONAL64_LAYOUT.size()> indexes {};
+   for( size_t i = 0 ; i < OPTIONAL64_LAYOUT.size() ; i++ ) {
+      indexes[i] = field_index( OPTIONAL32_LAYOUT, OPTIONAL64_LAYOUT[i].label );
+   }
+   return indexes;
+}();
+
+static_assert( find( PE32_PLUS_FIELDS.begin(), PE32_PLUS_FIELDS.end(), OPTIONAL32_LAYOUT.size() ) == PE32_PLUS_FIELDS.end()
+              ,"Every PE32+ field must have a place in the PE32 layout" );
+
+
+/// @return The index of `field` in `layout` (or `SIZE` if it isn't one of its fields)
+template <size_t SIZE>
+static size_t index_in( const array<FieldDescriptor, SIZE>& layout, const FieldDescriptor& field ) {
+   const less<const FieldDescriptor*> before;
+   if( before( &field, layout.data() ) || !before( &field, layout.data() + SIZE ) ) {
+      return SIZE;
+   }
+   return static_cast<size_t>( &field - layout.data() );
+}
+
+
+BinaryReportWriter::BinaryReportWriter( OutputSink& out )
+      :ReportWriter( out )           // Member initialization
+      ,record_     {}                // Member initialization
+      ,section_    {}                // Member initialization
+      ,strings_    ( binary_strings )  // Member initialization
+{}
+
+
+uint32_t BinaryReportWriter::here() const {
+   return static_cast<uint32_t>( out_.size() - base_ );
+}
+
+
+uint32_t BinaryReportWriter::add_string( const string_view text ) {
+   const uint32_t offset = static_cast<uint32_t>( strings_.size() );
+   strings_.append( text );
+   strings_.push_back( '\0' );
+   return offset;
+}
+
+
+void BinaryReportWriter::append( const void* data, const size_t size ) {
+   out_.append( string_view( static_cast<const char*>( data ), size ) );
+}
+
+
+void BinaryReportWriter::begin_file( const string_view path ) {
+   base_ = out_.size();
+   strings_.clear();
+
+   record_ = {};
+   record_.magic           = BINARY_RECORD_MAGIC;
+   record_.version         = BINARY_RECORD_VERSION;
+   record_.error_stage     = NO_STRING;
+   record_.error_reason    = NO_STRING;
+   record_.export_dll_name = NO_STRING;
+   record_.path            = add_string( path );
+
+   append( &record_, sizeof( record_ ) );  // Hold its place until end_file()
+   record_.sections_offset = here();
+   record_.imports_offset  = here();
+   record_.exports_offset  = here();
+}
+
+
+void BinaryReportWriter::end_file() {
+   record_.strings_offset = here();
+   record_.strings_size   = static_cast<uint32_t>( strings_.size() );
+   out_.append( strings_ );
+   out_.buffer().append( ( 8 - here() % 8 ) % 8, '\0' );
+   record_.size = here();
+
+   memcpy( out_.buffer().data() + base_, &record_, sizeof( record_ ) );
+}
+
+
+void BinaryReportWriter::fail( const string_view stage, const string_view reason ) {
+   in_section_ = false;  // A section that was cut short isn't written
+   record_.flags       |= RECORD_FAILED;
+   record_.error_stage  = add_string( stage );
+   record_.error_reason = add_string( reason );
+   end_file();
+}
+
+
+void BinaryReportWriter::skip( const string_view reason ) {
+   record_.flags        |= RECORD_SKIPPED;
+   record_.error_reason  = add_string( reason );
+   end_file();
+}
+
+
+void BinaryReportWriter::begin_group( const Group group ) {
+   switch( group ) {
+      case Group::OPTIONAL_HEADER:
+         record_.flags |= RECORD_HAS_OPTIONAL;
+         break;
+      case Group::SECTIONS:
+         record_.sections_offset = here();
+         break;
+      case Group::SECTION:
+         section_      = {};
+         section_.name = NO_STRING;
+         in_section_   = true;
+         break;
+      case Group::IMPORTS:
+         record_.imports_offset = here();
+         break;
+      case Group::EXPORTS:
+         record_.flags |= RECORD_HAS_EXPORTS;
+         break;
+      case Group::NAMED_EXPORTS:
+         record_.exports_offset = here();
+         break;
+      default:
+         break;
+   }
+}
+
+
+void BinaryReportWriter::end_group( const Group group ) {
+   if( group == Group::SECTION ) {
+      append( &section_, sizeof( section_ ) );
+      record_.number_of_sections++;
+      in_section_ = false;
+   }
+}
+
+
+void BinaryReportWriter::field( const FieldDescriptor& field, const uint64_t value ) {
+   size_t index;
+   if( ( index = index_in( SECTION_LAYOUT, field ) ) < SECTION_LAYOUT.size() ) {
+      section_.fields[ index ] = value;
+      if( index == SECTION_NAME ) {
+         char characters[8];
+         section_.name = add_string( characters_of( field, value, characters ) );
+      }
+   } else if( ( index = index_in( DOS_LAYOUT, field ) ) < DOS_LAYOUT.size() ) {
+      record_.dos[ index ] = value;
+   } else if( ( index = index_in( COFF_LAYOUT, field ) ) < COFF_LAYOUT.size() ) {
+      record_.coff[ index ] = value;
+   } else if( ( index = index_in( OPTIONAL32_LAYOUT, field ) ) < OPTIONAL32_LAYOUT.size() ) {
+      record_.optional[ index ] = value;
+   } else if( ( index = index_in( OPTIONAL64_LAYOUT, field ) ) < OPTIONAL64_LAYOUT.size() ) {
+      record_.optional[ PE32_PLUS_FIELDS[ index ] ] = value;
+      record_.flags |= RECORD_PE32_PLUS;
+   } else if( ( index = index_in( EXPORT_LAYOUT, field ) ) < EXPORT_LAYOUT.size() ) {
+      record_.export_directory[ index ] = value;
+   }
+} // BinaryReportWriter::field()
+
+
+void BinaryReportWriter::text( const char* key_name, string_view, const string_view value ) {
+   if( strcmp( key_name, "dll_name" ) == 0 ) {
+      record_.export_dll_name = add_string( value );
+   }
+}
+
+
+void BinaryReportWriter::digest( const char* key_name, string_view, const uint8_t* bytes, const size_t length ) {
+   if( in_section_ ) {
+      memcpy( section_.sha256, bytes, min( length, sizeof( section_.sha256 ) ) );
+      section_.flags |= SECTION_HAS_SHA256;
+   } else if( strcmp( key_name, "sha256" ) == 0 ) {
+      memcpy( record_.sha256, bytes, min( length, sizeof( record_.sha256 ) ) );
+      record_.flags |= RECORD_HAS_SHA256;
+   } else if( strcmp( key_name, "imphash" ) == 0 ) {
+      memcpy( record_.imphash, bytes, min( length, sizeof( record_.imphash ) ) );
+      record_.flags |= RECORD_HAS_IMPHASH;
+   }
+}
+
+
+void BinaryReportWriter::entropy( const double bits, const size_t length ) {
+   section_.entropy       = bits;
+   section_.entropy_bytes = length;
+   section_.flags        |= SECTION_HAS_ENTROPY;
+}
+
+
+void BinaryReportWriter::data_directory( const size_t index, const DataDirectory& directory ) {
+   record_.data_directories[ index ]   = directory;
+   record_.number_of_data_directories = static_cast<uint32_t>( index + 1 );
+}
+
+
+void BinaryReportWriter::begin_import( const string_view dll_name ) {
+   dll_ = add_string( dll_name );
+}
+
+
+void BinaryReportWriter::end_import() {}
+
+
+void BinaryReportWriter::imported_function( const ImportedFunction& function ) {
+   const BinaryImport import {
+       dll_
+      ,function.by_ordinal ? NO_STRING : add_string( function.name )
+      ,function.iat_rva
+      ,function.by_ordinal ? function.ordinal : function.hint
+      ,0
+   };
+   append( &import, sizeof( import ) );
+   record_.number_of_imports++;
+}
+
+
+void BinaryReportWriter::named_export( const string_view name, const optional<ExportedFunction>& function ) {
+   const BinaryExport named {
+       add_string( name )
+      ,function && !function->forwarder.empty() ? add_string( function->forwarder ) : NO_STRING
+      ,function ? function->ordinal : 0
+      ,function ? function->rva     : 0
+   };
+   append( &named, sizeof( named ) );
+   record_.number_of_exports++;
+}
+
+
+void BinaryReportWriter::export_lookup( string_view, const optional<ExportedFunction>& ) {}  // Not part of the layout
+
+void BinaryReportWriter::resource( const ResourceEntry&, const ResourceEntry&, const ResourceEntry&, const ResourceData& ) {}  // Not part of the layout
+
+void BinaryReportWriter::relocation_page( uint32_t, uint64_t ) {}  // Not part of the layout
+
+void BinaryReportWriter::relocation_summary( const RelocationSummary& ) {}  // Not part of the layout
+
+void BinaryReportWriter::codeview( const CodeViewInfo& ) {}  // Not part of the layout
+
+void BinaryReportWriter::overlay( const OverlayInfo& ) {}  // Not part of the layout
+
+void BinaryReportWriter::overlay_signature( const OverlaySignature&, const OverlayMatch& ) {}  // Not part of the layout
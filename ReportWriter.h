@@ -0,0 +1,346 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Write a report in one of several formats
+///
+/// PEFile::print() describes what it finds to a ReportWriter: the groups
+/// of fields, the fields themselves and the few things (imports, exports,
+/// digests) that aren't header fields.  The writer decides what that looks
+/// like.  TextReportWriter prints the padded layout that readpe has always
+/// printed.  JsonReportWriter prints one JSON object per file on one line
+/// (NDJSON), so a batch of files is a stream of records.  BinaryReportWriter
+/// writes the fixed-layout records in BinaryRecord.h.
+///
+/// They all format straight into the file's OutputSink.  There is no
+/// document model and nothing is allocated once the sink has grown to fit a
+/// report.
+///
+/// @file   ReportWriter.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <bit>          // For countr_zero()
+#include <cstddef>      // For size_t
+#include <cstdint>      // For uint8_t uint64_t
+#include <optional>     // For optional
+#include <string>       // For string
+#include <string_view>  // For string_view
+
+#include "BinaryRecord.h"
+#include "DebugDirectory.h"
+#include "Exports.h"
+#include "HeaderView.h"
+#include "Imports.h"
+#include "OutputSink.h"
+#include "Overlay.h"
+#include "Relocations.h"
+#include "Resources.h"
+
+
+/// How to write a report
+enum class ReportFormat {
+    TEXT    ///< The human-readable layout
+   ,JSON    ///< One JSON object per file, one per line
+   ,BINARY  ///< One BinaryRecord per file
+};
+
+
+/// The parts of a report that hold other parts
+enum class Group {
+    DOS_HEADER        ///< The DOS header's fields
+   ,COFF_HEADER       ///< The COFF/File header's fields
+   ,OPTIONAL_HEADER   ///< The optional header's fields (and its data directories)
+   ,DATA_DIRECTORIES  ///< A list of data directory entries
+   ,SECTIONS          ///< A list of sections
+   ,SECTION           ///< One section's fields (and its analyses)
+   ,IMPORTS           ///< A list of imported DLLs
+   ,EXPORTS           ///< The export directory's fields
+   ,NAMED_EXPORTS     ///< A list of named exports
+   ,EXPORT_LOOKUP     ///< A list of export lookups
+   ,RESOURCES         ///< A list of the leaves of the resource tree
+   ,RELOCATIONS       ///< The summary of the base relocation table (and its pages)
+   ,RELOCATION_PAGES  ///< A list of the pages that have base relocations
+   ,DEBUG             ///< A list of debug directory entries
+   ,DEBUG_ENTRY       ///< One debug directory entry's fields (and its CodeView record)
+   ,OVERLAY           ///< Where the overlay is (and what's in it)
+   ,OVERLAY_MATCHES   ///< A list of the payloads found in the overlay
+   ,HASHES            ///< The digests of the whole file
+};
+
+
+/// Receives the contents of a report and writes them to an OutputSink
+///
+/// The calls nest: every begin_group() has a matching end_group(), and the
+/// whole report is between begin_file() and end_file().
+class ReportWriter {
+protected:
+   OutputSink& out_;  ///< Where the report goes
+
+public:
+   /// Write to `out`
+   explicit ReportWriter( OutputSink& out )
+         :out_( out )  // Member initialization
+   {}
+
+   virtual ~ReportWriter() = default;
+
+   /// Start the report for the file at `path`
+   virtual void begin_file( std::string_view path ) = 0;
+
+   /// Finish the report
+   virtual void end_file() = 0;
+
+   /// Finish a report that failed part of the way through
+   ///
+   /// @param stage  What was being done (from stage_name())
+   /// @param reason Why it failed
+   virtual void fail( std::string_view stage, std::string_view reason ) = 0;
+
+   /// Finish the report for a file that was skipped without being parsed
+   /// (like one that `--prefilter` found isn't a PE)
+   ///
+   /// @param reason Why it was skipped
+   virtual void skip( std::string_view reason ) = 0;
+
+   /// Start a group of fields
+   virtual void begin_group( Group group ) = 0;
+
+   /// Finish the most recent group (which is `group`)
+   virtual void end_group( Group group ) = 0;
+
+   /// Write one field of a header
+   virtual void field( const FieldDescriptor& field, uint64_t value ) = 0;
+
+   /// Write the fields in `view` whose bits are set in `mask`
+   ///
+   /// Only those fields are loaded, and the group is checked against the
+   /// end of the file once rather than field by field.  If a field is past
+   /// the end of the file, the fields before it are still written.
+   ///
+   /// @tparam VIEW A HeaderView like DosHeaderView
+   /// @param view The fields
+   /// @param mask Bit `i` selects field `i` (from a FieldProjection)
+   /// @throws out_of_range for the first selected field that's past the end of the file
+   template <typename VIEW>
+   void fields( const VIEW& view, const uint64_t mask = UINT64_MAX ) {
+      const uint64_t selected = mask & VIEW::ALL_FIELDS;
+      const uint64_t missing  = selected & ~view.present();
+      const uint64_t writable = missing == 0 ? selected : selected & ( ( missing & ( ~missing + 1 ) ) - 1 );  // The fields before the first missing one
+      for( uint64_t bits = writable ; bits != 0 ; bits &= bits - 1 ) {
+         const size_t i = static_cast<size_t>( std::countr_zero( bits ) );
+         field( VIEW::layout()[i], view.load( i ) );
+      }
+      if( missing != 0 ) {
+         view.check_field( static_cast<size_t>( std::countr_zero( missing ) ) );
+      }
+   }
+
+   /// Write a value that isn't a header field
+   ///
+   /// @param key   The name for machine-readable formats
+   /// @param label The description for the text format
+   /// @param value The value
+   virtual void text( const char* key, std::string_view label, std::string_view value ) = 0;
+
+   /// Write a digest as hex (a `label` with leading spaces is indented in the text format)
+   virtual void digest( const char* key, std::string_view label, const uint8_t* bytes, size_t length ) = 0;
+
+   /// Write the entropy of a section (`bits` per byte over `length` bytes)
+   virtual void entropy( double bits, size_t length ) = 0;
+
+   /// Write entry `index` of the data directory
+   virtual void data_directory( size_t index, const DataDirectory& directory ) = 0;
+
+   /// Start the functions imported from `dll_name`
+   virtual void begin_import( std::string_view dll_name ) = 0;
+
+   /// Finish the functions imported from a DLL
+   virtual void end_import() = 0;
+
+   /// Write one imported function
+   virtual void imported_function( const ImportedFunction& function ) = 0;
+
+   /// Write one named export (`function` is empty if the name has no address)
+   virtual void named_export( std::string_view name, const std::optional<ExportedFunction>& function ) = 0;
+
+   /// Write the result of looking up `query` (`function` is empty if it wasn't found)
+   virtual void export_lookup( std::string_view query, const std::optional<ExportedFunction>& function ) = 0;
+
+   /// Write one leaf of the resource tree (the entries on its path and where its payload is)
+   virtual void resource( const ResourceEntry& type, const ResourceEntry& name, const ResourceEntry& language, const ResourceData& data ) = 0;
+
+   /// Write the number of fixups (entries other than padding) in one page
+   virtual void relocation_page( uint32_t page_rva, uint64_t fixups ) = 0;
+
+   /// Write the number of blocks and the number of entries of each type in the base relocation table
+   virtual void relocation_summary( const RelocationSummary& summary ) = 0;
+
+   /// Write the PDB that a CodeView entry points at
+   virtual void codeview( const CodeViewInfo& info ) = 0;
+
+   /// Write where the overlay is and how much of it is the Authenticode signature
+   virtual void overlay( const OverlayInfo& info ) = 0;
+
+   /// Write where a payload's signature was found in the overlay
+   virtual void overlay_signature( const OverlaySignature& signature, const OverlayMatch& match ) = 0;
+}; // ReportWriter
+
+
+/// Writes the padded, human-readable layout
+class TextReportWriter : public ReportWriter {
+public:
+   using ReportWriter::ReportWriter;
+
+   void begin_file( std::string_view path ) override;
+   void end_file() override;
+   void fail( std::string_view stage, std::string_view reason ) override;
+   void skip( std::string_view reason ) override;
+   void begin_group( Group group ) override;
+   void end_group( Group group ) override;
+   void field( const FieldDescriptor& field, uint64_t value ) override;
+   void text( const char* key, std::string_view label, std::string_view value ) override;
+   void digest( const char* key, std::string_view label, const uint8_t* bytes, size_t length ) override;
+   void entropy( double bits, size_t length ) override;
+   void data_directory( size_t index, const DataDirectory& directory ) override;
+   void begin_import( std::string_view dll_name ) override;
+   void end_import() override;
+   void imported_function( const ImportedFunction& function ) override;
+   void named_export( std::string_view name, const std::optional<ExportedFunction>& function ) override;
+   void export_lookup( std::string_view query, const std::optional<ExportedFunction>& function ) override;
+   void resource( const ResourceEntry& type, const ResourceEntry& name, const ResourceEntry& language, const ResourceData& data ) override;
+   void relocation_page( uint32_t page_rva, uint64_t fixups ) override;
+   void relocation_summary( const RelocationSummary& summary ) override;
+   void codeview( const CodeViewInfo& info ) override;
+   void overlay( const OverlayInfo& info ) override;
+   void overlay_signature( const OverlaySignature& signature, const OverlayMatch& match ) override;
+}; // TextReportWriter
+
+
+/// Writes one JSON object per file, on one line
+///
+/// A field's key is its label without the leading number (`coff_machine`).
+/// Fields are numbers, except that a field that's only characters (like a
+/// section name) is a string.  A field with a flag also gets `KEY_name`,
+/// and a field with characteristics gets `KEY_names`.  Bytes outside of
+/// printable ASCII are escaped as `\u00XX`, so every record is valid JSON
+/// whatever is in the file.
+class JsonReportWriter : public ReportWriter {
+public:
+   /// The deepest that objects and arrays can nest
+   static constexpr size_t MAX_DEPTH = 16;
+
+protected:
+   size_t depth_ { 0 };          ///< The number of open objects and arrays
+   bool   is_array_[MAX_DEPTH];  ///< `true` if the container at each depth is an array
+   bool   is_empty_[MAX_DEPTH];  ///< `true` until the container at each depth has a member
+
+   /// Write the comma before a member (if it isn't the first)
+   void separate();
+
+   /// Write the comma and `"KEYSUFFIX":` before a member of an object
+   void key( std::string_view name, std::string_view suffix = {} );
+
+   /// Open an object (`{`) or an array (`[`)
+   void open( char bracket );
+
+   /// Close the innermost object or array
+   void close();
+
+   /// Write `value` as a quoted, escaped string
+   void string_value( std::string_view value );
+
+   /// Write the member `"NAME":VALUE`
+   void member( std::string_view name, uint64_t value );
+
+   /// Write the member `"NAME":"VALUE"`
+   void member( std::string_view name, std::string_view value );
+
+   /// Write the `ordinal` and `rva` or `forwarder` of `function`
+   void export_members( const ExportedFunction& function );
+
+public:
+   using ReportWriter::ReportWriter;
+
+   void begin_file( std::string_view path ) override;
+   void end_file() override;
+   void fail( std::string_view stage, std::string_view reason ) override;
+   void skip( std::string_view reason ) override;
+   void begin_group( Group group ) override;
+   void end_group( Group group ) override;
+   void field( const FieldDescriptor& field, uint64_t value ) override;
+   void text( const char* key, std::string_view label, std::string_view value ) override;
+   void digest( const char* key, std::string_view label, const uint8_t* bytes, size_t length ) override;
+   void entropy( double bits, size_t length ) override;
+   void data_directory( size_t index, const DataDirectory& directory ) override;
+   void begin_import( std::string_view dll_name ) override;
+   void end_import() override;
+   void imported_function( const ImportedFunction& function ) override;
+   void named_export( std::string_view name, const std::optional<ExportedFunction>& function ) override;
+   void export_lookup( std::string_view query, const std::optional<ExportedFunction>& function ) override;
+   void resource( const ResourceEntry& type, const ResourceEntry& name, const ResourceEntry& language, const ResourceData& data ) override;
+   void relocation_page( uint32_t page_rva, uint64_t fixups ) override;
+   void relocation_summary( const RelocationSummary& summary ) override;
+   void codeview( const CodeViewInfo& info ) override;
+   void overlay( const OverlayInfo& info ) override;
+   void overlay_signature( const OverlaySignature& signature, const OverlayMatch& match ) override;
+}; // JsonReportWriter
+
+
+/// Writes one BinaryRecord (with its sections, imports, exports and
+/// strings) per file
+///
+/// The record and the section that's being written are filled in here and
+/// copied into the sink when they're complete.  The sections, imports and
+/// exports go into the sink as they arrive (the report always writes them
+/// in that order) and the strings collect in a per-thread buffer that's
+/// appended at the end, so nothing is allocated once the buffers have grown.
+/// Export lookups, resources, relocations, the debug directory and the
+/// overlay aren't part of the layout and are left out.
+class BinaryReportWriter : public ReportWriter {
+protected:
+   BinaryRecord  record_;                     ///< The record for this file
+   BinarySection section_;                    ///< The section that's being written
+   bool          in_section_ { false };       ///< `true` between the begin and end of a Group::SECTION
+   size_t        base_       { 0 };           ///< The offset of the record in the sink
+   uint32_t      dll_        { NO_STRING };   ///< The DLL whose imports are being written
+   std::string&  strings_;                    ///< The string table so far
+
+   /// @return The offset in the sink, from the start of this record
+   uint32_t here() const;
+
+   /// Add `text` to the string table
+   /// @return Its offset in the string table
+   uint32_t add_string( std::string_view text );
+
+   /// Append `size` bytes at `data` to the sink
+   void append( const void* data, size_t size );
+
+public:
+   /// Write to `out`
+   explicit BinaryReportWriter( OutputSink& out );
+
+   void begin_file( std::string_view path ) override;
+   void end_file() override;
+   void fail( std::string_view stage, std::string_view reason ) override;
+   void skip( std::string_view reason ) override;
+   void begin_group( Group group ) override;
+   void end_group( Group group ) override;
+   void field( const FieldDescriptor& field, uint64_t value ) override;
+   void text( const char* key, std::string_view label, std::string_view value ) override;
+   void digest( const char* key, std::string_view label, const uint8_t* bytes, size_t length ) override;
+   void entropy( double bits, size_t length ) override;
+   void data_directory( size_t index, const DataDirectory& directory ) override;
+   void begin_import( std::string_view dll_name ) override;
+   void end_import() override;
+   void imported_function( const ImportedFunction& function ) override;
+   void named_export( std::string_view name, const std::optional<ExportedFunction>& function ) override;
+   void export_lookup( std::string_view query, const std::optional<ExportedFunction>& function ) override;
+   void resource( const ResourceEntry& type, const ResourceEntry& name, const ResourceEntry& language, const ResourceData& data ) override;
+   void relocation_page( uint32_t page_rva, uint64_t fixups ) override;
+   void relocation_summary( const RelocationSummary& summary ) override;
+   void codeview( const CodeViewInfo& info ) override;
+   void overlay( const OverlayInfo& info ) override;
+   void overlay_signature( const OverlaySignature& signature, const OverlayMatch& match ) override;
+}; // BinaryReportWriter
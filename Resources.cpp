@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Walk the resource tree of a PE image on demand
+///
+/// @file   Resources.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <charconv>   // For from_chars()
+#include <stdexcept>  // For out_of_range domain_error
+
+#include "Flags.h"
+#include "Format.h"
+#include "Resources.h"
+
+using namespace std;
+
+
+/// The size of a resource directory table (before its entries)
+#define DIRECTORY_TABLE_SIZE 16
+
+/// The size of one entry in a resource directory table
+#define DIRECTORY_ENTRY_SIZE 8
+
+/// The size of a resource data entry
+#define DATA_ENTRY_SIZE 16
+
+/// Set in the first half of an entry if it has a name, and in the second half if it points at a subdirectory
+#define HIGH_BIT 0x80000000
+
+
+const char* ResourceTable::read( const uint32_t offset, const size_t length ) const {
+   if( uint64_t{ offset } + length > directory_.size ) {
+      throw out_of_range( "The resource tree points outside of the resource directory" );
+   }
+   return image_.read( directory_.virtual_address + offset, length );
+}
+
+
+ResourceDirectory ResourceTable::subdirectory( const ResourceEntry& entry ) const {
+   if( !entry.is_directory ) {
+      throw domain_error( "A resource directory entry points at data, not a directory" );
+   }
+   return ResourceDirectory { *this, entry.offset };
+}
+
+
+ResourceData ResourceTable::data( const ResourceEntry& entry ) const {
+   if( entry.is_directory ) {
+      throw domain_error( "A resource directory entry points at a directory, not data" );
+   }
+   const char* bytes = read( entry.offset, DATA_ENTRY_SIZE );
+   return { load_le<uint32_t>( bytes ), load_le<uint32_t>( bytes + 4 ), load_le<uint32_t>( bytes + 8 ) };
+}
+
+
+ResourceDirectory::ResourceDirectory( const ResourceTable& table, const uint32_t offset )
+      :table_( &table )  // Member initialization
+{
+   const char* header = table_->read( offset, DIRECTORY_TABLE_SIZE );
+   number_of_names_ = load_le<uint16_t>( header + 12 );
+   number_of_ids_   = load_le<uint16_t>( header + 14 );
+   if( size() > 0 ) {
+      entries_ = table_->read( offset + DIRECTORY_TABLE_SIZE, size() * DIRECTORY_ENTRY_SIZE );
+   }
+}
+
+
+ResourceEntry ResourceDirectory::entry( const size_t index ) const {
+   const uint32_t first  = load_le<uint32_t>( entries_ + index * DIRECTORY_ENTRY_SIZE );
+   const uint32_t second = load_le<uint32_t>( entries_ + index * DIRECTORY_ENTRY_SIZE + 4 );
+
+   ResourceEntry entry;
+   entry.offset       = second & ~HIGH_BIT;
+   entry.is_directory = ( second & HIGH_BIT ) != 0;
+   if( first & HIGH_BIT ) {
+      const uint32_t name_offset = first & ~HIGH_BIT;
+      entry.name_length = load_le<uint16_t>( table_->read( name_offset, 2 ) );
+      entry.name        = table_->read( name_offset + 2, size_t{ entry.name_length } * 2 );
+   } else {
+      entry.id = first;
+   }
+   return entry;
+}
+
+
+optional<ResourceEntry> ResourceDirectory::find( const uint32_t id ) const {
+   // The ID entries follow the named ones, sorted by ID
+   size_t low  = number_of_names_;
+   size_t high = size();
+   while( low < high ) {
+      const size_t   middle = low + ( high - low ) / 2;
+      const uint32_t key    = load_le<uint32_t>( entries_ + middle * DIRECTORY_ENTRY_SIZE );
+      if( key < id ) {
+         low = middle + 1;
+      } else {
+         high = middle;
+      }
+   }
+   if( low < size() && load_le<uint32_t>( entries_ + low * DIRECTORY_ENTRY_SIZE ) == id ) {
+      return entry( low );
+   }
+   return nullopt;
+}
+
+
+void append_resource_id( string& out, const ResourceEntry& entry, const bool is_type ) {
+   if( !entry.has_name() ) {
+      const char* type_name = is_type ? RESOURCE_TYPE_FLAGS.lookup( entry.id ) : nullptr;
+      if( type_name != nullptr ) {
+         out.append( type_name );
+      } else {
+         append_dec( out, entry.id );
+      }
+      return;
+   }
+
+   // UTF-16LE to UTF-8 (an unpaired surrogate becomes U+FFFD)
+   for( size_t i = 0 ; i < entry.name_length ; i++ ) {
+      uint32_t code_point = load_le<uint16_t>( entry.name + i * 2 );
+      if( code_point >= 0xD800 && code_point < 0xDC00 && i + 1 < entry.name_length ) {
+         const uint32_t low = load_le<uint16_t>( entry.name + ( i + 1 ) * 2 );
+         if( low >= 0xDC00 && low < 0xE000 ) {
+            code_point = 0x10000 + ( ( code_point - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+            i++;
+         }
+      }
+      if( code_point >= 0xD800 && code_point < 0xE000 ) {
+         code_point = 0xFFFD;
+      }
+
+      if( code_point < 0x80 ) {
+         out.push_back( static_cast<char>( code_point ) );
+      } else if( code_point < 0x800 ) {
+         out.push_back( static_cast<char>( 0xC0 | ( code_point >> 6 ) ) );
+         out.push_back( static_cast<char>( 0x80 | ( code_point & 0x3F ) ) );
+      } else if( code_point < 0x10000 ) {
+         out.push_back( static_cast<char>( 0xE0 | ( code_point >> 12 ) ) );
+         out.push_back( static_cast<char>( 0x80 | ( ( code_point >> 6 ) & 0x3F ) ) );
+         out.push_back( static_cast<char>( 0x80 | ( code_point & 0x3F ) ) );
+      } else {
+         out.push_back( static_cast<char>( 0xF0 | ( code_point >> 18 ) ) );
+         out.push_back( static_cast<char>( 0x80 | ( ( code_point >> 12 ) & 0x3F ) ) );
+         out.push_back( static_cast<char>( 0x80 | ( ( code_point >> 6 ) & 0x3F ) ) );
+         out.push_back( static_cast<char>( 0x80 | ( code_point & 0x3F ) ) );
+      }
+   }
+} // append_resource_id()
+
+
+optional<uint32_t> parse_resource_type( const string_view text ) {
+   for( const FlagName& type : RESOURCE_TYPE_NAMES ) {
+      if( text == type.name ) {
+         return static_cast<uint32_t>( type.value );
+      }
+   }
+   uint32_t id { 0 };
+   const from_chars_result parsed = from_chars( text.data(), text.data() + text.size(), id );
+   if( text.empty() || parsed.ec != errc() || parsed.ptr != text.data() + text.size() ) {
+      return nullopt;
+   }
+   return id;
+}
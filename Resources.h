@@ -0,0 +1,189 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Walk the resource tree of a PE image on demand
+///
+/// The resource directory is a tree of directory tables, three levels deep
+/// by convention: the type (`RT_ICON`, `RT_VERSION`...), then the name, then
+/// the language.  Each leaf is a data entry that points at the payload.
+/// Nothing is read until it's asked for: a ResourceDirectory is one level of
+/// the tree, its entries are decoded one at a time, and a lookup by ID is a
+/// binary search.  So fetching `RT_MANIFEST` reads the root, one type
+/// directory and the entries under it, however many icons the file has.
+/// Payloads are returned as spans into the ByteSource (nothing is copied).
+///
+/// @see https://learn.microsoft.com/en-us/windows/win32/debug/pe-format#the-rsrc-section
+///
+/// @file   Resources.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>      // For size_t
+#include <cstdint>      // For uint16_t uint32_t
+#include <optional>     // For optional
+#include <span>         // For span
+#include <stdexcept>    // For domain_error
+#include <string>       // For string
+#include <string_view>  // For string_view
+
+#include "HeaderView.h"
+#include "ImageReader.h"
+
+
+/// One entry in a resource directory table
+///
+/// An entry is known by an ID or by a name, and points at either another
+/// directory table or a data entry.
+struct ResourceEntry {
+   uint32_t    id           { 0 };        ///< The ID (if #name is `nullptr`)
+   const char* name         { nullptr };  ///< The name in UTF-16LE (not terminated), or `nullptr` if it has an ID
+   uint16_t    name_length  { 0 };        ///< The number of UTF-16 code units in #name
+   uint32_t    offset       { 0 };        ///< Where the subdirectory or data entry is (from the start of the resource directory)
+   bool        is_directory { false };    ///< `true` if #offset is a subdirectory, `false` if it's a data entry
+
+   bool has_name() const {
+      return name != nullptr;  /// @return `true` if the entry is known by its name rather than an ID
+   }
+};
+
+
+/// A leaf of the resource tree: where a payload is
+struct ResourceData {
+   uint32_t rva       { 0 };  ///< The address of the payload
+   uint32_t size      { 0 };  ///< The size of the payload in bytes
+   uint32_t code_page { 0 };  ///< The code page of text in the payload
+};
+
+
+class ResourceTable;
+
+
+/// One directory table in the resource tree (the entries are read one at a time)
+class ResourceDirectory {
+protected:
+   const ResourceTable* table_;                        ///< The tree this is part of
+   uint32_t             number_of_names_ { 0 };        ///< The entries with names (they come first, sorted by name)
+   uint32_t             number_of_ids_   { 0 };        ///< The entries with IDs (they follow, sorted by ID)
+   const char*          entries_         { nullptr };  ///< The entries (8 bytes each)
+
+public:
+   /// View the directory table at `offset` in `table`
+   ///
+   /// @throws out_of_range if the table or its entries aren't in the resource directory
+   ResourceDirectory( const ResourceTable& table, uint32_t offset );
+
+   size_t size() const {
+      return number_of_names_ + number_of_ids_;  /// @return The number of entries
+   }
+
+   /// @return The entry at `index` (named entries first, then IDs)
+   /// @throws out_of_range if its name isn't in the resource directory
+   ResourceEntry entry( size_t index ) const;
+
+   /// Look up the entry with the ID `id` with a binary search
+   ///
+   /// @return The entry, or nothing if there isn't one with that ID
+   std::optional<ResourceEntry> find( uint32_t id ) const;
+}; // ResourceDirectory
+
+
+/// The resource directory of a PEFile
+class ResourceTable {
+public:
+   /// The most directory entries that a walk with for_each_leaf() visits
+   ///
+   /// Every entry counts, not just the leaves: a hostile tree can point
+   /// each of its types at one big name directory of empty language
+   /// directories (or back at itself), which would take a very long time
+   /// without ever reaching a leaf.
+   static constexpr size_t MAX_ENTRIES = 262144;
+
+protected:
+   ImageReader   image_;      ///< Where to read the tree
+   DataDirectory directory_;  ///< The Resource Table entry in the data directory
+
+public:
+   /// View the resource directory described by `directory` (nothing is read yet)
+   ///
+   /// @param image     Where to read the image
+   /// @param directory The Resource Table entry from the data directory
+   ResourceTable( const ImageReader& image, const DataDirectory& directory )
+         :image_    ( image )      // Member initialization
+         ,directory_( directory )  // Member initialization
+   {}
+
+   bool empty() const {
+      return directory_.size == 0;  /// @return `true` if the image has no resources
+   }
+
+   /// Get `length` bytes at `offset` from the start of the resource directory
+   ///
+   /// @throws out_of_range if the bytes aren't inside the resource directory
+   /// @return A pointer to the bytes
+   const char* read( uint32_t offset, size_t length ) const;
+
+   /// @return The top of the tree (one entry per type)
+   ResourceDirectory root() const {
+      return ResourceDirectory { *this, 0 };
+   }
+
+   /// @return The directory that `entry` points at
+   /// @throws domain_error if `entry` points at a data entry
+   ResourceDirectory subdirectory( const ResourceEntry& entry ) const;
+
+   /// @return The data entry that `entry` points at
+   /// @throws domain_error if `entry` points at a subdirectory
+   ResourceData data( const ResourceEntry& entry ) const;
+
+   /// @return The payload of `data` (a view into the ByteSource)
+   /// @throws out_of_range if the payload isn't in the file
+   std::span<const char> payload( const ResourceData& data ) const {
+      return { image_.read( data.rva, data.size ), data.size };
+   }
+
+   /// Call `visit( type, name, language, data )` for each leaf under `type`
+   ///
+   /// @param type    An entry of root()
+   /// @param visit   What to call
+   /// @param entries The entries visited so far (so a whole walk can be limited to #MAX_ENTRIES)
+   /// @throws domain_error if the tree isn't three levels deep or the walk visits more than #MAX_ENTRIES entries
+   template <typename VISITOR>
+   void for_each_leaf( const ResourceEntry& type, VISITOR visit, size_t& entries ) const {
+      const auto count_entry = [&entries] {
+         if( ++entries > MAX_ENTRIES ) {
+            throw std::domain_error( "The resource tree has too many entries" );
+         }
+      };
+
+      count_entry();  // The type
+      const ResourceDirectory names = subdirectory( type );
+      for( size_t i = 0 ; i < names.size() ; i++ ) {
+         count_entry();
+         const ResourceEntry     name      = names.entry( i );
+         const ResourceDirectory languages = subdirectory( name );
+         for( size_t j = 0 ; j < languages.size() ; j++ ) {
+            count_entry();
+            const ResourceEntry language = languages.entry( j );
+            visit( type, name, language, data( language ) );
+         }
+      }
+   }
+}; // ResourceTable
+
+
+/// Append the ID or the name of `entry` to `out`
+///
+/// A type ID is written as its `RT_` name if it has one.  A name is written
+/// as UTF-8.
+///
+/// @param out     Where to append
+/// @param entry   The entry
+/// @param is_type `true` if `entry` is at the top of the tree
+extern void append_resource_id( std::string& out, const ResourceEntry& entry, bool is_type );
+
+
+/// @return The ID of the resource type `text` (an `RT_` name or a number),
+///         or nothing if it isn't one
+extern std::optional<uint32_t> parse_resource_type( std::string_view text );
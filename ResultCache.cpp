@@ -0,0 +1,227 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// A persistent cache of reports, keyed by the identity of the file
+///
+/// @file   ResultCache.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <bit>        // For bit_ceil()
+#include <cstddef>    // For offsetof()
+#include <cstring>    // For memcpy() memcmp()
+#include <stdexcept>  // For runtime_error
+
+#include <fcntl.h>     // For open()
+#include <sys/file.h>  // For flock()
+#include <sys/mman.h>  // For mmap() munmap()
+#include <sys/stat.h>  // For stat() fstat()
+#include <sys/uio.h>   // For writev()
+#include <unistd.h>    // For close() ftruncate()
+
+#include "ByteSource.h"
+#include "ResultCache.h"
+
+using namespace std;
+
+
+/// The first four bytes of every entry (`RPC1`)
+#define CACHE_ENTRY_MAGIC 0x31435052
+
+/// Set in CacheEntry::flags if CacheEntry::sha256 is set
+#define ENTRY_HAS_SHA256 0x0001
+
+
+/// The header of one entry in the log (the report follows it, padded to 8 bytes)
+struct CacheEntry {
+   uint32_t magic;         ///< #CACHE_ENTRY_MAGIC
+   uint32_t flags;         ///< #ENTRY_HAS_SHA256
+   CacheKey key;           ///< The file the report is for
+   uint64_t report_size;   ///< The size of the report in bytes
+   uint64_t report_check;  ///< The FNV-1a hash of the report (to catch a torn entry)
+   uint8_t  sha256[32];    ///< The SHA-256 of the file (if #ENTRY_HAS_SHA256)
+};
+
+static_assert( sizeof( CacheEntry ) % 8 == 0 );
+
+
+/// @return The number of bytes of padding after a report of `size` bytes
+static constexpr size_t padding_for( const uint64_t size ) {
+   return static_cast<size_t>( ( 8 - size % 8 ) % 8 );
+}
+
+
+/// @return The SHA-256 of the contents of the file at `path`
+static Sha256::Digest file_digest( const string& path ) {
+   const unique_ptr<ByteSource> source = open_byte_source( path, LoadMode::MMAP );
+   Sha256 sha256;
+   sha256.update( source->read( 0, source->size() ), source->size() );
+   return sha256.finish();
+}
+
+
+uint64_t ResultCache::hash( const string_view text, const uint64_t seed ) {
+   uint64_t result = seed;
+   for( const char character : text ) {
+      result ^= static_cast<unsigned char>( character );
+      result *= 0x100000001b3;  // The FNV-1a prime
+   }
+   return result;
+}
+
+
+optional<CacheKey> ResultCache::key_for( const string& path, const uint64_t options ) {
+   struct stat file_stat {};
+   if( stat( path.c_str(), &file_stat ) != 0 || !S_ISREG( file_stat.st_mode ) ) {
+      return nullopt;
+   }
+   return CacheKey {
+       static_cast<uint64_t>( file_stat.st_dev )
+      ,static_cast<uint64_t>( file_stat.st_ino )
+      ,static_cast<uint64_t>( file_stat.st_size )
+      ,static_cast<uint64_t>( file_stat.st_mtim.tv_sec ) * 1000000000 + static_cast<uint64_t>( file_stat.st_mtim.tv_nsec )
+      ,hash( path, options )
+   };
+}
+
+
+ResultCache::ResultCache( const string& new_path, const bool new_verify )
+      :path_  ( new_path )    // Member initialization
+      ,verify_( new_verify )  // Member initialization
+{
+   fd_ = open( path_.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644 );
+   if( fd_ < 0 ) {
+      throw runtime_error( "Failed to open the cache " + path_ );
+   }
+   try {
+      load();
+   } catch( ... ) {
+      close( fd_ );
+      throw;
+   }
+}
+
+
+ResultCache::~ResultCache() {
+   if( mapping_ != nullptr ) {
+      munmap( const_cast<char*>( mapping_ ), mapped_ );
+   }
+   close( fd_ );
+}
+
+
+void ResultCache::load() {
+   flock( fd_, LOCK_EX );  // Nobody appends while the log is read (and maybe cut)
+
+   struct stat log_stat {};
+   if( fstat( fd_, &log_stat ) != 0 ) {
+      flock( fd_, LOCK_UN );
+      throw runtime_error( "Failed to open the cache " + path_ );
+   }
+   mapped_ = static_cast<size_t>( log_stat.st_size );
+   if( mapped_ > 0 ) {
+      void* mapping = mmap( nullptr, mapped_, PROT_READ, MAP_PRIVATE, fd_, 0 );
+      if( mapping == MAP_FAILED ) {
+         flock( fd_, LOCK_UN );
+         throw runtime_error( "Unable to read the cache " + path_ );
+      }
+      mapping_ = static_cast<const char*>( mapping );
+   }
+
+   // Walk the entries until the end of the log or the first one that's torn
+   vector<uint64_t> offsets;
+   size_t offset = 0;
+   while( mapped_ - offset >= sizeof( CacheEntry ) ) {
+      CacheEntry entry;
+      memcpy( &entry, mapping_ + offset, sizeof( entry ) );
+      const size_t room = mapped_ - offset - sizeof( entry );
+      if( entry.magic != CACHE_ENTRY_MAGIC || entry.report_size > room || padding_for( entry.report_size ) > room - entry.report_size ) {
+         break;
+      }
+      if( hash( string_view( mapping_ + offset + sizeof( entry ), entry.report_size ) ) != entry.report_check ) {
+         break;
+      }
+      offsets.push_back( offset );
+      offset += sizeof( entry ) + entry.report_size + padding_for( entry.report_size );
+   }
+   if( offset < mapped_ ) {
+      (void) !ftruncate( fd_, static_cast<off_t>( offset ) );  // If it can't be cut, new entries after it are never found
+   }
+   flock( fd_, LOCK_UN );
+
+   // Index them (a later entry for the same key replaces an earlier one)
+   slots_.assign( bit_ceil( offsets.size() * 2 + 1 ), EMPTY );
+   for( const uint64_t entry_offset : offsets ) {
+      CacheKey key;
+      memcpy( &key, mapping_ + entry_offset + offsetof( CacheEntry, key ), sizeof( key ) );
+      slots_[ probe( key ) ] = entry_offset;
+   }
+} // load()
+
+
+size_t ResultCache::probe( const CacheKey& key ) const {
+   const size_t mask = slots_.size() - 1;
+   size_t slot = hash( string_view( reinterpret_cast<const char*>( &key ), sizeof( key ) ) ) & mask;
+   while( slots_[slot] != EMPTY ) {
+      CacheKey other;
+      memcpy( &other, mapping_ + slots_[slot] + offsetof( CacheEntry, key ), sizeof( other ) );
+      if( other == key ) {
+         break;
+      }
+      slot = ( slot + 1 ) & mask;
+   }
+   return slot;
+}
+
+
+optional<string_view> ResultCache::find( const CacheKey& key, const string& path ) const {
+   const uint64_t offset = slots_[ probe( key ) ];
+   if( offset == EMPTY ) {
+      return nullopt;
+   }
+
+   CacheEntry entry;
+   memcpy( &entry, mapping_ + offset, sizeof( entry ) );
+   if( verify_ ) {
+      if( !( entry.flags & ENTRY_HAS_SHA256 ) ) {
+         return nullopt;
+      }
+      const Sha256::Digest digest = file_digest( path );
+      if( memcmp( digest.data(), entry.sha256, digest.size() ) != 0 ) {
+         return nullopt;
+      }
+   }
+   return string_view( mapping_ + offset + sizeof( entry ), entry.report_size );
+}
+
+
+void ResultCache::store( const CacheKey& key, const string& path, const string_view report ) {
+   CacheEntry entry {};
+   entry.magic        = CACHE_ENTRY_MAGIC;
+   entry.key          = key;
+   entry.report_size  = report.size();
+   entry.report_check = hash( report );
+   if( verify_ ) {
+      const Sha256::Digest digest = file_digest( path );
+      memcpy( entry.sha256, digest.data(), digest.size() );
+      entry.flags |= ENTRY_HAS_SHA256;
+   }
+
+   static constexpr char PADDING[8] {};
+   iovec parts[3] {
+       { &entry,                           sizeof( entry ) }
+      ,{ const_cast<char*>( report.data() ), report.size() }
+      ,{ const_cast<char*>( PADDING ),       padding_for( report.size() ) }
+   };
+   const size_t total = sizeof( entry ) + report.size() + padding_for( report.size() );
+
+   // One writev() to a file opened with O_APPEND, so the entry lands in one piece
+   const lock_guard<mutex> lock( append_mutex_ );
+   flock( fd_, LOCK_EX );
+   const ssize_t written = writev( fd_, parts, 3 );
+   flock( fd_, LOCK_UN );
+   if( written < 0 || static_cast<size_t>( written ) != total ) {
+      throw runtime_error( "Unable to write to the cache " + path_ );
+   }
+} // store()
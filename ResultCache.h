@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// A persistent cache of reports, keyed by the identity of the file
+///
+/// The cache is one append-only log of entries.  Each entry holds the key
+/// of a file (its device, inode, size and modification time, plus a hash
+/// of the path and of what was asked for) and the report that was written
+/// for it.  When a cache is opened, the log is mapped read-only and its
+/// entries are indexed in memory, so a hit is a `stat()`, a probe and a
+/// copy: the file itself isn't opened.
+///
+/// New entries are appended with one `writev()` under an `flock()`, so the
+/// workers of a Batch (and several readpe processes) can share a cache.
+/// A torn entry at the end of the log (from a crash) is cut off the next
+/// time the cache is opened.  The entries appended by a run are found by
+/// the next run.
+///
+/// @file   ResultCache.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>      // For size_t
+#include <cstdint>      // For uint8_t uint32_t uint64_t
+#include <mutex>        // For mutex
+#include <optional>     // For optional
+#include <string>       // For string
+#include <string_view>  // For string_view
+#include <vector>       // For vector
+
+#include "Hash.h"
+
+
+/// What identifies one report of one file
+struct CacheKey {
+   uint64_t device   { 0 };  ///< `st_dev`
+   uint64_t inode    { 0 };  ///< `st_ino`
+   uint64_t size     { 0 };  ///< `st_size`
+   uint64_t mtime_ns { 0 };  ///< `st_mtim` in nanoseconds
+   uint64_t variant  { 0 };  ///< A hash of the path and of the report options
+
+   bool operator==( const CacheKey& ) const = default;  ///< @return `true` if every part is the same
+};
+
+
+/// An on-disk cache of reports
+class ResultCache {
+protected:
+   static constexpr uint64_t EMPTY = UINT64_MAX;  ///< A slot with no entry in it
+
+   std::string           path_;                 ///< The log file
+   bool                  verify_;               ///< Check the SHA-256 of a file before serving its entry
+   int                   fd_      { -1 };       ///< The log, open for appending
+   const char*           mapping_ { nullptr };  ///< The log as it was when it was opened
+   size_t                mapped_  { 0 };        ///< The size of #mapping_
+   std::vector<uint64_t> slots_;                ///< Open-addressed offsets of entries in #mapping_ (a power of two in size)
+   std::mutex            append_mutex_;         ///< Serializes the appends from this process
+
+   /// @return The slot for `key` in #slots_ (which is either empty or holds `key`)
+   size_t probe( const CacheKey& key ) const;
+
+   /// Read the log and index its entries (cutting off a torn entry at the end)
+   void load();
+
+public:
+   /// Open (or create) the cache at `new_path`
+   ///
+   /// @param new_path   The log file
+   /// @param new_verify Store the SHA-256 of each file with its entry and
+   ///                   check it before an entry is served
+   /// @throws runtime_error if the log can't be opened
+   ResultCache( const std::string& new_path, bool new_verify );
+
+   ~ResultCache();
+
+   ResultCache( const ResultCache& ) = delete;             ///< A cache owns OS resources
+   ResultCache& operator=( const ResultCache& ) = delete;  ///< A cache owns OS resources
+
+   /// Identify the file at `path`
+   ///
+   /// @param path    The file
+   /// @param options A hash of the report options (from hash())
+   /// @return The key, or nothing if the file can't be `stat()`ed
+   static std::optional<CacheKey> key_for( const std::string& path, uint64_t options );
+
+   /// @return The FNV-1a hash of `text`, continuing from `seed`
+   static uint64_t hash( std::string_view text, uint64_t seed = 0xcbf29ce484222325 );
+
+   /// Look up the report for `key` (this is safe to call from several threads)
+   ///
+   /// @param key  The file
+   /// @param path The file (only read if the cache verifies its entries)
+   /// @return The report (which stays valid for the life of the cache), or
+   ///         nothing if it isn't in the cache
+   std::optional<std::string_view> find( const CacheKey& key, const std::string& path ) const;
+
+   /// Append the report for `key` to the log (this is safe to call from several threads)
+   ///
+   /// @param key    The file
+   /// @param path   The file (only read if the cache verifies its entries)
+   /// @param report The report
+   /// @throws runtime_error if the log can't be written
+   void store( const CacheKey& key, const std::string& path, std::string_view report );
+}; // ResultCache
@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Translate RVAs to file offsets through the section table
+///
+/// @file   SectionTable.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For max() min() sort() upper_bound()
+#include <cstdint>    // For UINT32_MAX
+
+#include "SectionTable.h"
+
+using namespace std;
+
+
+void SectionTable::reset( const size_t number_of_sections, const uint32_t size_of_headers, const uint64_t file_size ) {
+   ranges_.clear();
+   ranges_.reserve( number_of_sections );
+   size_of_headers_ = size_of_headers;
+   file_size_       = file_size;
+}
+
+
+void SectionTable::add( const SectionHeaderView& header, const uint16_t index ) {
+   const uint32_t virtual_address = header.get<SECTION_VIRTUAL_ADDRESS>();
+   const uint32_t raw_size        = header.get<SECTION_RAW_SIZE>();
+
+   // A VirtualSize of 0 means the section is as big as its raw data
+   uint32_t virtual_size = header.get<SECTION_VIRTUAL_SIZE>();
+   if( virtual_size == 0 ) {
+      virtual_size = raw_size;
+   }
+
+   // Clamp the end so a hostile header can't wrap around the address space
+   const uint64_t virtual_end = min<uint64_t>( uint64_t{ virtual_address } + virtual_size, UINT32_MAX );
+
+   ranges_.push_back( { virtual_address
+                       ,static_cast<uint32_t>( virtual_end )
+                       ,header.get<SECTION_RAW_OFFSET>()
+                       ,min( raw_size, virtual_size )
+                       ,index } );
+}
+
+
+void SectionTable::finish() {
+   // stable_sort() would allocate; the index breaks ties instead
+   sort( ranges_.begin(), ranges_.end(), []( const SectionRange& left, const SectionRange& right ) {
+      return left.virtual_address < right.virtual_address
+         || ( left.virtual_address == right.virtual_address && left.index < right.index );
+   } );
+}
+
+
+const SectionRange* SectionTable::find( const uint32_t rva ) const {
+   // Both searches find the last section that starts at or before rva, so
+   // overlapping sections resolve the same way however many there are
+   const SectionRange* candidate = nullptr;
+   if( ranges_.size() <= LINEAR_SCAN_LIMIT ) {
+      for( const SectionRange& range : ranges_ ) {
+         if( range.virtual_address > rva ) {
+            break;
+         }
+         candidate = &range;
+      }
+   } else {
+      auto after = upper_bound( ranges_.begin(), ranges_.end(), rva, []( const uint32_t key, const SectionRange& range ) {
+         return key < range.virtual_address;
+      } );
+      if( after != ranges_.begin() ) {
+         candidate = &*( after - 1 );
+      }
+   }
+   return candidate != nullptr && rva < candidate->virtual_end ? candidate : nullptr;
+} // find()
+
+
+optional<FileSpan> SectionTable::rva_to_span( const uint32_t rva ) const {
+   uint64_t offset;
+   uint64_t length;
+
+   const SectionRange* range = find( rva );
+   if( range == nullptr ) {
+      if( rva >= size_of_headers_ ) {
+         return nullopt;
+      }
+      offset = rva;
+      length = size_of_headers_ - rva;
+   } else {
+      const uint32_t delta = rva - range->virtual_address;
+      if( delta >= range->raw_size ) {
+         return nullopt;
+      }
+      offset = uint64_t{ range->raw_offset } + delta;  // 64 bits, so a PointerToRawData near UINT32_MAX doesn't wrap
+      length = range->raw_size - delta;
+   }
+
+   if( offset >= file_size_ || offset > UINT32_MAX ) {
+      return nullopt;
+   }
+   return FileSpan { static_cast<uint32_t>( offset ), static_cast<uint32_t>( min( length, file_size_ - offset ) ) };
+} // rva_to_span()
+
+
+optional<uint32_t> SectionTable::rva_to_offset( const uint32_t rva ) const {
+   const optional<FileSpan> span = rva_to_span( rva );
+   if( !span ) {
+      return nullopt;
+   }
+   return span->offset;
+}
@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Translate RVAs to file offsets through the section table
+///
+/// @file   SectionTable.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>          // For size_t
+#include <cstdint>          // For uint16_t uint32_t
+#include <memory_resource>  // For memory_resource
+#include <optional>         // For optional
+#include <vector>           // For pmr::vector
+
+#include "HeaderView.h"
+
+
+/// Where one section lives in memory and in the file
+struct SectionRange {
+   uint32_t virtual_address;  ///< The RVA of the first byte of the section
+   uint32_t virtual_end;      ///< One past the last RVA of the section
+   uint32_t raw_offset;       ///< The file offset that #virtual_address maps to
+   uint32_t raw_size;         ///< The number of bytes of the section that are in the file
+   uint16_t index;            ///< The position of the section in the section table
+};
+
+
+/// A run of bytes in the file that an RVA maps to
+struct FileSpan {
+   uint32_t offset;  ///< The file offset of the RVA
+   uint32_t length;  ///< How many bytes from #offset are backed by the same section (or the headers)
+};
+
+
+/// The section table of a PEFile, sorted by address for RVA lookups
+///
+/// The table is built once per file.  After that, a lookup makes no
+/// allocations: a small table (most files have fewer than a dozen
+/// sections) is scanned in order, a larger one is binary searched.
+class SectionTable {
+public:
+   /// Tables this size or smaller are scanned rather than searched
+   static constexpr size_t LINEAR_SCAN_LIMIT = 8;
+
+protected:
+   std::pmr::vector<SectionRange> ranges_;                ///< The sections, sorted by #SectionRange::virtual_address
+   uint32_t                       size_of_headers_ { 0 };  ///< RVAs below this are in the headers (and map to themselves)
+   uint64_t                       file_size_       { 0 };  ///< Spans are clipped to the end of the file
+
+public:
+   /// Create an empty table that allocates from `arena`
+   explicit SectionTable( std::pmr::memory_resource* arena = std::pmr::get_default_resource() )
+         :ranges_( arena )  // Member initialization
+   {}
+
+   /// Forget the sections and make room for `number_of_sections` of them
+   ///
+   /// @param number_of_sections The sections that will be added
+   /// @param size_of_headers    RVAs below this are in the headers
+   /// @param file_size          The size of the file that the sections are in
+   void reset( size_t number_of_sections, uint32_t size_of_headers, uint64_t file_size );
+
+   /// Add the section in `header` (whose position in the table is `index`)
+   void add( const SectionHeaderView& header, uint16_t index );
+
+   /// Sort the sections by address.  Call this once after the last add().
+   void finish();
+
+   size_t size() const {
+      return ranges_.size();  /// @return The number of sections
+   }
+
+   const std::pmr::vector<SectionRange>& ranges() const {
+      return ranges_;  /// @return The sections sorted by address
+   }
+
+   /// Find the section that holds `rva`
+   ///
+   /// That's the last section (in address order) that starts at or before
+   /// `rva`, if it holds `rva`.  Sections that a loader accepts don't
+   /// overlap, so no other section could.  A hostile file's can: an RVA
+   /// past the start of a later section is then never found in an earlier
+   /// one, whether the table is scanned or searched.
+   ///
+   /// @return The section (or `nullptr` if there isn't one)
+   const SectionRange* find( uint32_t rva ) const;
+
+   /// Translate `rva` to the run of file bytes that starts there
+   ///
+   /// The span never runs past the end of the file, and a hostile
+   /// `PointerToRawData` can't wrap it around to another part of the file.
+   ///
+   /// @return The span, or nothing if `rva` isn't backed by bytes in the file
+   std::optional<FileSpan> rva_to_span( uint32_t rva ) const;
+
+   /// Translate `rva` to a file offset
+   ///
+   /// @return The file offset, or nothing if `rva` isn't backed by bytes in
+   ///         the file (it's not in a section, or it's in the zero-filled
+   ///         tail of one)
+   std::optional<uint32_t> rva_to_offset( uint32_t rva ) const;
+}; // SectionTable
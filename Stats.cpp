@@ -0,0 +1,193 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Per-stage timing and counters for `--stats` and `--trace`
+///
+/// @file   Stats.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <array>      // For array
+#include <atomic>     // For atomic
+#include <chrono>     // For steady_clock
+#include <fstream>    // For ofstream
+#include <iomanip>    // For setw() setprecision()
+#include <mutex>      // For mutex
+#include <stdexcept>  // For runtime_error
+#include <vector>     // For vector
+
+#include "Stats.h"
+
+using namespace std;
+
+
+bool Stats::enabled_ { false };
+bool Stats::tracing_ { false };
+
+
+/// The names of the StatsTimer values (for printing)
+static constexpr array<const char*, NUMBER_OF_STATS_TIMERS> TIMER_NAMES {
+   "open", "cache", "parse", "analyze", "imports", "exports", "resources", "relocations", "debug", "overlay", "format", "write"
+};
+
+
+/// One finished scope
+struct TraceEvent {
+   StatsTimer timer;     ///< What was timed
+   unsigned   thread;    ///< The thread it ran on
+   uint64_t   start_ns;  ///< When it started
+   uint64_t   duration;  ///< How long it took in nanoseconds
+};
+
+
+/// The totals for one thread (or for the whole process)
+struct StatsTotals {
+   array<uint64_t, NUMBER_OF_STATS_TIMERS>   timer_ns    {};  ///< The time in each StatsTimer
+   array<uint64_t, NUMBER_OF_STATS_TIMERS>   timer_calls {};  ///< The number of scopes of each StatsTimer
+   array<uint64_t, NUMBER_OF_STATS_COUNTERS> counters    {};  ///< Each StatsCounter
+   vector<TraceEvent>                        events;          ///< The scopes (with `--trace`)
+
+   /// Add `other` to these totals and clear it
+   void take( StatsTotals& other ) {
+      for( size_t i = 0 ; i < NUMBER_OF_STATS_TIMERS ; i++ ) {
+         timer_ns[i]    += other.timer_ns[i];
+         timer_calls[i] += other.timer_calls[i];
+      }
+      for( size_t i = 0 ; i < NUMBER_OF_STATS_COUNTERS ; i++ ) {
+         counters[i] += other.counters[i];
+      }
+      events.insert( events.end(), other.events.begin(), other.events.end() );
+      other = StatsTotals {};
+   }
+};
+
+
+static mutex       process_mutex;   ///< Guards #process_totals
+static StatsTotals process_totals;  ///< The totals of the threads that have been merged
+static uint64_t    start_ns;        ///< When Stats::enable() was called
+
+static atomic<unsigned> next_thread { 0 };  ///< The number of the next thread to record anything
+
+thread_local uint64_t stats_thread_allocations { 0 };
+
+
+/// This thread's totals (merged into #process_totals when the thread exits)
+struct ThreadStats : StatsTotals {
+   unsigned thread { next_thread++ };  ///< The number of this thread (for the trace)
+
+   /// Merge this thread's totals into #process_totals
+   void merge() {
+      counters[ static_cast<size_t>( StatsCounter::ALLOCATIONS ) ] += stats_thread_allocations;
+      stats_thread_allocations = 0;
+      const lock_guard<mutex> lock( process_mutex );
+      process_totals.take( *this );
+   }
+
+   ~ThreadStats() {
+      merge();
+   }
+};
+
+static thread_local ThreadStats thread_stats;  ///< This thread's totals
+
+
+void Stats::enable( const bool trace ) {
+   start_ns = StatsScope::now();
+   enabled_ = true;
+   tracing_ = trace;
+}
+
+
+void Stats::add( const StatsCounter counter, const uint64_t amount ) {
+   thread_stats.counters[ static_cast<size_t>( counter ) ] += amount;
+}
+
+
+uint64_t StatsScope::now() {
+   return static_cast<uint64_t>( chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count() ) | 1;
+}
+
+
+void StatsScope::finish() {
+   const uint64_t end = now();
+   ThreadStats& stats = thread_stats;
+   stats.timer_ns   [ static_cast<size_t>( timer_ ) ] += end - start_ns_;
+   stats.timer_calls[ static_cast<size_t>( timer_ ) ]++;
+   if( Stats::tracing_ ) {
+      stats.events.push_back( { timer_, stats.thread, start_ns_, end - start_ns_ } );
+   }
+}
+
+
+/// Print `label` and `value` like BatchSummary::print() does
+template <typename T>
+static void print_line( ostream& out, const char* indent, const int width, const string& label, const T& value ) {
+   out << indent << setfill( ' ' ) << left << setw( width ) << label << value << endl;
+}
+
+
+void Stats::print( ostream& out, const size_t files, const size_t failures ) {
+#ifdef READPE_NO_STATS
+   out << "Stats (readpe was built with READPE_NO_STATS, so nothing was collected)" << endl;
+   (void) files;
+   (void) failures;
+#else
+   const uint64_t end_ns = StatsScope::now();
+   thread_stats.merge();
+
+   const StatsTotals& totals = process_totals;
+   const double seconds = static_cast<double>( end_ns - start_ns ) / 1e9;
+   const uint64_t bytes       = totals.counters[ static_cast<size_t>( StatsCounter::BYTES_READ ) ];
+   const uint64_t allocations = totals.counters[ static_cast<size_t>( StatsCounter::ALLOCATIONS ) ];
+
+   uint64_t total_ns = 0;
+   for( const uint64_t ns : totals.timer_ns ) {
+      total_ns += ns;
+   }
+
+   out << fixed << setprecision( 1 );
+   out << "Stats" << endl;
+   print_line( out, "    ", 34, "Files:",                files );
+   print_line( out, "    ", 34, "Errors:",               failures );
+   print_line( out, "    ", 34, "Wall time (ms):",       seconds * 1e3 );
+   print_line( out, "    ", 34, "Files/sec:",            seconds > 0 ? static_cast<double>( files ) / seconds : 0.0 );
+   print_line( out, "    ", 34, "Bytes read:",           bytes );
+   print_line( out, "    ", 34, "MB/sec:",               seconds > 0 ? static_cast<double>( bytes ) / seconds / 1e6 : 0.0 );
+   print_line( out, "    ", 34, "Cache hits:",           totals.counters[ static_cast<size_t>( StatsCounter::CACHE_HITS ) ] );
+   print_line( out, "    ", 34, "Not PE (skipped):",     totals.counters[ static_cast<size_t>( StatsCounter::REJECTED ) ] );
+   if( allocations > 0 ) {  // Only a program that links StatsAllocator.o counts them
+      print_line( out, "    ", 34, "Allocations per file:", files > 0 ? static_cast<double>( allocations ) / static_cast<double>( files ) : 0.0 );
+   }
+   out << "    Time by stage (summed over threads)" << endl;
+   for( size_t i = 0 ; i < NUMBER_OF_STATS_TIMERS ; i++ ) {
+      if( totals.timer_calls[i] == 0 ) {
+         continue;
+      }
+      const double ms      = static_cast<double>( totals.timer_ns[i] ) / 1e6;
+      const double percent = total_ns > 0 ? 100.0 * static_cast<double>( totals.timer_ns[i] ) / static_cast<double>( total_ns ) : 0.0;
+      out << "        " << setfill( ' ' ) << left << setw( 30 ) << string( TIMER_NAMES[i] ) + " (ms):"
+          << setw( 12 ) << ms << percent << "%" << endl;
+   }
+   out << defaultfloat << setprecision( 6 );
+#endif
+}
+
+
+void Stats::write_trace( const string& path ) {
+   ofstream out( path );
+   if( !out ) {
+      throw runtime_error( "Unable to write the trace " + path );
+   }
+
+   out << "{\"traceEvents\":[";
+   bool first = true;
+   for( const TraceEvent& event : process_totals.events ) {
+      out << ( first ? "" : "," ) << "\n{\"name\":\"" << TIMER_NAMES[ static_cast<size_t>( event.timer ) ]
+          << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+          << ",\"ts\":" << ( event.start_ns - start_ns ) / 1000 << "." << setfill( '0' ) << setw( 3 ) << ( event.start_ns - start_ns ) % 1000
+          << ",\"dur\":" << event.duration / 1000 << "." << setw( 3 ) << event.duration % 1000 << "}";
+      first = false;
+   }
+   out << "\n],\"displayTimeUnit\":\"ms\"}" << endl;
+}
@@ -0,0 +1,147 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Per-stage timing and counters for `--stats` and `--trace`
+///
+/// A STATS_SCOPE() times the rest of the block it's in with `steady_clock`
+/// and adds it to a per-thread total for its StatsTimer.  STATS_ADD() adds
+/// to a per-thread StatsCounter.  Nothing is shared while a batch runs: each
+/// thread's totals are merged into the process totals when the thread
+/// exits (or when the main thread prints them).  With `--trace`, every
+/// scope is also kept as an event and written as a Chrome trace
+/// (`chrome://tracing` or Perfetto).
+///
+/// Allocations are counted by the `operator new` in StatsAllocator.cpp,
+/// which the `readpe` program links and libreadpe.a doesn't, so a program
+/// that links the library keeps its own allocator.
+///
+/// Until Stats::enable() is called, a scope costs one predictable branch.
+/// Build with `-DREADPE_NO_STATS` (`make DEBUG_CFLAGS=-DREADPE_NO_STATS`)
+/// and the macros compile to nothing.
+///
+/// @file   Stats.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>  // For size_t
+#include <cstdint>  // For uint64_t
+#include <ostream>  // For ostream
+#include <string>   // For string
+
+
+/// What a STATS_SCOPE() is timing
+enum class StatsTimer {
+    OPEN         ///< Opening and loading a file (the ByteSource)
+   ,CACHE        ///< Looking up and storing reports in the ResultCache
+   ,PARSE        ///< Binding and validating the headers and the section table
+   ,ANALYZE      ///< The entropy and the digests of the file and its sections
+   ,IMPORTS      ///< Walking and printing the import table
+   ,EXPORTS      ///< Walking and printing the export table
+   ,RESOURCES    ///< Walking and printing the resource tree
+   ,RELOCATIONS  ///< Scanning and printing the base relocation table
+   ,DEBUG        ///< Reading and printing the debug directory
+   ,OVERLAY      ///< Finding and scanning the overlay
+   ,FORMAT       ///< Printing the headers and sections to the ReportWriter
+   ,WRITE        ///< Writing finished reports to the output
+};
+
+/// The number of StatsTimer values
+inline constexpr size_t NUMBER_OF_STATS_TIMERS = 12;
+
+
+/// What a STATS_ADD() is counting
+enum class StatsCounter {
+    BYTES_READ   ///< Bytes read from files (or touched in a mapping)
+   ,CACHE_HITS   ///< Reports that were served from the ResultCache
+   ,REJECTED     ///< Files that `--prefilter` found aren't PE files
+   ,ALLOCATIONS  ///< Calls to `operator new` (if the program links StatsAllocator.o)
+};
+
+/// The number of StatsCounter values
+inline constexpr size_t NUMBER_OF_STATS_COUNTERS = 4;
+
+
+/// The allocations made on this thread and not yet merged (a plain
+/// `thread_local`, so counting one never allocates)
+extern thread_local uint64_t stats_thread_allocations;
+
+
+/// The process-wide switch and totals
+class Stats {
+protected:
+   static bool enabled_;  ///< Set by enable()
+   static bool tracing_;  ///< Set by enable() to keep trace events
+
+   friend class StatsScope;
+
+public:
+   /// Start collecting (call this before any other threads start)
+   /// @param trace Also keep an event for every scope
+   static void enable( bool trace );
+
+   static bool enabled() {
+      return enabled_;  /// @return `true` if stats are being collected
+   }
+
+   /// Add `amount` to `counter` (on this thread)
+   static void add( StatsCounter counter, uint64_t amount );
+
+   /// Print the totals (the other threads must have exited)
+   ///
+   /// @param out      Where to print
+   /// @param files    The number of files processed
+   /// @param failures The number of files that failed
+   static void print( std::ostream& out, size_t files, size_t failures );
+
+   /// Write the trace events as a Chrome trace (the other threads must have exited)
+   /// @throws runtime_error if `path` can't be written
+   static void write_trace( const std::string& path );
+}; // Stats
+
+
+/// Times the rest of the block it's declared in
+class StatsScope {
+protected:
+   StatsTimer timer_;     ///< What's being timed
+   uint64_t   start_ns_;  ///< When it started (0 if stats are off)
+
+public:
+   /// Start timing `timer` (if stats are on)
+   explicit StatsScope( const StatsTimer timer )
+         :timer_   ( timer )                       // Member initialization
+         ,start_ns_( Stats::enabled_ ? now() : 0 )  // Member initialization
+   {}
+
+   ~StatsScope() {
+      if( start_ns_ != 0 ) {
+         finish();
+      }
+   }
+
+   StatsScope( const StatsScope& ) = delete;
+   StatsScope& operator=( const StatsScope& ) = delete;
+
+   /// @return The `steady_clock` time in nanoseconds (never 0)
+   static uint64_t now();
+
+protected:
+   /// Add the time since #start_ns_ to this thread's totals
+   void finish();
+}; // StatsScope
+
+
+#ifndef READPE_NO_STATS
+   #define STATS_CONCATENATE_( a, b ) a##b
+   #define STATS_CONCATENATE( a, b ) STATS_CONCATENATE_( a, b )
+
+   /// Time the rest of the enclosing block as StatsTimer::TIMER
+   #define STATS_SCOPE( TIMER ) const StatsScope STATS_CONCATENATE( stats_scope_, __LINE__ ) { StatsTimer::TIMER }
+
+   /// Add `AMOUNT` to StatsCounter::COUNTER
+   #define STATS_ADD( COUNTER, AMOUNT ) do { if( Stats::enabled() ) { Stats::add( StatsCounter::COUNTER, AMOUNT ); } } while( false )
+#else
+   #define STATS_SCOPE( TIMER )         do {} while( false )
+   #define STATS_ADD( COUNTER, AMOUNT ) do {} while( false )
+#endif
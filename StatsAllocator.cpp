@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Count allocations for `--stats` by replacing `operator new`
+///
+/// This replaces the global allocation functions, so it's linked into the
+/// `readpe` program only and never into libreadpe.a.  A program that links
+/// the library keeps its own allocator (and `Allocations per file` isn't
+/// printed).
+///
+/// @file   StatsAllocator.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>  // For malloc() free()
+#include <new>      // For bad_alloc get_new_handler()
+
+#include "Stats.h"
+
+using namespace std;
+
+
+#ifndef READPE_NO_STATS
+
+/// Count every allocation (while stats are on)
+///
+/// Like the default `operator new`, this calls the `new_handler` until
+/// the allocation succeeds and only throws when there isn't one.
+void* operator new( const size_t size ) {
+   if( Stats::enabled() ) {
+      stats_thread_allocations++;
+   }
+   while( true ) {
+      void* memory = malloc( size == 0 ? 1 : size );
+      if( memory != nullptr ) {
+         return memory;
+      }
+      const new_handler handler = get_new_handler();
+      if( handler == nullptr ) {
+         throw bad_alloc();
+      }
+      handler();
+   }
+}
+
+/// Release what operator new() allocated
+void operator delete( void* memory ) noexcept {
+   free( memory );
+}
+
+/// Release what operator new() allocated
+void operator delete( void* memory, size_t ) noexcept {
+   free( memory );
+}
+
+#endif
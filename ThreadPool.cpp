@@ -0,0 +1,208 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// A fixed-size pool of worker threads that steal work from each other
+///
+/// @file   ThreadPool.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>  // For max()
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+
+/// The pool that this thread works for (`nullptr` outside of a pool)
+static thread_local ThreadPool* current_pool { nullptr };
+
+/// This thread's index in #current_pool
+static thread_local size_t current_index { 0 };
+
+
+ThreadPool::ThreadPool( const size_t number_of_workers ) {
+   const size_t count = max<size_t>( number_of_workers, 1 );
+
+   // Every queue exists before any worker starts looking for work
+   queues_.reserve( count );
+   for( size_t i = 0 ; i < count ; i++ ) {
+      queues_.push_back( make_unique<Queue>() );
+   }
+
+   workers_.reserve( count );
+   for( size_t i = 0 ; i < count ; i++ ) {
+      workers_.emplace_back( &ThreadPool::worker_loop, this, i );
+   }
+}
+
+
+ThreadPool::~ThreadPool() {
+   {
+      const lock_guard<mutex> lock( sleep_mutex_ );
+      stopping_ = true;
+   }
+   task_available_.notify_all();
+
+   for( thread& worker : workers_ ) {
+      worker.join();
+   }
+}
+
+
+void ThreadPool::submit( Task task ) {
+   Queue& queue = current_pool == this ? *queues_[ current_index ] : shared_;
+   {
+      const lock_guard<mutex> lock( queue.mutex );
+      queue.tasks.push_back( std::move( task ) );
+   }
+   {
+      const lock_guard<mutex> lock( sleep_mutex_ );  // So a worker can't miss the wakeup
+      queued_++;
+   }
+   task_available_.notify_one();
+}
+
+
+bool ThreadPool::take( const size_t self, Task& task ) {
+   if( queued_.load() == 0 ) {
+      return false;
+   }
+
+   // The newest task on our own queue
+   if( self < queues_.size() ) {
+      Queue& own = *queues_[ self ];
+      const lock_guard<mutex> lock( own.mutex );
+      if( !own.tasks.empty() ) {
+         task = std::move( own.tasks.back() );
+         own.tasks.pop_back();
+         queued_--;
+         return true;
+      }
+   }
+
+   // The oldest task from outside the pool
+   {
+      const lock_guard<mutex> lock( shared_.mutex );
+      if( !shared_.tasks.empty() ) {
+         task = std::move( shared_.tasks.front() );
+         shared_.tasks.pop_front();
+         queued_--;
+         return true;
+      }
+   }
+
+   // The oldest task on someone else's queue
+   for( size_t i = 1 ; i <= queues_.size() ; i++ ) {
+      Queue& victim = *queues_[ ( self + i ) % queues_.size() ];
+      const lock_guard<mutex> lock( victim.mutex );
+      if( !victim.tasks.empty() ) {
+         task = std::move( victim.tasks.front() );
+         victim.tasks.pop_front();
+         queued_--;
+         return true;
+      }
+   }
+   return false;
+} // take()
+
+
+void ThreadPool::worker_loop( const size_t index ) {
+   current_pool  = this;
+   current_index = index;
+
+   for( ;; ) {
+      Task task;
+      if( take( index, task ) ) {
+         task();
+         continue;
+      }
+
+      unique_lock<mutex> lock( sleep_mutex_ );
+      task_available_.wait( lock, [this] { return stopping_ || queued_.load() > 0; } );
+      if( stopping_ && queued_.load() == 0 ) {
+         return;
+      }
+   }
+}
+
+
+ThreadPool* ThreadPool::current() {
+   return current_pool;
+}
+
+
+size_t ThreadPool::default_size() {
+   const unsigned int hardware_threads = thread::hardware_concurrency();
+   return hardware_threads == 0 ? 1 : hardware_threads;
+}
+
+
+TaskGroup::~TaskGroup() {
+   try {
+      wait();
+   } catch( ... ) {}  // The tasks are done; nobody asked for the error
+}
+
+
+bool TaskGroup::State::run_one() {
+   ThreadPool::Task task;
+   {
+      const lock_guard<std::mutex> lock( mutex );
+      if( tasks.empty() ) {
+         return false;
+      }
+      task = std::move( tasks.front() );
+      tasks.pop_front();
+   }
+
+   exception_ptr failure;
+   try {
+      task();
+   } catch( ... ) {
+      failure = current_exception();
+   }
+
+   const lock_guard<std::mutex> lock( mutex );
+   if( failure && !error ) {
+      error = failure;
+   }
+   if( --pending == 0 ) {
+      done.notify_all();
+   }
+   return true;
+} // run_one()
+
+
+void TaskGroup::run( ThreadPool::Task task ) {
+   if( pool_ == nullptr ) {
+      task();
+      return;
+   }
+
+   {
+      const lock_guard<mutex> lock( state_->mutex );
+      state_->tasks.push_back( std::move( task ) );
+      state_->pending++;
+   }
+   pool_->submit( [state = state_] { state->run_one(); } );
+}
+
+
+void TaskGroup::wait() {
+   // Run our own tasks that nobody has started.  The rest are already
+   // running on other threads, so just wait for them.
+   while( state_->run_one() ) {}
+
+   exception_ptr error;
+   {
+      unique_lock<mutex> lock( state_->mutex );
+      state_->done.wait( lock, [this] { return state_->pending == 0; } );
+      error = state_->error;
+      state_->error = nullptr;
+   }
+   if( error ) {
+      rethrow_exception( error );
+   }
+} // wait()
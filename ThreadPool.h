@@ -0,0 +1,132 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// A fixed-size pool of worker threads that steal work from each other
+///
+/// @file   ThreadPool.h
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>              // For atomic
+#include <condition_variable>  // For condition_variable
+#include <deque>               // For deque
+#include <exception>           // For exception_ptr
+#include <functional>          // For function
+#include <memory>              // For unique_ptr
+#include <mutex>               // For mutex
+#include <thread>              // For thread
+#include <vector>              // For vector
+
+
+/// A fixed-size pool of worker threads that run submitted tasks
+///
+/// Each worker has its own queue.  A task submitted from a worker goes on
+/// that worker's queue, and the worker runs its own newest task first, so
+/// the pieces of one file get done while they're still in cache.  Tasks
+/// submitted from outside the pool go on a shared queue.  A worker that
+/// runs out of work takes the oldest task from the shared queue or steals
+/// the oldest task from another worker.
+class ThreadPool {
+public:
+   using Task = std::function<void()>;  ///< A unit of work
+
+protected:
+   /// A queue of tasks and the lock that guards it
+   struct Queue {
+      std::mutex       mutex;  ///< Guards #tasks
+      std::deque<Task> tasks;  ///< Tasks waiting for a worker
+   };
+
+   std::vector<std::thread>            workers_;              ///< The worker threads
+   std::vector<std::unique_ptr<Queue>> queues_;               ///< One queue per worker
+   Queue                               shared_;               ///< Tasks submitted from outside the pool
+   std::atomic<size_t>                 queued_   { 0 };       ///< The number of tasks in all of the queues
+   std::mutex                          sleep_mutex_;          ///< Guards #stopping_ and the increments of #queued_
+   std::condition_variable             task_available_;       ///< Signalled when a task is queued or the pool stops
+   bool                                stopping_ { false };   ///< Set when the pool is shutting down
+
+   /// Take a task for the worker at `self` (or for a thread outside the pool if `self` is out of range)
+   ///
+   /// @return `true` if `task` was filled in
+   bool take( size_t self, Task& task );
+
+   /// The body of the worker thread at `index`
+   void worker_loop( size_t index );
+
+public:
+   /// Start `number_of_workers` threads (at least one)
+   explicit ThreadPool( size_t number_of_workers );
+
+   /// Finish the queued tasks and join the workers
+   ~ThreadPool();
+
+   ThreadPool( const ThreadPool& ) = delete;
+   ThreadPool& operator=( const ThreadPool& ) = delete;
+
+   /// Queue `task` to run on a worker thread
+   void submit( Task task );
+
+   size_t size() const {
+      return workers_.size();  /// @return The number of worker threads
+   }
+
+   /// @return The pool that the calling thread works for (or `nullptr` if it isn't a worker)
+   static ThreadPool* current();
+
+   /// @return The number of hardware threads, or 1 if it can't be determined
+   static size_t default_size();
+}; // ThreadPool
+
+
+/// A group of tasks that are waited for together
+///
+/// The tasks run on a ThreadPool.  wait() doesn't just block: it runs the
+/// group's own tasks that no worker has started yet, so a worker can wait
+/// on its own tasks without tying up a thread (or deadlocking a pool of
+/// one).  It never runs anything else, so a file's wait can't pick up
+/// another file's job and run it on its stack.  Without a pool, run() runs
+/// each task right away.
+class TaskGroup {
+protected:
+   /// What the group shares with the pool
+   ///
+   /// The group's tasks are queued here, and the pool is given a task that
+   /// runs the oldest of them.  The pool may get to that after wait() has
+   /// run them all (and the group is gone), so it holds on to the State
+   /// and finds nothing to do.
+   struct State {
+      std::mutex                   mutex;          ///< Guards everything below
+      std::condition_variable      done;           ///< Signalled when #pending gets to 0
+      std::deque<ThreadPool::Task> tasks;          ///< The tasks that haven't started
+      size_t                       pending { 0 };  ///< The tasks that haven't finished
+      std::exception_ptr           error;          ///< The first exception a task threw
+
+      /// Run the oldest task that hasn't started (on the calling thread)
+      ///
+      /// @return `false` if every task has started
+      bool run_one();
+   };
+
+   ThreadPool*            pool_;                                 ///< Where the tasks run (or `nullptr` to run them inline)
+   std::shared_ptr<State> state_ { std::make_shared<State>() };  ///< The tasks (shared with the pool)
+
+public:
+   /// Create a group that runs on `pool` (by default, the pool of the calling thread)
+   explicit TaskGroup( ThreadPool* pool = ThreadPool::current() ) : pool_( pool ) {}
+
+   /// Wait for the tasks that are still running (their exceptions are dropped)
+   ~TaskGroup();
+
+   TaskGroup( const TaskGroup& ) = delete;
+   TaskGroup& operator=( const TaskGroup& ) = delete;
+
+   /// Run `task` as part of this group
+   void run( ThreadPool::Task task );
+
+   /// Run the group's tasks that haven't started, then wait for the rest
+   ///
+   /// @throws The first exception that a task threw
+   void wait();
+}; // TaskGroup
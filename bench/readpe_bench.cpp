@@ -0,0 +1,370 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// Micro-benchmarks of each stage of readpe and an end-to-end throughput
+/// benchmark, over the files in exe_files and a synthetic file with one
+/// large section
+///
+/// Run it with `make bench` from the top of the repository.
+///
+/// @file   readpe_bench.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>   // For sort()
+#include <cstdint>     // For uint8_t
+#include <cstdio>      // For remove()
+#include <filesystem>  // For directory_iterator file_size()
+#include <fstream>     // For ofstream
+#include <iostream>    // For cerr
+#include <random>      // For mt19937_64
+#include <string>      // For string
+#include <vector>      // For vector
+
+#include <fcntl.h>   // For open()
+#include <unistd.h>  // For close()
+
+#include <benchmark/benchmark.h>
+
+#include "Batch.h"
+#include "ByteSource.h"
+#include "Entropy.h"
+#include "Format.h"
+#include "Hash.h"
+#include "Overlay.h"
+#include "PEFile.h"
+#include "Relocations.h"
+
+using namespace std;
+
+
+/// Where the corpus is (relative to the top of the repository)
+#define CORPUS_DIRECTORY "exe_files"
+
+/// Where the synthetic file goes
+#define SYNTHETIC_PATH "/tmp/readpe_bench_large_section.exe"
+
+/// The size of the synthetic file's one section
+#define SYNTHETIC_SECTION_BYTES ( 64 * 1024 * 1024 )
+
+/// The number of times the end-to-end benchmark runs through the corpus per iteration
+#define BATCH_REPEATS 16
+
+
+/// The files in #CORPUS_DIRECTORY and the synthetic file
+static vector<string> corpus;
+
+
+/// Write a PE32+ file with one section of SYNTHETIC_SECTION_BYTES random bytes
+///
+/// The headers are the least that readpe accepts: a DOS header, the
+/// signature, a COFF header, an optional header with no data directory
+/// and one section header.
+static void write_synthetic_file() {
+   vector<uint8_t> file( 0x400 + SYNTHETIC_SECTION_BYTES );
+   auto put = [&file]( const size_t offset, const uint64_t value, const size_t width ) {
+      for( size_t i = 0 ; i < width ; i++ ) {
+         file[offset + i] = static_cast<uint8_t>( value >> ( 8 * i ) );
+      }
+   };
+
+   put( 0x00, 0x5a4d, 2 );                     // MZ
+   put( 0x3c, 0x40, 4 );                       // e_lfanew
+   put( 0x40, 0x00004550, 4 );                 // PE\0\0
+   put( 0x44, 0x8664, 2 );                     // Machine: x64
+   put( 0x46, 1, 2 );                          // NumberOfSections
+   put( 0x54, 0x70, 2 );                       // SizeOfOptionalHeader (no data directory)
+   put( 0x56, 0x0022, 2 );                     // Characteristics: executable, large address aware
+   put( 0x58, 0x020b, 2 );                     // Magic: PE32+
+   put( 0x58 + 0x3c, 0x400, 4 );               // SizeOfHeaders
+
+   const size_t section = 0x58 + 0x70;
+   put( section + 0x00, 0x7461642e, 4 );                // .dat
+   put( section + 0x08, SYNTHETIC_SECTION_BYTES, 4 );   // VirtualSize
+   put( section + 0x0c, 0x1000, 4 );                    // VirtualAddress
+   put( section + 0x10, SYNTHETIC_SECTION_BYTES, 4 );   // SizeOfRawData
+   put( section + 0x14, 0x400, 4 );                     // PointerToRawData
+   put( section + 0x24, 0x40000040, 4 );                // Characteristics: initialized data, readable
+
+   mt19937_64 random { 1 };
+   for( size_t offset = 0x400 ; offset + 8 <= file.size() ; offset += 8 ) {
+      put( offset, random(), 8 );
+   }
+
+   ofstream out( SYNTHETIC_PATH, ios::binary | ios::trunc );
+   out.write( reinterpret_cast<const char*>( file.data() ), static_cast<streamsize>( file.size() ) );
+}
+
+
+/// @return The size of the file at `path`
+static size_t file_size( const string& path ) {
+   return filesystem::file_size( path );
+}
+
+
+/// Open the file (with each LoadMode), the way the PEFile constructor does
+static void BM_Open( benchmark::State& state, const string& path, const LoadMode mode ) {
+   for( auto _ : state ) {
+      const unique_ptr<ByteSource> source = open_byte_source( path, mode );
+      benchmark::DoNotOptimize( source->read( 0, 2 ) );
+   }
+}
+
+
+/// Bind and validate every header (FieldMap::parse())
+static void BM_ParseHeaders( benchmark::State& state, const string& path ) {
+   const unique_ptr<ByteSource> source = open_byte_source( path, LoadMode::MMAP );
+   for( auto _ : state ) {
+      DOS_FieldMap dos;
+      dos.parse( *source );
+      dos.validate();
+
+      COFF_FieldMap coff { dos.get_exe_header_offset() };
+      coff.parse( *source );
+      coff.validate();
+
+      Optional_FieldMap optional { coff.get_optional_header_offset(), coff.get_size_of_optional_header() };
+      if( optional.is_present() ) {
+         optional.parse( *source );
+      }
+
+      for( uint16_t i = 0 ; i < coff.get_number_of_sections() ; i++ ) {
+         Section_FieldMap section { coff.get_section_table_offset() + i * Section_FieldMap::EXTENT };
+         section.parse( *source );
+         benchmark::DoNotOptimize( section.is_complete() );
+      }
+   }
+}
+
+
+/// Read every field of the COFF header and of each section header (HeaderView::value())
+static void BM_FieldValues( benchmark::State& state, const string& path ) {
+   const unique_ptr<ByteSource> source = open_byte_source( path, LoadMode::MMAP );
+   DOS_FieldMap dos;
+   dos.parse( *source );
+   COFF_FieldMap coff { dos.get_exe_header_offset() };
+   coff.parse( *source );
+
+   vector<Section_FieldMap> sections;
+   for( uint16_t i = 0 ; i < coff.get_number_of_sections() ; i++ ) {
+      sections.emplace_back( coff.get_section_table_offset() + i * Section_FieldMap::EXTENT );
+      sections.back().parse( *source );
+   }
+
+   for( auto _ : state ) {
+      uint64_t sum = 0;
+      for( size_t i = 0 ; i < COFF_FieldMap::SIZE ; i++ ) {
+         sum += coff.value( i );
+      }
+      for( const Section_FieldMap& section : sections ) {
+         for( size_t i = 0 ; i < Section_FieldMap::SIZE ; i++ ) {
+            sum += section.value( i );
+         }
+      }
+      benchmark::DoNotOptimize( sum );
+   }
+}
+
+
+/// Format characteristics with every flag set (print_characteristics())
+static void BM_FormatCharacteristics( benchmark::State& state ) {
+   const FieldDescriptor& field = SECTION_LAYOUT[ field_index( SECTION_LAYOUT, "07_section_characteristics" ) ];
+   string out;
+   for( auto _ : state ) {
+      out.clear();
+      format_characteristics( out, field, 0xffffffff );
+      benchmark::DoNotOptimize( out.data() );
+   }
+}
+
+
+/// Write the whole report for one file (opening it each time, like a Batch job)
+static void BM_Report( benchmark::State& state, const string& path, const ReportFormat format, const ReportOptions& options ) {
+   OutputSink report;
+   for( auto _ : state ) {
+      report.clear();
+      Stage stage { Stage::OPEN };
+      write_report( path, LoadMode::MMAP, format, options, report, stage );
+      benchmark::DoNotOptimize( report.data() );
+   }
+   state.SetBytesProcessed( static_cast<int64_t>( state.iterations() * file_size( path ) ) );
+}
+
+
+/// Count the bytes of the whole file and compute the entropy
+static void BM_Entropy( benchmark::State& state, const string& path ) {
+   const unique_ptr<ByteSource> source = open_byte_source( path, LoadMode::MMAP );
+   const auto* bytes = reinterpret_cast<const unsigned char*>( source->read( 0, source->size() ) );
+   for( auto _ : state ) {
+      ByteHistogram histogram {};
+      count_bytes( bytes, source->size(), histogram );
+      benchmark::DoNotOptimize( shannon_entropy( histogram ) );
+   }
+   state.SetBytesProcessed( static_cast<int64_t>( state.iterations() * source->size() ) );
+   state.SetLabel( histogram_kernel_name() );
+}
+
+
+/// The histogram kernels that BM_HistogramKernel runs (each against `scalar`)
+static const char* const HISTOGRAM_KERNELS[] = { "scalar", "avx2", "neon" };
+
+
+/// Count the bytes of the whole file with the histogram kernel `kernel`
+///
+/// The kernel's histogram is checked against the scalar kernel's first.  A
+/// kernel that this build or CPU doesn't have is skipped.
+static void BM_HistogramKernel( benchmark::State& state, const string& path, const string& kernel ) {
+   const unique_ptr<ByteSource> source = open_byte_source( path, LoadMode::MMAP );
+   const auto* bytes = reinterpret_cast<const unsigned char*>( source->read( 0, source->size() ) );
+
+   ByteHistogram expected {};
+   ByteHistogram counted  {};
+   count_bytes_with( "scalar", bytes, source->size(), expected );
+   if( !count_bytes_with( kernel, bytes, source->size(), counted ) ) {
+      state.SkipWithError( ( kernel + " isn't supported here" ).c_str() );
+      return;
+   }
+   if( counted != expected ) {
+      state.SkipWithError( ( kernel + " doesn't match the scalar kernel" ).c_str() );
+      return;
+   }
+
+   for( auto _ : state ) {
+      ByteHistogram histogram {};
+      count_bytes_with( kernel, bytes, source->size(), histogram );
+      benchmark::DoNotOptimize( histogram );
+   }
+   state.SetBytesProcessed( static_cast<int64_t>( state.iterations() * source->size() ) );
+}
+
+
+/// Hash the whole file
+static void BM_Sha256( benchmark::State& state, const string& path ) {
+   const unique_ptr<ByteSource> source = open_byte_source( path, LoadMode::MMAP );
+   const char* bytes = source->read( 0, source->size() );
+   for( auto _ : state ) {
+      Sha256 sha256;
+      sha256.update( bytes, source->size() );
+      benchmark::DoNotOptimize( sha256.finish() );
+   }
+   state.SetBytesProcessed( static_cast<int64_t>( state.iterations() * source->size() ) );
+   state.SetLabel( Sha256::kernel_name() );
+}
+
+
+/// Count the types of `state.range( 0 )` base relocation entries (DIR64s with a little padding, like a real `.reloc`)
+static void BM_RelocationTypes( benchmark::State& state ) {
+   vector<uint16_t> entries( static_cast<size_t>( state.range( 0 ) ) );
+   mt19937_64 random { 1 };
+   for( uint16_t& entry : entries ) {
+      const uint16_t type = random() % 256 == 0 ? IMAGE_REL_BASED_ABSOLUTE : IMAGE_REL_BASED_DIR64;
+      entry = static_cast<uint16_t>( type << 12 | ( random() & 0x0FFF ) );
+   }
+   for( auto _ : state ) {
+      RelocationCounts counts {};
+      count_relocation_types( reinterpret_cast<const char*>( entries.data() ), entries.size(), counts );
+      benchmark::DoNotOptimize( counts );
+   }
+   state.SetItemsProcessed( static_cast<int64_t>( state.iterations() * entries.size() ) );
+   state.SetLabel( relocation_kernel_name() );
+}
+
+
+/// Scan `state.range( 0 )` random bytes (like a compressed installer payload) for the overlay signatures
+static void BM_OverlayScan( benchmark::State& state ) {
+   vector<char> bytes( static_cast<size_t>( state.range( 0 ) ) );
+   mt19937_64 random { 1 };
+   for( char& byte : bytes ) {
+      byte = static_cast<char>( random() );
+   }
+   for( auto _ : state ) {
+      OverlayMatches matches {};
+      scan_overlay( bytes.data(), bytes.size(), bytes.size(), 0, matches );
+      benchmark::DoNotOptimize( matches );
+   }
+   state.SetBytesProcessed( static_cast<int64_t>( state.iterations() * bytes.size() ) );
+   state.SetLabel( overlay_kernel_name() );
+}
+
+
+/// Run a Batch over the corpus #BATCH_REPEATS times on `state.range( 0 )` workers
+///
+/// Reports files/sec and bytes/sec.
+static void BM_Batch( benchmark::State& state ) {
+   vector<string> paths;
+   size_t         bytes = 0;
+   for( size_t i = 0 ; i < BATCH_REPEATS ; i++ ) {
+      for( const string& path : corpus ) {
+         paths.push_back( path );
+         bytes += file_size( path );
+      }
+   }
+
+   const int null_fd = open( "/dev/null", O_WRONLY | O_CLOEXEC );
+   Batch batch { static_cast<size_t>( state.range( 0 ) ), false, []( const string& path, OutputSink& report, Stage& stage ) {
+      write_report( path, LoadMode::MMAP, ReportFormat::TEXT, ReportOptions {}, report, stage );
+      return true;
+   } };
+   for( auto _ : state ) {
+      batch.run( paths, null_fd, cerr );
+   }
+   close( null_fd );
+
+   state.counters["files/s"] = benchmark::Counter( static_cast<double>( state.iterations() * paths.size() ), benchmark::Counter::kIsRate );
+   state.SetBytesProcessed( static_cast<int64_t>( state.iterations() * bytes ) );
+}
+
+
+/// Find the corpus, write the synthetic file and register a benchmark per file
+int main( int argc, char* argv[] ) {
+   for( const auto& entry : filesystem::directory_iterator( CORPUS_DIRECTORY ) ) {
+      const string extension = entry.path().extension().string();
+      if( entry.is_regular_file() && ( extension == ".exe" || extension == ".dll" ) ) {
+         corpus.push_back( entry.path().string() );
+      }
+   }
+   sort( corpus.begin(), corpus.end() );
+   write_synthetic_file();
+   corpus.push_back( SYNTHETIC_PATH );
+
+   ReportOptions everything;
+   everything.optional_header = true;
+   everything.imports         = true;
+   everything.exports         = true;
+   everything.entropy         = true;
+   everything.hash_file       = true;
+   everything.hash_sections   = true;
+   everything.imphash         = true;
+   everything.relocations     = true;
+   everything.debug           = true;
+   everything.overlay         = true;
+
+   for( const string& path : corpus ) {
+      const string name = filesystem::path( path ).filename().string();
+      benchmark::RegisterBenchmark( ( "Open/mmap/"  + name ).c_str(), BM_Open, path, LoadMode::MMAP  );
+      benchmark::RegisterBenchmark( ( "Open/pread/" + name ).c_str(), BM_Open, path, LoadMode::PREAD );
+      benchmark::RegisterBenchmark( ( "Open/read/"  + name ).c_str(), BM_Open, path, LoadMode::READ  );
+      benchmark::RegisterBenchmark( ( "ParseHeaders/" + name ).c_str(), BM_ParseHeaders, path );
+      benchmark::RegisterBenchmark( ( "FieldValues/"  + name ).c_str(), BM_FieldValues,  path );
+      benchmark::RegisterBenchmark( ( "Report/text/"  + name ).c_str(), BM_Report, path, ReportFormat::TEXT,   ReportOptions {} );
+      benchmark::RegisterBenchmark( ( "Report/json/"  + name ).c_str(), BM_Report, path, ReportFormat::JSON,   ReportOptions {} );
+      benchmark::RegisterBenchmark( ( "Report/binary/" + name ).c_str(), BM_Report, path, ReportFormat::BINARY, ReportOptions {} );
+      benchmark::RegisterBenchmark( ( "Report/all/"   + name ).c_str(), BM_Report, path, ReportFormat::TEXT,   everything );
+      benchmark::RegisterBenchmark( ( "Entropy/"      + name ).c_str(), BM_Entropy, path );
+      benchmark::RegisterBenchmark( ( "Sha256/"       + name ).c_str(), BM_Sha256,  path );
+      for( const string kernel : HISTOGRAM_KERNELS ) {
+         benchmark::RegisterBenchmark( ( "HistogramKernel/" + kernel + "/" + name ).c_str(), BM_HistogramKernel, path, kernel );
+      }
+   }
+   benchmark::RegisterBenchmark( "FormatCharacteristics", BM_FormatCharacteristics );
+   benchmark::RegisterBenchmark( "RelocationTypes", BM_RelocationTypes )->Arg( 2048 )->Arg( 1 << 20 );
+   benchmark::RegisterBenchmark( "OverlayScan", BM_OverlayScan )->Arg( 1 << 16 )->Arg( 1 << 24 );
+   benchmark::RegisterBenchmark( "Batch", BM_Batch )->RangeMultiplier( 2 )->Range( 1, 8 )->UseRealTime();
+
+   benchmark::Initialize( &argc, argv );
+   benchmark::RunSpecifiedBenchmarks();
+   benchmark::Shutdown();
+   remove( SYNTHETIC_PATH );
+   return 0;  /// @return 0
+}
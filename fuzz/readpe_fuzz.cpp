@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+//         University of Hawaii, College of Engineering
+//         readpe - SRE - Spr 2023
+//
+/// A libFuzzer target for PEFile
+///
+/// Each input is read as a PE file from memory and reported with every
+/// option on, through each of the report formats.  A malformed file is
+/// expected to fail with an exception (which is how a report fails), but
+/// never to read outside of the input or crash.
+///
+/// Run it with `make fuzz` from the top of the repository.  New inputs go
+/// to fuzz/corpus, which starts from the files in exe_files.
+///
+/// @file   readpe_fuzz.cpp
+/// @author Mark Nelson <marknels@hawaii.edu>
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>    // For size_t
+#include <cstdint>    // For uint8_t
+#include <exception>  // For exception
+#include <memory>     // For make_unique()
+
+#include "Batch.h"
+#include "ByteSource.h"
+#include "OutputSink.h"
+#include "PEFile.h"
+#include "ReportWriter.h"
+
+using namespace std;
+
+
+/// @return Options that reach every stage of PEFile::print()
+static ReportOptions every_option() {
+   ReportOptions options;
+   options.optional_header = true;
+   options.imports         = true;
+   options.exports         = true;
+   options.entropy         = true;
+   options.hash_file       = true;
+   options.hash_sections   = true;
+   options.imphash         = true;
+   options.resources       = true;
+   options.relocations     = true;
+   options.debug           = true;
+   options.overlay         = true;
+   options.export_queries  = { "GetProcAddress", "#1" };
+   return options;
+}
+
+
+/// Report the `size` bytes at `data` into `sink` with a `WRITER`
+///
+/// @tparam WRITER A ReportWriter like TextReportWriter
+template <typename WRITER>
+static void report( const uint8_t* data, const size_t size, const ReportOptions& options, OutputSink& sink ) {
+   sink.clear();
+   WRITER writer { sink };
+   Stage  stage { Stage::OPEN };
+   writer.begin_file( "fuzz" );
+   try {
+      PEFile pe_file( make_unique<MemoryByteSource>( "fuzz", reinterpret_cast<const char*>( data ), size ), options );
+      pe_file.print( writer, stage );
+      writer.end_file();
+   } catch( const exception& e ) {
+      writer.fail( stage_name( stage ), e.what() );
+   }
+}
+
+
+/// The entry point that libFuzzer calls with each input
+///
+/// @return 0 (the input is always kept)
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t* data, const size_t size ) {
+   static const ReportOptions options = every_option();
+   static OutputSink          sink;
+
+   if( size == 0 ) {
+      return 0;  // A MemoryByteSource needs at least one byte
+   }
+   report<TextReportWriter>  ( data, size, options, sink );
+   report<JsonReportWriter>  ( data, size, options, sink );
+   report<BinaryReportWriter>( data, size, options, sink );
+   return 0;
+}